@@ -0,0 +1,86 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Heap allocation counter for checking that the scan loop stops
+  allocating. The count is always readable; it only moves in an
+  executable where exactly one source file defines
+  CBIR_COUNT_ALLOCATIONS before including this header, which replaces
+  the global operator new/delete with counting versions. Everything
+  allocated through operator new is counted, including allocations made
+  inside OpenCV and the C++ library. The count is per thread, so the
+  read-ahead threads (or OpenCV's own) never show up in a difference
+  taken around code running on the calling thread.
+*/
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+inline thread_local uint64_t t_heapAllocations = 0;
+
+// Number of operator new calls made by the calling thread so far (stays 0 without the counting allocator)
+inline uint64_t heapAllocationCount() {
+  return t_heapAllocations;
+}
+
+#ifdef CBIR_COUNT_ALLOCATIONS
+
+static void* countedAllocate(std::size_t size) {
+  t_heapAllocations++;
+  void* p = std::malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+static void* countedAllocateAligned(std::size_t size, std::align_val_t align) {
+  t_heapAllocations++;
+  std::size_t alignment = static_cast<std::size_t>(align);
+  std::size_t rounded = (size + alignment - 1) / alignment * alignment;  // aligned_alloc wants a multiple
+#ifdef _WIN32
+  void* p = _aligned_malloc(rounded ? rounded : alignment, alignment);
+#else
+  void* p = std::aligned_alloc(alignment, rounded ? rounded : alignment);
+#endif
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+static void countedFreeAligned(void* p) {
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+
+void* operator new(std::size_t size) { return countedAllocate(size); }
+void* operator new[](std::size_t size) { return countedAllocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  try { return countedAllocate(size); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  try { return countedAllocate(size); } catch (...) { return nullptr; }
+}
+void* operator new(std::size_t size, std::align_val_t align) { return countedAllocateAligned(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align) { return countedAllocateAligned(size, align); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { countedFreeAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { countedFreeAligned(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { countedFreeAligned(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { countedFreeAligned(p); }
+
+#endif // CBIR_COUNT_ALLOCATIONS
+
+#endif // ALLOC_COUNTER_H
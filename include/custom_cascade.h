@@ -0,0 +1,41 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Two-stage evaluator for the custom portrait distance. The DNN term
+  carries 70% of the weight and the skin/brightness terms can add at most
+  0.3, so ranking on the DNN term alone gives a provable cutoff and the
+  image only has to be decoded for the candidates that survive it.
+*/
+
+#ifndef CUSTOM_CASCADE_H
+#define CUSTOM_CASCADE_H
+
+#include <vector>
+#include <utility>
+#include <functional>
+
+struct CustomCascadeStats {
+  int candidates = 0;   // images ranked on the DNN term
+  int survivors = 0;    // images whose DNN bound is within the cutoff
+  int fullyScored = 0;  // images whose full custom distance was computed
+  float cutoff = 0.0f;  // k-th smallest upper bound (DNN term + remaining weights)
+};
+
+/*
+  Exact top-k of the custom distance
+
+  Input:
+    dnnDistances - customDnnDistance(query, candidate) for every candidate id
+    k - number of results
+    scoreFull - computes the full customDistance of a candidate, returns
+                false if the candidate cannot be scored (e.g. decode failed)
+    results - output {distance, id} pairs sorted like the exhaustive scan
+*/
+void customCascadeTopK(const std::vector<float>& dnnDistances, int k,
+                       const std::function<bool(int id, float& distance)>& scoreFull,
+                       std::vector<std::pair<float, int>>& results, CustomCascadeStats* stats = nullptr);
+
+#endif // CUSTOM_CASCADE_H
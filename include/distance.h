@@ -35,4 +35,12 @@ float cosineDistance(const std::vector<float>& vA,
 // custom feature distance function   
 float customDistance(const std::vector<float>& f1, const std::vector<float>& f2);
 
+// weights of the custom distance terms (DNN cosine, skin histogram, brightness)
+const double kCustomDnnWeight = 0.7;
+const double kCustomSkinWeight = 0.2;
+const double kCustomBrightnessWeight = 0.1;
+
+// DNN cosine term of the custom distance (first 512 values), in [0, 2]
+float customDnnDistance(const std::vector<float>& f1, const std::vector<float>& f2);
+
 #endif // DISTANCE_H
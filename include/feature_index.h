@@ -0,0 +1,158 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Contains the shared FeatureType enum, the feature/distance dispatch
+  helpers and the precomputed feature index that is saved to disk so a
+  query does not have to re-extract the features of the whole database.
+*/
+
+#ifndef FEATURE_INDEX_H
+#define FEATURE_INDEX_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "features.h"
+#include "histogram_pyramid.h"
+#include "simhash.h"
+#include "vp_tree.h"
+#include "image_reader.h"
+#include "image_enumerator.h"
+#include "metrics.h"
+
+enum FeatureType {
+  Baseline,
+  RGChromHistogram,
+  RGBChromHistogram,
+  MultiHistogram,
+  TextureAndColor,
+  DNNEmbedding,
+  CustomDesign,
+  OrientedGradientHistogram,
+  FeatureTypeCount
+};
+
+// Parse a command line feature name (baseline, rghistogram, ...), returns false if unknown
+bool parseFeatureType(const std::string& name, FeatureType& type);
+
+// Command line name of a feature type (inverse of parseFeatureType)
+const char* featureTypeName(FeatureType type);
+
+// True for the feature types that need the DNN embedding CSV
+bool featureTypeNeedsEmbedding(FeatureType type);
+
+// True for the color histogram types that can count a sample of the pixels (rg, rgb, multi, texture + color)
+bool featureTypeSupportsSampling(FeatureType type);
+
+// Extract features for any feature type (returns 0 on success)
+// embedding is only used by DNNEmbedding and CustomDesign, sampling only by the types above
+int extractFeatures(FeatureType type, const cv::Mat& image, const std::vector<float>& embedding,
+                    std::vector<float>& features, const PixelSampling& sampling = PixelSampling());
+
+// Compute distance between two feature vectors with the metric of the feature type
+float computeDistance(FeatureType type, const std::vector<float>& a, const std::vector<float>& b);
+
+
+/*
+  Precomputed feature index
+
+  One row per database image, sorted by path so that ties in distance are
+  broken the same way as sorting {distance, path} pairs in the scan path.
+  Acceleration structures (coarse histogram pyramid, ...) are built from
+  the rows and saved as optional sections after the feature data.
+*/
+struct FeatureIndex {
+  FeatureType type = Baseline;
+  int dim = 0;                                   // feature vector length
+  uint64_t version = 0;                          // changes every time the index is rebuilt
+  std::vector<std::string> paths;                // image path for each row
+  std::vector<std::vector<float>> features;      // one feature vector per row
+  std::unordered_map<std::string, int> nameLookup;  // filename -> row
+
+  HistogramPyramid pyramid;  // only for RGBChromHistogram, MultiHistogram, TextureAndColor
+  SimHash simhash;           // binary signatures for the embedding and histogram types
+  VPTree vptree;             // metric tree, only for Baseline
+
+  int shardCount = 0;            // 0 = whole collection, else rows are split by shardOfImage
+  std::vector<int> shardIds;     // shards held by this index (sorted)
+
+  int size() const { return static_cast<int>(features.size()); }
+};
+
+// Heap allocations of a scan loop per image once it is warmed up (counted by alloc_counter.h, on the
+// scanning thread only). Every iteration is measured whole, from fetching the file to storing its result.
+struct ScanAllocations {
+  int warmupImages = 16;     // images whose allocations are not counted (scratch buffers still growing)
+  int images = 0;            // images measured after the warm-up
+  uint64_t read = 0;         // fetching the next file from the reader
+  uint64_t decode = 0;       // inside imdecode (the decoder objects OpenCV creates for every call)
+  uint64_t extract = 0;      // extraction, embedding lookup, distance and storing the row or result
+  int imagesAllocating = 0;  // measured images whose read or extract allocated
+
+  // One measured iteration: counts before next(), after it, around the decode and at the end
+  void add(uint64_t start, uint64_t afterRead, uint64_t beforeDecode, uint64_t afterDecode, uint64_t end) {
+    uint64_t readCount = afterRead - start;
+    uint64_t decodeCount = afterDecode - beforeDecode;
+    uint64_t extractCount = end - afterRead - decodeCount;
+    images++;
+    read += readCount;
+    decode += decodeCount;
+    extract += extractCount;
+    if (readCount + extractCount > 0) imagesAllocating++;
+  }
+};
+
+// Print the allocations per image, returns -1 if the loop's own code (everything but imdecode) allocated
+int reportScanAllocations(const ScanAllocations& allocations);
+
+struct IndexBuildOptions {
+  int simhashBits = kDefaultSimHashBits;  // 0 disables the SimHash signatures
+  ImageReaderOptions io;                  // read-ahead of the image files
+  EnumerateOptions enumerate;             // listing of the database directory
+  PixelSampling sampling;                 // pixels counted by the histogram types
+  ScanAllocations* allocations = nullptr; // filled in when set
+};
+
+// Build the index for every image in imageDir, a directory or an image pack (csvPath is needed for DNN/custom features)
+int buildFeatureIndex(const std::string& imageDir, FeatureType type, const std::string& csvPath,
+                      FeatureIndex& index, const IndexBuildOptions& options = IndexBuildOptions());
+
+struct FeatureExportOptions {
+  int threads = 0;             // extraction threads, 0 uses the hardware threads
+  EnumerateOptions enumerate;  // listing of the database directory
+  PixelSampling sampling;      // pixels counted by the histogram types
+};
+
+// Extract the features of every image into a CSV or binary (.cbft) feature file, rows in path order (returns 0 on success)
+int exportFeatures(const std::string& imageDir, FeatureType type, const std::string& csvPath,
+                   const std::string& outFile, const FeatureExportOptions& options = FeatureExportOptions());
+
+// Rebuild the filename lookup and the acceleration structures from the rows
+void finalizeFeatureIndex(FeatureIndex& index);
+
+// Write the index to a binary file (returns 0 on success)
+int saveFeatureIndex(const std::string& filename, const FeatureIndex& index);
+
+// Read an index written by saveFeatureIndex (returns 0 on success)
+int loadFeatureIndex(const std::string& filename, FeatureIndex& index);
+
+// Row of an image by its filename (not full path), -1 if not in the index
+int findIndexRow(const FeatureIndex& index, const std::string& filename);
+
+// True if the path looks like an index file rather than an image directory
+bool isFeatureIndexFile(const std::string& path);
+
+// Approximate heap bytes held by the index (rows, paths and acceleration structures)
+size_t featureIndexMemoryBytes(const FeatureIndex& index);
+
+// Per feature type metrics (cbir_query_duration_seconds, cbir_query_failures_total, cbir_index_memory_bytes)
+MetricHistogram& queryDurationMetric(FeatureType type);
+MetricCounter& queryFailuresMetric(FeatureType type);
+MetricGauge& indexMemoryMetric(FeatureType type);
+
+#endif // FEATURE_INDEX_H
@@ -0,0 +1,94 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Streaming writer for per-image feature files. The file stays open for
+  the whole run and rows are collected in a large buffer, so writing a
+  collection costs a few big writes instead of an open/write/close per
+  image. Floats are formatted with std::to_chars. A new file is written
+  under a temporary name and renamed on close(), readers never see half
+  a file. Rows can come from several extraction threads, either in the
+  order they arrive or in the order of a sequence number.
+
+  Formats:
+    CSV (.csv and everything else) - "name,v1,v2,..." per line, the format of csv_util
+    Binary (.cbft) - "CBFT", u32 version, then per row: u32 name length, name,
+                     u32 value count, the values as 32-bit floats
+*/
+
+#ifndef FEATURE_WRITER_H
+#define FEATURE_WRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum FeatureFileFormat {
+  FeatureFileCsv,
+  FeatureFileBinary
+};
+
+struct FeatureWriterOptions {
+  FeatureFileFormat format = FeatureFileCsv;
+  bool append = false;             // add rows to an existing file in place (not atomic), instead of replacing it
+  bool ordered = false;            // rows are written in sequence order (write(sequence, ...)), not as they arrive
+  size_t bufferBytes = 1 << 20;    // rows are kept in memory until this much is waiting
+  int precision = 4;               // digits after the decimal point in CSV output
+};
+
+class FeatureWriter {
+public:
+  FeatureWriter() = default;
+  ~FeatureWriter();  // a file that was not closed is discarded (appended rows are flushed)
+
+  FeatureWriter(const FeatureWriter&) = delete;
+  FeatureWriter& operator=(const FeatureWriter&) = delete;
+
+  // Start writing filename (returns 0 on success, -1 if the file cannot be created)
+  int open(const std::string& filename, const FeatureWriterOptions& options = FeatureWriterOptions());
+
+  // Add a row in arrival order (unordered writers, returns 0 on success)
+  int write(const std::string& name, const std::vector<float>& features);
+
+  // Add row `sequence` of an ordered writer (0, 1, 2, ...), rows that arrive early wait until the ones before them
+  int write(size_t sequence, const std::string& name, const std::vector<float>& features);
+
+  // Sequence number that will not get a row (image failed), later rows are not held back by it
+  void skip(size_t sequence);
+
+  // Flush, close and move the file into place (returns 0 on success)
+  int close();
+
+  size_t rows() const;
+
+private:
+  void formatRow(const std::string& name, const std::vector<float>& features, std::string& row) const;
+  int appendLocked(const std::string& row);
+  void releaseReadyLocked();
+  int flushLocked();
+
+  FeatureWriterOptions options_;
+  std::string filename_;
+  std::string tempFilename_;  // empty when appending in place
+  FILE* file_ = nullptr;
+  std::string buffer_;
+  std::map<size_t, std::string> early_;  // ordered rows that arrived before their turn (empty string: skipped)
+  size_t nextSequence_ = 0;
+  size_t rows_ = 0;
+  bool failed_ = false;
+  mutable std::mutex mutex_;
+};
+
+// Format for a feature file name (.cbft is binary, everything else CSV)
+FeatureFileFormat featureFileFormat(const std::string& filename);
+
+// Read a CSV or binary feature file (detected from its first bytes), returns 0 on success
+int readFeatureFile(const std::string& filename, std::vector<std::string>& names,
+                    std::vector<std::vector<float>>& data);
+
+#endif // FEATURE_WRITER_H
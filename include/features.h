@@ -11,16 +11,80 @@
 #define FEATURES_H
 
 #include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
 #include <vector>
 
+// Growable byte buffer that hands out Mats over its memory
+class ScratchBuffer {
+public:
+  // rows x cols Mat of the given type (the buffer is grown if it is too small, never shrunk)
+  cv::Mat mat(int rows, int cols, int type);
+
+private:
+  std::vector<unsigned char> bytes_;
+};
+
+/*
+  Per-thread working memory of the extractors
+
+  Intermediate images (gray, Sobel gradients, HSV, ...) are written into
+  these buffers instead of new Mats, and histograms are counted straight
+  into the caller's feature vector. Once the buffers and the feature row
+  have grown to the largest image, extracting another image allocates
+  nothing on our side.
+*/
+struct FeatureScratch {
+  cv::Mat decoded;  // decode target of the scan loops, reused from image to image
+  ScratchBuffer gray, sobelX, sobelY, absX, absY, magnitude, hsv;
+};
+
+// Scratch of the calling thread
+FeatureScratch& threadFeatureScratch();
+
+/*
+  Pixel sampling of the color histograms
+
+  The RG, RGB, multi-histogram and texture + color (color part) extractors
+  can count a subset of the pixels: every stride-th pixel of every
+  stride-th row, or one pseudo-random pixel in each cell of a grid sized
+  for about targetSamples pixels (stratified, so the sample still covers
+  the whole image). The counts are scaled by pixels / samples so a sampled
+  histogram has the same mass as a full one and intersection distances
+  stay comparable. The random picks depend only on the seed, the image size
+  and the cell, so the same image is always sampled the same way.
+*/
+enum PixelSampleMode {
+  SampleAll,         // every pixel (the default)
+  SampleStride,      // fixed stride in both directions
+  SampleStratified   // one random pixel per grid cell
+};
+
+struct PixelSampling {
+  PixelSampleMode mode = SampleAll;
+  int stride = 1;             // SampleStride
+  int targetSamples = 0;      // SampleStratified, about this many pixels per image
+  uint32_t seed = 5330;       // SampleStratified
+};
+
+// Parse --sample-stride N or --sample-count N at argv[i] (advances i past the value), returns false if not one
+bool parsePixelSamplingOption(int argc, char* argv[], int& i, PixelSampling& sampling);
+
+// Short description: all, stride/4 or stratified/16384
+std::string pixelSamplingName(const PixelSampling& sampling);
+
 // Prototypes
 int extractBaselineFeatures(const cv::Mat& image, std::vector<float>& features);
-int extractRGChromHistogram(const cv::Mat& image, std::vector<float>& features, int bins = 16); // default 16 bins
-int extractRGBChromHistogram(const cv::Mat& image, std::vector<float>& features, int bins = 8); // default 8 bins for 3D histogram
+int extractRGChromHistogram(const cv::Mat& image, std::vector<float>& features, int bins = 16, // default 16 bins
+                            const PixelSampling& sampling = PixelSampling());
+int extractRGBChromHistogram(const cv::Mat& image, std::vector<float>& features, int bins = 8, // default 8 bins for 3D histogram
+                             const PixelSampling& sampling = PixelSampling());
 
-int extractMultiHistogram(const cv::Mat& image, std::vector<float>& features);
+int extractMultiHistogram(const cv::Mat& image, std::vector<float>& features,
+                          const PixelSampling& sampling = PixelSampling());
 
-int extractTextureAndColor(const cv::Mat& image, std::vector<float>& features);
+int extractTextureAndColor(const cv::Mat& image, std::vector<float>& features,
+                           const PixelSampling& sampling = PixelSampling());
 
 int extractCustomFeaturesWithEmbedding(const cv::Mat& image, const std::vector<float>& embedding, std::vector<float>& features);
 
@@ -0,0 +1,50 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Coarse-to-fine histogram pyramid used to prune histogram intersection
+  searches. An 8x8x8 RGB histogram is collapsed to 4x4x4 and 2x2x2 bins;
+  since min(sum a, sum b) >= sum min(a, b), the intersection of the coarse
+  histograms is an upper bound on the fine intersection, so the coarse
+  distance is a lower bound on the fine distance.
+*/
+
+#ifndef HISTOGRAM_PYRAMID_H
+#define HISTOGRAM_PYRAMID_H
+
+#include <vector>
+
+// One histogram inside a feature vector, distances average the intersection of all segments
+struct HistogramSegment {
+  int offset;    // first bin in the feature vector
+  int size;      // number of bins
+  bool rgbCube;  // 8x8x8 RGB cube (collapsible), otherwise compared at full size on every level
+};
+
+const int kPyramidLevels = 2;  // level 0 = 2x2x2, level 1 = 4x4x4
+
+struct HistogramPyramid {
+  std::vector<HistogramSegment> segments;
+  int levelDim[kPyramidLevels] = {0, 0};       // floats per row on each level
+  std::vector<float> levels[kPyramidLevels];   // normalized coarse histograms, rows * levelDim
+
+  bool empty() const { return segments.empty(); }
+};
+
+// Floats per row on a level for this segment layout
+int pyramidLevelDim(const std::vector<HistogramSegment>& segments, int level);
+
+// Build the normalized coarse levels for every row
+void buildHistogramPyramid(const std::vector<std::vector<float>>& rows,
+                           const std::vector<HistogramSegment>& segments, HistogramPyramid& pyramid);
+
+// Compute the coarse levels of a single (query) feature vector
+void computePyramidLevels(const HistogramPyramid& pyramid, const std::vector<float>& features,
+                          std::vector<float> queryLevels[kPyramidLevels]);
+
+// Lower bound on the fine distance between the query and a row, using one coarse level
+float pyramidLowerBound(const HistogramPyramid& pyramid, int level, const float* queryLevel, int row);
+
+#endif // HISTOGRAM_PYRAMID_H
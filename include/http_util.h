@@ -0,0 +1,81 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Minimal HTTP/1.1 over TCP for the query server and its clients
+  (Winsock on Windows, BSD sockets elsewhere). Only what the server needs:
+  one request per connection, Content-Length bodies, no chunking or TLS.
+*/
+
+#ifndef HTTP_UTIL_H
+#define HTTP_UTIL_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+using SocketHandle = std::intptr_t;
+const SocketHandle kInvalidSocket = -1;
+
+struct HttpRequest {
+  std::string method;                                  // GET, POST, ...
+  std::string path;                                    // target without the query string
+  std::unordered_map<std::string, std::string> query;  // decoded query parameters
+  std::string body;
+};
+
+struct HttpResponse {
+  int status = 200;
+  std::string contentType = "application/json";
+  std::string body;
+};
+
+// Start the socket library (Winsock), safe to call more than once
+bool netInit();
+
+// Listen on host:port (127.0.0.1 keeps the server local), returns kInvalidSocket on error
+SocketHandle httpListen(const std::string& host, int port, int backlog = 64);
+
+// Wait for the next connection, returns kInvalidSocket on error
+SocketHandle httpAccept(SocketHandle listener);
+
+// Same, retrying transient failures (out of descriptors, aborted connections) with a growing pause,
+// returns kInvalidSocket only once the listener cannot accept anymore
+SocketHandle httpAcceptRetry(SocketHandle listener);
+
+// Read one request from a connection (returns false on a malformed or oversized request)
+bool httpReadRequest(SocketHandle conn, HttpRequest& request);
+
+// Write a response and its Content-Length header
+bool httpWriteResponse(SocketHandle conn, const HttpResponse& response);
+
+void httpClose(SocketHandle conn);
+
+// Send timeouts in milliseconds for reads and writes on a connection (0 = none)
+void httpSetTimeout(SocketHandle conn, int timeoutMs);
+
+/*
+  Client side: send one request and read the whole response
+
+  Returns 0 on success, -1 if the server could not be reached or the
+  response was malformed (timeoutMs = 0 waits forever).
+*/
+int httpFetch(const std::string& host, int port, const std::string& method, const std::string& target,
+              const std::string& body, HttpResponse& response, int timeoutMs = 0);
+
+// Percent-encoding for query parameters
+std::string urlEncode(const std::string& value);
+std::string urlDecode(const std::string& value);
+
+// "a=1&b=2" from query parameters (percent-encoded)
+std::string encodeQueryString(const std::unordered_map<std::string, std::string>& query);
+
+// Escape a string for use inside a JSON string literal
+std::string jsonEscape(const std::string& value);
+
+// Split "host:port", returns false if the port is missing or invalid
+bool parseHostPort(const std::string& address, std::string& host, int& port);
+
+#endif // HTTP_UTIL_H
@@ -0,0 +1,59 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Lists the images of a database directory. Nested directories are walked
+  by a pool of threads, and the result is kept in a manifest (every
+  directory with its mtime, every image with its size and mtime) so the
+  next run only has to stat what the manifest names: a directory whose
+  mtime is unchanged has had nothing added, removed or renamed in it, and
+  only changed directories are listed again.
+*/
+
+#ifndef IMAGE_ENUMERATOR_H
+#define IMAGE_ENUMERATOR_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct EnumerateOptions {
+  bool recursive = true;     // false lists only the top directory
+  int threads = 0;           // directories listed (or stat'ed) at the same time, 0 uses at least 8 (the walk waits on I/O)
+  bool useManifest = true;   // validate and rewrite the manifest instead of always walking
+  std::string manifestFile;  // empty uses a file in the temp directory named after the database directory
+};
+
+// One image of the listing
+struct ImageRecord {
+  std::string path;
+  uint64_t size = 0;
+  int64_t mtime = 0;  // modification time in filesystem ticks
+};
+
+// How a listing was produced, for the timing messages
+struct EnumerateStats {
+  bool fromManifest = false;  // the manifest was still valid, nothing was listed
+  int directoriesListed = 0;
+  int directoriesStatted = 0;
+  int filesStatted = 0;
+};
+
+// True for the image extensions every tool accepts (.jpg .jpeg .png .ppm .tif .tiff .bmp, in any case)
+bool isImageFile(const std::filesystem::path& path);
+
+// Every image under imageDir sorted by path (returns 0 on success, -1 if imageDir cannot be listed)
+int enumerateImages(const std::string& imageDir, std::vector<ImageRecord>& images,
+                    const EnumerateOptions& options = EnumerateOptions(), EnumerateStats* stats = nullptr);
+
+// Same, paths only
+int enumerateImages(const std::string& imageDir, std::vector<std::string>& paths,
+                    const EnumerateOptions& options = EnumerateOptions(), EnumerateStats* stats = nullptr);
+
+// Parse --flat, --enum-threads N, --no-manifest or --manifest FILE at argv[i], returns true (and advances i) if it was one of them
+bool parseEnumerateOption(int argc, char* argv[], int& i, EnumerateOptions& options);
+
+#endif // IMAGE_ENUMERATOR_H
@@ -0,0 +1,89 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Image pack: the encoded files of an image collection concatenated into
+  one container with an offset/length table, so a cold scan opens one
+  file instead of one per image. The reader memory-maps the pack and
+  images are decoded straight from the mapped bytes. An image inside a
+  pack is addressed as "<pack.cbpk>/<name>" everywhere a path is used.
+*/
+
+#ifndef IMAGE_PACK_H
+#define IMAGE_PACK_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ImagePackEntry {
+  std::string name;     // filename inside the pack
+  uint64_t offset = 0;  // of the encoded bytes from the start of the file
+  uint64_t size = 0;
+};
+
+class ImagePack {
+public:
+  ~ImagePack();
+
+  ImagePack(const ImagePack&) = delete;
+  ImagePack& operator=(const ImagePack&) = delete;
+
+  // Map a pack file (nullptr if it cannot be opened or is not a valid pack)
+  static std::shared_ptr<const ImagePack> open(const std::string& filename);
+
+  const std::string& filename() const { return filename_; }
+  int size() const { return static_cast<int>(entries_.size()); }
+  const ImagePackEntry& entry(int i) const { return entries_[i]; }
+
+  // Encoded bytes of an entry, valid as long as the pack is
+  const unsigned char* data(int i) const { return base_ + entries_[i].offset; }
+
+  // "<pack>/<name>", the path the scan reports for an entry
+  std::string path(int i) const { return filename_ + "/" + entries_[i].name; }
+
+  // Entry by name, -1 if it is not in the pack
+  int find(const std::string& name) const;
+
+  // Ask the OS to start reading an entry into memory
+  void prefetch(int i) const;
+
+private:
+  ImagePack() = default;
+
+  std::string filename_;
+  std::vector<ImagePackEntry> entries_;
+  std::unordered_map<std::string, int> lookup_;
+  const unsigned char* base_ = nullptr;
+  size_t length_ = 0;
+#ifdef _WIN32
+  void* fileHandle_ = nullptr;
+  void* mappingHandle_ = nullptr;
+#endif
+};
+
+// True if the path is a pack file (.cbpk)
+bool isImagePackFile(const std::string& path);
+
+// Write every image under a directory into a new pack, named by their path below it and sorted (returns 0 on success)
+int createImagePack(const std::string& imageDir, const std::string& packFile);
+
+// Add image files (or every image under a directory) to the end of a pack, names already in it
+// are skipped (returns the number added, -1 on failure)
+int appendImagePack(const std::string& packFile, const std::vector<std::string>& inputs);
+
+// Shared mapping of a pack, reused until the file changes on disk (nullptr on failure)
+std::shared_ptr<const ImagePack> openImagePack(const std::string& packFile);
+
+// Split "<pack.cbpk>/<name>" into the pack file and the entry name, false for a normal path
+bool splitPackPath(const std::string& path, std::string& packFile, std::string& name);
+
+// cv::imread that also reads images inside a pack
+cv::Mat readImage(const std::string& path, int flags = cv::IMREAD_COLOR);
+
+#endif // IMAGE_PACK_H
@@ -0,0 +1,79 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Reads whole image files ahead of the decoder. A scan used to block in
+  cv::imread on every open and read; the reader keeps up to queueDepth
+  files in flight (io_uring when built with liburing, otherwise a pool of
+  threads doing pread) and hands their bytes to cv::imdecode in path
+  order. File buffers come from a fixed pool and are reused, so the scan
+  stops allocating once the buffers have grown to the largest file.
+  The entries of an image pack are handed out straight from its mapping.
+*/
+
+#ifndef IMAGE_READER_H
+#define IMAGE_READER_H
+
+#include <opencv2/opencv.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct ImageReaderOptions {
+  int queueDepth = 16;     // files being opened/read at the same time
+  int bufferCount = 32;    // file buffers: files in flight plus read files waiting for the decoder (at least 2)
+  bool useIoUring = true;  // false forces the pread thread pool
+};
+
+// One file as handed to the decoder
+struct ImageFile {
+  int index = -1;                       // position in the path list
+  std::string path;
+  int error = 0;                        // 0, or the errno of the failed open/read
+  const unsigned char* data = nullptr;  // whole file, valid until the next call to next()
+  size_t size = 0;
+};
+
+class ReadBackend;
+class ImagePack;
+
+class ImageReader {
+public:
+  explicit ImageReader(std::vector<std::string> paths, const ImageReaderOptions& options = ImageReaderOptions());
+
+  // Every entry of an image pack sorted by name, decoded from the mapping (the next queueDepth entries are prefetched)
+  explicit ImageReader(std::shared_ptr<const ImagePack> pack, const ImageReaderOptions& options = ImageReaderOptions());
+  ~ImageReader();
+
+  ImageReader(const ImageReader&) = delete;
+  ImageReader& operator=(const ImageReader&) = delete;
+
+  // Next file in path order (waits until it has been read), false after the last one
+  // (file.path gets the capacity of the longest path on the first call, reusing file does not allocate)
+  bool next(ImageFile& file);
+
+  // Path of file.index
+  const std::string& path(int index) const { return paths_[index]; }
+
+  // "io_uring", "pread" or "pack"
+  const char* backendName() const;
+
+private:
+  std::vector<std::string> paths_;
+  size_t longestPath_ = 0;
+  std::unique_ptr<ReadBackend> backend_;
+};
+
+// Decode the bytes of a file without copying them (empty Mat if the read failed or they are not an image)
+cv::Mat decodeImageFile(const ImageFile& file, int flags = cv::IMREAD_COLOR);
+
+// Decode into image, reusing its pixels when the size and type are unchanged (false, and image released,
+// if the read failed or the bytes do not decode)
+bool decodeImageFile(const ImageFile& file, cv::Mat& image, int flags = cv::IMREAD_COLOR);
+
+// Parse --io-depth N, --io-buffers N or --io-pread at argv[i], returns true (and advances i) if it was one of them
+bool parseImageReaderOption(int argc, char* argv[], int& i, ImageReaderOptions& options);
+
+#endif // IMAGE_READER_H
@@ -0,0 +1,85 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Contains prototypes for top-k searches against a precomputed feature index.
+*/
+
+#ifndef INDEX_SEARCH_H
+#define INDEX_SEARCH_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "feature_index.h"
+
+// How the index is searched
+enum SearchMode {
+  SearchAuto,        // fastest exact method available for the feature type
+  SearchExhaustive,  // compute every distance
+  SearchPyramid,     // coarse-to-fine histogram bound cascade (exact)
+  SearchSimHash,     // Hamming prefilter on SimHash signatures (approximate, never picked by SearchAuto)
+  SearchVPTree,      // vantage-point tree for baseline SSD (exact)
+  SearchCascade      // DNN term first, skin/brightness only for survivors (CustomDesign, exact)
+};
+
+struct SearchOptions {
+  SearchMode mode = SearchAuto;
+  int simhashCandidates = 2000;  // rows that get an exact distance after the Hamming prefilter
+};
+
+// Work done by one query, used by the benchmark and for debugging
+struct SearchStats {
+  int candidates = 0;       // rows in the index
+  int fullyScored = 0;      // rows whose exact distance was computed
+  int pruned = 0;           // rows rejected by a bound
+  uint64_t binsTouched = 0; // feature values read to compute distances and bounds
+  int signaturesCompared = 0; // SimHash Hamming distances computed
+  int nodesVisited = 0;     // VP-tree nodes whose vantage point was compared
+  int nodesSkipped = 0;     // VP-tree points in subtrees pruned by the triangle inequality
+};
+
+struct IndexMatch {
+  float distance;
+  int row;
+};
+
+// Method SearchAuto picks for an index (other modes are returned unchanged)
+SearchMode resolveSearchMode(const FeatureIndex& index, SearchMode mode);
+
+// Top-k rows of the index sorted by {distance, row}, same order as the exhaustive scan
+int searchIndex(const FeatureIndex& index, const std::vector<float>& query, int k,
+                const SearchOptions& options, std::vector<IndexMatch>& results,
+                SearchStats* stats = nullptr);
+
+// Exhaustive top-k, the reference every other mode has to match
+void searchExhaustive(const FeatureIndex& index, const std::vector<float>& query, int k,
+                      std::vector<IndexMatch>& results, SearchStats* stats = nullptr);
+
+// Exhaustive top-k of several queries in one pass over the rows (results[i] for queries[i], ks[i])
+void searchExhaustiveBatch(const FeatureIndex& index, const std::vector<const std::vector<float>*>& queries,
+                           const std::vector<int>& ks, std::vector<std::vector<IndexMatch>>& results);
+
+// Coarse-to-fine histogram cascade, exact results with far fewer bins touched
+void searchPyramid(const FeatureIndex& index, const std::vector<float>& query, int k,
+                   std::vector<IndexMatch>& results, SearchStats* stats = nullptr);
+
+// SimHash prefilter: exact distances only for the candidates closest in Hamming distance
+void searchSimHash(const FeatureIndex& index, const std::vector<float>& query, int k, int candidates,
+                   std::vector<IndexMatch>& results, SearchStats* stats = nullptr);
+
+// Exact k-NN on the vantage-point tree (Baseline indexes)
+void searchVPTree(const FeatureIndex& index, const std::vector<float>& query, int k,
+                  std::vector<IndexMatch>& results, SearchStats* stats = nullptr);
+
+// Two-stage custom distance: rank on the DNN term, fully score only the survivors
+void searchCustomCascade(const FeatureIndex& index, const std::vector<float>& query, int k,
+                         std::vector<IndexMatch>& results, SearchStats* stats = nullptr);
+
+// Every row within maxDistance of the query (SSD for Baseline, 0 = exact duplicates)
+int searchIndexRange(const FeatureIndex& index, const std::vector<float>& query, float maxDistance,
+                     std::vector<IndexMatch>& results, SearchStats* stats = nullptr);
+
+#endif // INDEX_SEARCH_H
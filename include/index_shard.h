@@ -0,0 +1,41 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Splitting a feature index into shards by hashing image IDs, and merging
+  the shards a server process owns back into one in-memory index. Each
+  shard keeps the global row order (sorted by path), so per-shard top-k
+  lists merged by {distance, path} give exactly the unsharded result.
+*/
+
+#ifndef INDEX_SHARD_H
+#define INDEX_SHARD_H
+
+#include <string>
+#include <vector>
+#include "feature_index.h"
+
+// Shard that owns an image, from a hash of its filename (the image ID)
+int shardOfImage(const std::string& filename, int shardCount);
+
+// Split an index into shardCount shards (shards[i] holds shard i)
+int splitFeatureIndex(const FeatureIndex& index, int shardCount, std::vector<FeatureIndex>& shards);
+
+/*
+  Add the rows of another shard of the same index
+
+  Both must come from the same build (type, dim, version, shard count) and
+  hold different shards. SimHash signatures are kept, the pyramid and the
+  VP-tree are rebuilt for the merged rows.
+
+  Output:
+    int - 0 on success, -1 if the shards do not belong together
+*/
+int mergeFeatureIndexShard(FeatureIndex& index, const FeatureIndex& shard);
+
+// Filename of shard i: "<prefix>.shard<i>of<n>.cbix"
+std::string shardIndexFilename(const std::string& prefix, int shardId, int shardCount);
+
+#endif // INDEX_SHARD_H
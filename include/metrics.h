@@ -0,0 +1,117 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  In-process metrics for long-running processes (query server, GUI):
+  counters, gauges and latency histograms with power-of-two buckets, kept
+  in one registry and exported in the Prometheus text format, either from
+  a small localhost HTTP listener or by rewriting a file periodically.
+
+  Recording is a relaxed atomic add on one of kMetricShards cache lines,
+  picked per thread, so concurrent threads do not fight over one line.
+  Look a metric up once (a function-local static reference) and record on
+  it; the registry lookup itself takes a lock.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+const int kMetricShards = 16;
+const int kHistogramBuckets = 28;  // upper bounds 1us * 2^i for i = 0..26, then +Inf
+
+inline std::atomic<int> g_nextMetricShard{0};
+
+// Shard of the calling thread, threads are spread round-robin
+inline int metricShard() {
+  thread_local int shard = g_nextMetricShard.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+  return shard;
+}
+
+class MetricCounter {
+public:
+  void add(uint64_t n = 1) { shards_[metricShard()].value.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t value() const;
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> value{0};
+  };
+  Shard shards_[kMetricShards];
+};
+
+class MetricGauge {
+public:
+  void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+  void add(int64_t delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<int64_t> value_{0};
+};
+
+class MetricHistogram {
+public:
+  void observeNs(uint64_t ns) {
+    Shard& shard = shards_[metricShard()];
+    shard.buckets[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+    shard.sumNs.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  void observe(std::chrono::steady_clock::duration elapsed) {
+    observeNs(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+  }
+
+  // Bucket b counts durations up to 2^b microseconds (the last one everything longer)
+  static int bucketFor(uint64_t ns) {
+    int bucket = ns == 0 ? 0 : std::bit_width((ns - 1) / 1000);
+    return bucket < kHistogramBuckets - 1 ? bucket : kHistogramBuckets - 1;
+  }
+
+  // Totals over the shards: per-bucket counts (not cumulative), the count and the sum in nanoseconds
+  void snapshot(uint64_t (&buckets)[kHistogramBuckets], uint64_t& count, uint64_t& sumNs) const;
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> buckets[kHistogramBuckets] = {};
+    std::atomic<uint64_t> sumNs{0};
+  };
+  Shard shards_[kMetricShards];
+};
+
+// Metric registered under a name and label set, created on first use and never freed
+// labels are Prometheus label pairs without braces, e.g. type="rghistogram"
+MetricCounter& metricCounter(const std::string& name, const std::string& help, const std::string& labels = "");
+MetricGauge& metricGauge(const std::string& name, const std::string& help, const std::string& labels = "");
+MetricHistogram& metricHistogram(const std::string& name, const std::string& help, const std::string& labels = "");
+
+// Every registered metric in the Prometheus text exposition format
+std::string metricsToPrometheus();
+
+// Write metricsToPrometheus() to a file under a temporary name and rename it (returns 0 on success)
+int writeMetricsFile(const std::string& filename);
+
+// Serve GET /metrics on host:port from a background thread (returns 0 once listening)
+int startMetricsServer(const std::string& host, int port);
+
+// Rewrite the file every intervalMs from a background thread
+void startMetricsFile(const std::string& filename, int intervalMs);
+
+// CBIR_METRICS_PORT=N and/or CBIR_METRICS_FILE=path (every CBIR_METRICS_INTERVAL_MS, default 10000)
+void startMetricsFromEnvironment();
+
+// Metrics recorded by the shared code
+MetricCounter& imagesDecodedMetric();     // images decoded successfully
+MetricCounter& decodeFailuresMetric();    // files that could not be read or decoded
+MetricCounter& imageBytesReadMetric();    // encoded image bytes handed to the decoder
+MetricCounter& resultCacheHitsMetric();
+MetricCounter& resultCacheMissesMetric();
+
+#endif // METRICS_H
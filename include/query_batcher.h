@@ -0,0 +1,86 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Micro-batching of concurrent exhaustive queries. Under load many
+  single-image queries against the same index arrive within a few
+  milliseconds of each other; scoring them together reads the feature
+  matrix once per batch instead of once per query.
+*/
+
+#ifndef QUERY_BATCHER_H
+#define QUERY_BATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "feature_index.h"
+#include "index_search.h"
+
+struct BatchOptions {
+  int maxBatch = 16;      // queries scored in one pass (1 disables batching)
+  int maxWaitUs = 2000;   // longest a query waits for others to join its batch
+};
+
+struct BatchStats {
+  uint64_t batches = 0;
+  uint64_t queries = 0;       // queries answered through a batch
+  int largestBatch = 0;
+  double windowUs = 0.0;      // batching window picked for the last batch
+};
+
+/*
+  Leader/follower batcher, one lane per feature type
+
+  The first query to arrive on an idle lane becomes the leader: it waits for
+  the batching window (or until the batch is full), takes the queued queries
+  for its index and scores them with searchExhaustiveBatch. Followers sleep
+  until their results are filled in, or take over as leader when the lane is
+  free again. The window follows the arrival rate: it is long enough to fill
+  a batch at the current rate, capped at maxWaitUs, and zero when queries are
+  too far apart for waiting to pay off.
+*/
+class QueryBatcher {
+public:
+  explicit QueryBatcher(const BatchOptions& options = BatchOptions());
+
+  // Exhaustive top-k of one query, same results as searchExhaustive
+  void search(const FeatureIndex& index, const std::vector<float>& query, int k,
+              std::vector<IndexMatch>& results, SearchStats* stats = nullptr);
+
+  BatchStats stats() const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Pending {
+    const FeatureIndex* index;
+    const std::vector<float>* query;
+    int k;
+    std::vector<IndexMatch>* results;
+    bool taken = false;  // in a batch that another thread is scoring
+    bool done = false;
+  };
+
+  struct Lane {
+    std::deque<Pending*> queue;
+    bool leader = false;          // a thread is collecting or scoring a batch
+    double gapUs = -1.0;          // moving average of the time between arrivals (-1 = unknown)
+    Clock::time_point lastArrival;
+  };
+
+  double windowUs(const Lane& lane) const;  // mutex_ held
+
+  BatchOptions options_;
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  Lane lanes_[FeatureTypeCount];
+  BatchStats stats_;
+};
+
+#endif // QUERY_BATCHER_H
@@ -0,0 +1,156 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Query service behind cbir_server: holds the loaded feature indexes (one
+  per feature type) and answers top-k queries given by image path, encoded
+  image bytes or the filename of a database image. The indexes are read-only
+  once loaded, so any number of threads can query at the same time.
+
+  The loaded indexes form a snapshot behind one atomic shared_ptr (RCU
+  style). A reload builds and warms up a new snapshot off to the side and
+  swaps it in with a single pointer exchange; queries already running keep
+  the old snapshot alive until they finish.
+*/
+
+#ifndef QUERY_SERVICE_H
+#define QUERY_SERVICE_H
+
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "feature_index.h"
+#include "index_search.h"
+#include "result_cache.h"
+#include "query_batcher.h"
+
+enum QueryStatus {
+  QueryOk = 0,
+  QueryBadRequest,    // missing or invalid parameters
+  QueryNoIndex,       // no index loaded for the requested feature type
+  QueryImageFailed,   // image could not be read/decoded or features failed
+  QueryNotInIndex     // named image (or its embedding) is not in the index
+};
+
+struct QueryRequest {
+  bool hasType = false;      // false = the only loaded index
+  FeatureType type = Baseline;
+  std::string name;          // filename of a database image (pic.0164.jpg)
+  std::string path;          // image path readable by the server
+  std::string imageBytes;    // encoded image (jpg/png/...) sent by the client
+  std::vector<float> features;  // precomputed query features (sent by a shard coordinator)
+  int k = 4;
+  SearchOptions search;
+};
+
+struct QueryHit {
+  std::string path;
+  float distance;
+};
+
+struct QueryResponse {
+  QueryStatus status = QueryOk;
+  std::string error;         // message for a failed query
+  FeatureType type = Baseline;
+  std::vector<QueryHit> hits;  // best first
+  SearchStats stats;
+  double elapsedMs = 0.0;    // feature extraction + search
+  bool cached = false;       // answered from the result cache
+  std::vector<int> missingShards;  // shards that did not answer in time (coordinator only)
+};
+
+// Indexes served at one point in time, never modified once published
+struct IndexSnapshot {
+  std::map<FeatureType, std::shared_ptr<const FeatureIndex>> indexes;
+  std::map<FeatureType, std::vector<std::string>> files;  // files each index was loaded from
+  std::map<std::string, std::filesystem::file_time_type> fileTimes;
+  uint64_t generation = 0;  // +1 for every published snapshot
+};
+
+class QueryService {
+public:
+  QueryService();
+  ~QueryService();
+
+  // Load an index file, replacing any index of the same feature type (returns 0 on success)
+  // further shards of an already loaded sharded index are merged into it
+  int loadIndex(const std::string& filename);
+
+  /*
+    Reload the index files that changed on disk (all of them with force)
+
+    Runs on the calling thread while queries go on against the current
+    snapshot. The new indexes are loaded and warmed up before the swap;
+    the old snapshot is freed by whichever holder releases it last (this
+    thread, or the last query still running on it).
+
+    Output:
+      int - number of feature types reloaded, -1 if a file failed to load
+            (the current snapshot stays in place)
+  */
+  int reloadIndexes(bool force = false);
+
+  // Current snapshot, holding it keeps every index in it alive
+  std::shared_ptr<const IndexSnapshot> snapshot() const { return snapshot_.load(); }
+
+  // Answer one query, safe to call from many threads
+  QueryStatus query(const QueryRequest& request, QueryResponse& response) const;
+
+  // Only the query features of a request (used by the coordinator to extract them once)
+  QueryStatus queryFeatures(const QueryRequest& request, std::vector<float>& features,
+                            std::shared_ptr<const FeatureIndex>& index, std::string& error) const;
+
+  // Index for a feature type in the current snapshot, nullptr if none is loaded
+  // (the pointer keeps its snapshot alive)
+  std::shared_ptr<const FeatureIndex> findIndex(FeatureType type) const;
+
+  // Index a request is answered with (explicit type, or the only loaded index)
+  std::shared_ptr<const FeatureIndex> selectIndex(const QueryRequest& request) const;
+
+  std::vector<FeatureType> types() const;
+
+  // Result cache memory budget (0 disables it) and its hit/miss counters
+  void setCacheBudget(size_t budgetBytes) { cache_.setBudget(budgetBytes); }
+  ResultCacheStats cacheStats() const { return cache_.stats(); }
+
+  // Score concurrent exhaustive queries of the same feature type together (maxBatch <= 1 turns it off)
+  void enableBatching(const BatchOptions& options);
+  BatchStats batchStats() const;
+
+private:
+  // Warm up the new indexes, swap the snapshot in and free the old one once it is unused
+  // (current is the snapshot next was made from, the caller hands over its reference)
+  void publish(std::shared_ptr<IndexSnapshot> next, std::shared_ptr<const IndexSnapshot> current);
+
+  std::atomic<std::shared_ptr<const IndexSnapshot>> snapshot_;
+  std::mutex reloadMutex_;  // one writer at a time, readers never take it
+  mutable ResultCache cache_;  // keyed by query features, type, k, mode and index version
+  std::unique_ptr<QueryBatcher> batcher_;
+};
+
+/*
+  Query features for an index
+
+  Decodes imageBytes, or reads path, and extracts the index feature type.
+  DNN/custom embeddings come from the row of queryName. Without an image the
+  features are taken straight from the row of queryName.
+
+  Output:
+    QueryStatus - QueryOk, or the reason (error describes it)
+*/
+QueryStatus extractQueryFeatures(const FeatureIndex& index, const std::string& queryName, const std::string& path,
+                                 const std::string& imageBytes, std::vector<float>& features, std::string& error);
+
+// Serialize a response as JSON ({"status":"ok","results":[...]} or {"status":"error",...})
+std::string queryResponseToJson(const QueryResponse& response);
+
+// Serialize the hits as "distance<TAB>path" lines (used by the cbir thin client)
+std::string queryResponseToTsv(const QueryResponse& response);
+
+#endif // QUERY_SERVICE_H
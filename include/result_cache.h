@@ -0,0 +1,103 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  LRU cache of query results. Popular images get queried over and over,
+  and a query with the same features, feature type, k and index version
+  always has the same answer, so it can skip the search entirely.
+*/
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "feature_index.h"
+
+static const size_t kDefaultResultCacheBytes = 64 * 1024 * 1024;
+
+// {distance, path} pairs, best first (same as the cbir scan results)
+using CachedResults = std::vector<std::pair<float, std::string>>;
+
+struct ResultCacheKey {
+  uint64_t featureHash = 0;   // hashQueryFeatures of the query
+  FeatureType type = Baseline;
+  int k = 0;
+  int mode = 0;               // search mode, approximate modes have their own entries
+  uint64_t indexVersion = 0;  // FeatureIndex::version (or a directory version for scans)
+
+  bool operator==(const ResultCacheKey& other) const {
+    return featureHash == other.featureHash && type == other.type && k == other.k &&
+           mode == other.mode && indexVersion == other.indexVersion;
+  }
+};
+
+struct ResultCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t insertions = 0;
+  uint64_t evictions = 0;      // dropped to stay under the memory budget
+  uint64_t invalidations = 0;  // dropped because their index was refreshed
+  size_t entries = 0;
+  size_t bytes = 0;            // estimated memory used by the entries
+  size_t budgetBytes = 0;
+};
+
+// 64-bit FNV-1a over the raw float bits, identical features give identical hashes
+uint64_t hashQueryFeatures(const std::vector<float>& features);
+
+/*
+  Thread-safe LRU result cache with a memory budget
+
+  The full query features are kept in each entry and compared on lookup,
+  so a hash collision is a miss, never a wrong answer.
+*/
+class ResultCache {
+public:
+  explicit ResultCache(size_t budgetBytes = kDefaultResultCacheBytes);
+
+  // Copy the cached results into results and mark the entry most recently used
+  // (a disabled cache finds nothing and counts neither a hit nor a miss)
+  bool lookup(const ResultCacheKey& key, const std::vector<float>& features, CachedResults& results);
+
+  // Add (or replace) an entry, evicting least recently used entries over the budget
+  void insert(const ResultCacheKey& key, const std::vector<float>& features, const CachedResults& results);
+
+  // Index of a feature type was (re)loaded: drop its entries for every other version
+  void setIndexVersion(FeatureType type, uint64_t version);
+
+  // budgetBytes = 0 disables the cache
+  void setBudget(size_t budgetBytes);
+  void clear();
+  ResultCacheStats stats() const;
+
+private:
+  struct Entry {
+    ResultCacheKey key;
+    std::vector<float> features;
+    CachedResults results;
+    size_t bytes;
+  };
+  struct KeyHash {
+    size_t operator()(const ResultCacheKey& key) const;
+  };
+
+  void evictToBudget();  // mutex_ held
+  void erase(std::list<Entry>::iterator it);  // mutex_ held
+
+  mutable std::mutex mutex_;
+  std::list<Entry> entries_;  // most recently used first
+  std::unordered_map<ResultCacheKey, std::list<Entry>::iterator, KeyHash> lookup_;
+  std::unordered_map<int, uint64_t> versions_;  // current index version per feature type
+  ResultCacheStats stats_;
+};
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,90 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Scatter-gather coordinator for a sharded index. The query features are
+  extracted once by the shard that owns the query image, sent to every
+  shard server, and the per-shard top-k lists are merged by
+  {distance, path}, which is exactly the order of the unsharded index.
+  A shard that times out is left out of the answer (reported as partial),
+  and a shard that keeps failing is skipped for a while instead of
+  stalling every query for the full timeout.
+*/
+
+#ifndef SHARD_COORDINATOR_H
+#define SHARD_COORDINATOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "http_util.h"
+#include "thread_pool.h"
+
+struct CoordinatorOptions {
+  int timeoutMs = 2000;        // per query, for each shard server
+  int failuresBeforeDown = 3;  // consecutive failures before a server is skipped
+  int downMs = 5000;           // how long a failing server is skipped before it is tried again
+  int maxInFlight = 32;        // shard calls running at once, over all queries
+};
+
+class ShardCoordinator {
+public:
+  explicit ShardCoordinator(const CoordinatorOptions& options = CoordinatorOptions());
+  ~ShardCoordinator();  // drops the calls still queued, waits for the running ones
+
+  // Shard id is served at address (host:port), returns -1 for an invalid address
+  int addShard(int shardId, const std::string& address);
+
+  // Check that shards 0..n-1 all have a server (returns 0 on success)
+  int validate() const;
+
+  // Answer a /query request by fanning it out to the shard servers
+  HttpResponse handleQuery(const HttpRequest& request);
+
+  // Per-server latency and failure counters as a JSON object
+  std::string statsJson() const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Server {
+    std::string host;
+    int port = 0;
+    std::vector<int> shardIds;
+    double latencyMs = 0.0;        // moving average of successful calls
+    int consecutiveFailures = 0;
+    Clock::time_point downUntil;   // skipped until then after repeated failures
+    uint64_t calls = 0, failures = 0, skipped = 0, malformed = 0;
+  };
+
+  struct CallResult {
+    bool ok = false;               // got an HTTP response in time
+    HttpResponse response;
+  };
+
+  // Call every server in parallel, waiting at most timeoutMs (results[i] for servers[i])
+  void fanOut(const std::vector<int>& servers, const std::string& method, const std::string& target,
+              const std::string& body, std::vector<CallResult>& results);
+
+  bool isDown(int server, Clock::time_point now) const;  // mutex_ held
+  void record(int server, bool ok, double ms);            // mutex_ held
+  void markFailed(int server);                            // mutex_ held
+
+  // Query features from the server owning the query image (falls back to any live server)
+  int fetchFeatures(const HttpRequest& request, std::string& features, HttpResponse& failure);
+
+  CoordinatorOptions options_;
+  mutable std::mutex mutex_;
+  std::vector<Server> servers_;
+  std::vector<int> shardServer_;   // shard id -> index into servers_
+  std::atomic<bool> stopping_{false};
+  std::unique_ptr<ThreadPool> calls_;  // last member, joined before the rest is destroyed
+};
+
+#endif // SHARD_COORDINATOR_H
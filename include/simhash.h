@@ -0,0 +1,45 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  SimHash binary signatures from random hyperplane projections. Two vectors
+  disagree on a signature bit with probability angle / pi, so the Hamming
+  distance between signatures (a few popcounts) is a cheap prefilter before
+  the exact distance functions.
+*/
+
+#ifndef SIMHASH_H
+#define SIMHASH_H
+
+#include <vector>
+#include <cstdint>
+#include "histogram_pyramid.h"  // HistogramSegment
+
+const int kDefaultSimHashBits = 256;
+
+struct SimHash {
+  int bits = 0;                        // signature length, multiple of 64
+  int dim = 0;                         // feature vector length
+  std::vector<HistogramSegment> normalizeSegments;  // histograms are normalized to sum 1 before projecting
+  std::vector<float> mean;             // subtracted before projecting (empty = no centering)
+  std::vector<float> planes;           // bits * dim hyperplane normals
+  std::vector<uint64_t> signatures;    // rows * words()
+
+  int words() const { return bits / 64; }
+  bool empty() const { return bits == 0; }
+};
+
+// Build random hyperplanes and the signature of every row
+// histograms (non-empty segments) are normalized and centered on the collection mean
+void buildSimHash(const std::vector<std::vector<float>>& rows, int dim, int bits,
+                  const std::vector<HistogramSegment>& normalizeSegments, SimHash& simhash);
+
+// Signature of a single (query) feature vector, signature has words() values
+void computeSimHash(const SimHash& simhash, const std::vector<float>& features, uint64_t* signature);
+
+// Number of differing bits between two signatures (hardware popcount)
+int hammingDistance(const uint64_t* a, const uint64_t* b, int words);
+
+#endif // SIMHASH_H
@@ -0,0 +1,63 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Top-k that a scan fills while other threads read it. The scanning thread
+  keeps the k best {distance, path} pairs in a private heap and publishes an
+  immutable sorted snapshot every so often; readers check a version number
+  and only take the (k entry) snapshot when it changed, so the GUI can show
+  the best matches so far without copying anything per frame.
+*/
+
+#ifndef STREAMING_TOPK_H
+#define STREAMING_TOPK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Published state of a scan
+struct TopKSnapshot {
+  uint64_t version = 0;
+  std::vector<std::pair<float, std::string>> entries;  // best first, ties by path
+  int scanned = 0;        // images scored so far
+  int total = 0;          // images to score (0 if unknown)
+  bool complete = false;  // final results of a finished scan
+};
+
+class StreamingTopK {
+public:
+  // capacity = number of best matches kept
+  explicit StreamingTopK(int capacity);
+
+  // Writer (one thread): offer a match, returns true if it entered the top-k
+  bool offer(float distance, const std::string& path);
+
+  // Writer: publish the current top-k if it changed (or the scan is complete)
+  void publish(int scanned, int total, bool complete = false);
+
+  // Writer: publish at most once per interval while the scan runs
+  void publishEvery(std::chrono::milliseconds interval, int scanned, int total);
+
+  // Readers (any thread): version of the latest snapshot (0 = nothing published)
+  uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
+  // Readers: latest snapshot, never null
+  std::shared_ptr<const TopKSnapshot> snapshot() const { return snapshot_.load(); }
+
+private:
+  int capacity_;
+  std::vector<std::pair<float, std::string>> heap_;  // writer only, worst match on top
+  bool changed_ = false;
+  std::chrono::steady_clock::time_point lastPublish_;
+  std::atomic<uint64_t> version_{0};
+  std::atomic<std::shared_ptr<const TopKSnapshot>> snapshot_;
+};
+
+#endif // STREAMING_TOPK_H
@@ -0,0 +1,76 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Scoped trace events in the Chrome Trace Event format (open the file in
+  chrome://tracing or ui.perfetto.dev). CBIR_TRACE_SCOPE("decode") records
+  how long the enclosing block took on the current thread.
+
+  The scopes are compiled in when CBIR_ENABLE_TRACE is defined (the
+  CBIR_TRACE CMake option, on by default) and expand to nothing otherwise.
+  Recording is off until startTrace() is called or the CBIR_TRACE
+  environment variable names an output file; until then a scope costs one
+  relaxed atomic load. Each thread writes its own fixed-size ring buffer
+  without locks (the oldest events are overwritten), and writeTrace() or
+  the exit handler collects all of them into one JSON file.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+inline std::atomic<bool> g_traceEnabled{false};
+
+inline bool traceEnabled() {
+  return g_traceEnabled.load(std::memory_order_relaxed);
+}
+
+// Nanoseconds since the process started tracing
+uint64_t traceNow();
+
+// Add a finished event to this thread's ring buffer (name must outlive the trace, e.g. a string literal)
+void recordTraceEvent(const char* name, uint64_t startNs, uint64_t durationNs);
+
+// Start recording; with a filename the trace is also written there when the process exits
+void startTrace(const std::string& exitFilename = "");
+
+// Stop recording, the events recorded so far are kept
+void stopTrace();
+
+// Every thread's recorded events as Chrome Trace Event JSON
+std::string traceToJson();
+
+// Write traceToJson() to a file (returns 0 on success, -1 if it cannot be written)
+int writeTrace(const std::string& filename);
+
+// Times the enclosing scope if recording was on when it started
+class TraceScope {
+public:
+  explicit TraceScope(const char* name) : name_(name), active_(traceEnabled()), start_(active_ ? traceNow() : 0) {}
+  ~TraceScope() {
+    if (active_) recordTraceEvent(name_, start_, traceNow() - start_);
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+  const char* name_;
+  bool active_;
+  uint64_t start_;
+};
+
+#ifdef CBIR_ENABLE_TRACE
+#define CBIR_TRACE_CONCAT_(a, b) a##b
+#define CBIR_TRACE_CONCAT(a, b) CBIR_TRACE_CONCAT_(a, b)
+#define CBIR_TRACE_SCOPE(name) TraceScope CBIR_TRACE_CONCAT(traceScope_, __LINE__)(name)
+#else
+#define CBIR_TRACE_SCOPE(name) ((void)0)
+#endif
+
+#endif // TRACE_H
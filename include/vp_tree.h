@@ -0,0 +1,53 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Vantage-point tree over baseline features. sqrt(SSD) is the Euclidean
+  distance, a true metric, so the triangle inequality lets a query skip
+  whole subtrees that cannot contain a closer match.
+*/
+
+#ifndef VP_TREE_H
+#define VP_TREE_H
+
+#include <vector>
+#include <utility>
+
+struct VPNode {
+  int row;          // vantage point (index row)
+  float threshold;  // median Euclidean distance from the vantage point to its subtree
+  int inside;       // child with distance <= threshold, -1 if none
+  int outside;      // child with distance >= threshold, -1 if none
+  int size;         // points in this subtree, including the vantage point
+};
+
+struct VPTree {
+  std::vector<VPNode> nodes;
+  int root = -1;
+
+  bool empty() const { return root < 0; }
+};
+
+// Work done by one VP-tree query
+struct VPTreeStats {
+  int nodesVisited = 0;         // vantage points whose distance was computed
+  int nodesSkipped = 0;         // points in subtrees pruned by the triangle inequality
+  int distanceEvaluations = 0;  // SSD computations
+};
+
+// Build the tree over all rows (one vantage point per node, median split)
+void buildVPTree(const std::vector<std::vector<float>>& rows, VPTree& tree);
+
+// Exact k nearest rows, results are {SSD, row} sorted like the exhaustive scan
+void vpTreeKnn(const VPTree& tree, const std::vector<std::vector<float>>& rows,
+               const std::vector<float>& query, int k,
+               std::vector<std::pair<float, int>>& results, VPTreeStats* stats = nullptr);
+
+// Every row with SSD <= maxSSD (0 finds exact duplicates), sorted by {SSD, row}
+void vpTreeRange(const VPTree& tree, const std::vector<std::vector<float>>& rows,
+                 const std::vector<float>& query, float maxSSD,
+                 std::vector<std::pair<float, int>>& results, VPTreeStats* stats = nullptr);
+
+#endif // VP_TREE_H
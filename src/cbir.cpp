@@ -14,46 +14,455 @@
 #include <string>
 #include <print>  // for modern C++ printing (C++23)
 #include <filesystem>  // for directory traversal (cross-platform)
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
 #include <opencv2/opencv.hpp>
 #include "features.h"
 #include "distance.h"
 #include "csv_util/csv_util.h"  // for reading csv files
+#include "feature_index.h"  // FeatureType and the precomputed feature index
+#include "index_search.h"
+#include "custom_cascade.h"  // two-stage custom distance
+#include "http_util.h"  // thin client for cbir_server
+#include "image_reader.h"  // read-ahead of the database files
+#include "image_pack.h"  // image packs in place of a directory
+#include "image_enumerator.h"  // parallel listing of nested database directories
+#include "trace.h"  // CBIR_TRACE=<file> records a Chrome trace of the query
+// this tool counts its heap allocations for --alloc-check
+#define CBIR_COUNT_ALLOCATIONS
+#include "alloc_counter.h"
 #include "unordered_map"  // for storing image features O(1) lookup
 
+#ifdef _WIN32
+#include <io.h>  // _dup, _dup2 for --explain-json -
+#else
+#include <unistd.h>  // dup, dup2 for --explain-json -
+#endif
+
 enum CBIRExitCode {
   Success = 0,
   MissingArg = 1,
-  ImageLoadFailed = 2
-};
-
-enum FeatureType {
-  Baseline,
-  RGChromHistogram,
-  RGBChromHistogram,
-  MultiHistogram,
-  TextureAndColor,
-  DNNEmbedding,
-  CustomDesign,
-  OrientedGradientHistogram
+  ImageLoadFailed = 2,
+  IndexLoadFailed = 3,
+  ServerFailed = 4,
+  AllocCheckFailed = 5
 };
 
-// Helper function to check if a file is an image based on extension
-bool isImageFile(const std::filesystem::path& path) {
-  std::string ext = path.extension().string();
-  return ext == ".jpg" || ext == ".png" || ext == ".ppm" || ext == ".tif";
-}
-
-// Helper function to the embedding for a filename from the csv file
-std::vector<float> getEmbedding(
+// Helper function to the embedding for a filename from the csv file (nullptr if it has none, no copy is made)
+const std::vector<float>* getEmbedding(
   const std::string& filename, 
   const std::unordered_map<std::string, int>& lookupIndex,
   const std::vector<std::vector<float>>& embeddings) {
   // Fast method: O(1) lookup with hash map, using auto keyword to infer type
   auto it = lookupIndex.find(filename);  // search for key
   if (it == lookupIndex.end()) {  // not found
-    return {};  // return empty vector
+    return nullptr;
+  }
+  return &embeddings[it->second];  // use the [2nd] index to get the embedding
+}
+
+// Stages timed for --explain
+enum ExplainStage {
+  StageList,      // directory listing or pack table
+  StageLoad,      // index file or CSV embeddings
+  StageQuery,     // query image decode and feature extraction
+  StageRead,      // waiting for the read-ahead of database files
+  StageDecode,
+  StageExtract,
+  StageDistance,
+  StageSearch,    // index search or custom cascade (distances included)
+  StageSort,
+  ExplainStageCount
+};
+
+static const char* kExplainStageNames[ExplainStageCount] = {
+  "list", "load", "query", "read", "decode", "extract", "distance", "search", "sort"
+};
+
+// What one query did, printed by --explain and written as JSON by --explain-json
+struct QueryExplain {
+  bool enabled = false;
+  std::string jsonFile;          // "-" prints the JSON instead of the text report
+  FILE* jsonOut = nullptr;       // the real stdout for "-", see takeStdoutForJson
+  std::string path = "scan";     // scan, index (<search mode>) or custom cascade
+  FeatureType type = Baseline;
+  int dim = 0;                   // query feature vector length
+  std::string sampling = "all";  // pixels counted by the histogram types
+  int images = 0;                // images in the database or rows in the index
+  int candidates = 0;            // images or rows considered
+  int pruned = 0;                // rejected by a bound before an exact distance
+  int fullyScored = 0;           // exact distance computed
+  int decodeFailures = 0;
+  int csvMisses = 0;             // images without an embedding in the CSV (skipped)
+  int extractFailures = 0;
+  double stageMs[ExplainStageCount] = {};
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+};
+
+// Milliseconds since lap, which is moved to now
+static double lapMs(std::chrono::steady_clock::time_point& lap) {
+  auto now = std::chrono::steady_clock::now();
+  double ms = std::chrono::duration<double, std::milli>(now - lap).count();
+  lap = now;
+  return ms;
+}
+
+// Distance function the feature type is ranked with
+static const char* distanceKernelName(FeatureType type) {
+  switch (type) {
+    case Baseline:                  return "sum of squared differences";
+    case RGChromHistogram:
+    case RGBChromHistogram:
+    case OrientedGradientHistogram: return "histogram intersection";
+    case MultiHistogram:            return "weighted multi-histogram intersection";
+    case TextureAndColor:           return "texture + color intersection";
+    case DNNEmbedding:              return "cosine";
+    case CustomDesign:              return "cosine + skin + brightness";
+    default:                        return "unknown";
+  }
+}
+
+// Instruction set the (scalar, compiler-vectorized) distance loops were built for
+static const char* compiledIsaName() {
+#if defined(__AVX512F__)
+  return "avx512f";
+#elif defined(__AVX2__)
+  return "avx2";
+#elif defined(__AVX__)
+  return "avx";
+#elif defined(__SSE4_2__)
+  return "sse4.2";
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  return "sse2";
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+static const char* searchModeName(SearchMode mode) {
+  switch (mode) {
+    case SearchExhaustive: return "exhaustive";
+    case SearchPyramid:    return "pyramid";
+    case SearchSimHash:    return "simhash";
+    case SearchVPTree:     return "vptree";
+    case SearchCascade:    return "cascade";
+    default:               return "auto";
+  }
+}
+
+std::string explainToJson(const QueryExplain& explain, double totalMs) {
+  std::string stages;
+  for (int s = 0; s < ExplainStageCount; s++) {
+    if (explain.stageMs[s] <= 0) continue;
+    stages += std::format("{}\"{}\":{:.3f}", stages.empty() ? "" : ",", kExplainStageNames[s], explain.stageMs[s]);
+  }
+  return std::format("{{\"path\":\"{}\",\"type\":\"{}\",\"dim\":{},\"sampling\":\"{}\",\"kernel\":\"{}\",\"isa\":\"{}\","
+                     "\"images\":{},\"candidates\":{},\"pruned\":{},\"fully_scored\":{},"
+                     "\"decode_failures\":{},\"csv_misses\":{},\"extract_failures\":{},"
+                     "\"stages_ms\":{{{}}},\"total_ms\":{:.3f}}}\n",
+                     jsonEscape(explain.path), featureTypeName(explain.type), explain.dim,
+                     explain.sampling, distanceKernelName(explain.type), compiledIsaName(), explain.images, explain.candidates,
+                     explain.pruned, explain.fullyScored, explain.decodeFailures, explain.csvMisses,
+                     explain.extractFailures, stages, totalMs);
+}
+
+/*
+  Keep stdout for the JSON of --explain-json -
+
+  The original stdout is duplicated for the JSON and stdout itself is
+  pointed at stderr, so every other line (progress, results, and the
+  printf calls inside csv_util) goes to stderr and the output can be
+  piped straight into a JSON tool.
+
+  Output:
+    FILE* - stream on the original stdout, nullptr if it cannot be duplicated
+*/
+FILE* takeStdoutForJson() {
+  std::fflush(stdout);
+#ifdef _WIN32
+  int fd = _dup(_fileno(stdout));
+  if (fd < 0 || _dup2(_fileno(stderr), _fileno(stdout)) != 0) return nullptr;
+  return _fdopen(fd, "wb");
+#else
+  int fd = dup(STDOUT_FILENO);
+  if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) return nullptr;
+  return fdopen(fd, "w");
+#endif
+}
+
+/*
+  Print the --explain report (or write it as JSON)
+
+  Input:
+    explain - counters and stage times collected by the query
+
+  Output:
+    int - 0 on success, -1 if the JSON file cannot be written
+*/
+int reportExplain(const QueryExplain& explain) {
+  if (!explain.enabled) return 0;
+  double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - explain.started).count();
+  if (explain.jsonFile == "-") {
+    FILE* out = explain.jsonOut ? explain.jsonOut : stdout;
+    std::print(out, "{}", explainToJson(explain, totalMs));
+    std::fflush(out);
+    return 0;
+  }
+
+  std::println("\nExplain:");
+  std::println("  path:       {}", explain.path);
+  std::println("  features:   {}, {} values", featureTypeName(explain.type), explain.dim);
+  if (featureTypeSupportsSampling(explain.type)) std::println("  pixels:     {}", explain.sampling);
+  std::println("  kernel:     {} (scalar loops, compiled for {})", distanceKernelName(explain.type),
+               compiledIsaName());
+  std::println("  images:     {} ({} candidates, {} pruned, {} fully scored)", explain.images,
+               explain.candidates, explain.pruned, explain.fullyScored);
+  std::println("  skipped:    {} failed to decode, {} missing from the CSV, {} failed to extract",
+               explain.decodeFailures, explain.csvMisses, explain.extractFailures);
+  std::string stages;
+  for (int s = 0; s < ExplainStageCount; s++) {
+    if (explain.stageMs[s] <= 0) continue;
+    stages += std::format("{}{} {:.1f}", stages.empty() ? "" : ", ", kExplainStageNames[s], explain.stageMs[s]);
+  }
+  std::println("  stages ms:  {} (total {:.1f})", stages, totalMs);
+
+  if (explain.jsonFile.empty()) return 0;
+  std::ofstream out(explain.jsonFile, std::ios::binary | std::ios::trunc);
+  if (!out || !(out << explainToJson(explain, totalMs))) {
+    std::println(stderr, "Error: Unable to write {}", explain.jsonFile);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+  Query a precomputed feature index instead of scanning the image directory
+
+  The feature type is the one the index was built with. DNN and custom
+  features take the query embedding from the index row of the query image.
+
+  Input:
+    indexFile - .cbix file written by cbir_index
+    queryPath - path of the query image
+    src - decoded query image
+    k - number of results
+    distances - output {distance, path} pairs, best first
+    sampling - pixels counted for a histogram query
+    explain - stage times and counters for --explain
+
+  Output:
+    int - CBIRExitCode
+*/
+int queryFeatureIndex(const std::string& indexFile, const std::string& queryPath, const cv::Mat& src,
+                      int k, std::vector<std::pair<float, std::string>>& distances, const PixelSampling& sampling,
+                      QueryExplain& explain) {
+  auto lap = std::chrono::steady_clock::now();
+  FeatureIndex index;
+  if (loadFeatureIndex(indexFile, index) != 0) {
+    return IndexLoadFailed;
+  }
+  explain.stageMs[StageLoad] += lapMs(lap);
+  std::println("Feature index: {} images, {} features", index.size(), featureTypeName(index.type));
+
+  std::vector<float> embedding;
+  if (featureTypeNeedsEmbedding(index.type)) {
+    std::string queryFilename = std::filesystem::path(queryPath).filename().string();
+    int row = findIndexRow(index, queryFilename);
+    if (row < 0) {
+      std::println(stderr, "Error: Query image {} not found in the index", queryFilename);
+      return ImageLoadFailed;
+    }
+    // the first 512 values of a custom feature vector are the embedding
+    const std::vector<float>& rowFeatures = index.features[row];
+    embedding.assign(rowFeatures.begin(), rowFeatures.begin() + std::min<size_t>(rowFeatures.size(), 512));
+  }
+
+  std::vector<float> queryFeatures;
+  if (extractFeatures(index.type, src, embedding, queryFeatures, sampling) != 0) {
+    std::println(stderr, "Error: Failed to extract features from query image");
+    return ImageLoadFailed;
+  }
+  explain.stageMs[StageQuery] += lapMs(lap);
+
+  std::vector<IndexMatch> matches;
+  SearchStats stats;
+  if (searchIndex(index, queryFeatures, k, SearchOptions(), matches, &stats) != 0) {
+    std::println(stderr, "Error: Query features do not match the index");
+    return IndexLoadFailed;
+  }
+  explain.stageMs[StageSearch] += lapMs(lap);
+  std::println("Scored {} of {} images ({} pruned)", stats.fullyScored, stats.candidates, stats.pruned);
+
+  explain.path = std::format("index ({})", searchModeName(resolveSearchMode(index, SearchAuto)));
+  explain.type = index.type;
+  explain.dim = static_cast<int>(queryFeatures.size());
+  explain.images = index.size();
+  explain.candidates = stats.candidates;
+  explain.pruned = stats.pruned;
+  explain.fullyScored = stats.fullyScored;
+
+  for (const auto& match : matches) {
+    distances.push_back(std::make_pair(match.distance, index.paths[match.row]));
+  }
+  return Success;
+}
+
+/*
+  Two-stage scan for the custom design features
+
+  Ranks every image on the DNN term using only the CSV embeddings, then
+  decodes and extracts skin/brightness only for the images that can still
+  make the top k. Same results as scoring every image with customDistance.
+
+  Input:
+    imageFiles - database image paths
+    queryFeatures - custom features of the query (529 values)
+    lookupIndex, embeddings - DNN embeddings from the CSV file
+    k - number of results
+    distances - output {distance, path} pairs, best first
+    explain - counters for --explain
+*/
+void scanCustomCascade(std::vector<std::string> imageFiles, const std::vector<float>& queryFeatures,
+                       const std::unordered_map<std::string, int>& lookupIndex,
+                       const std::vector<std::vector<float>>& embeddings, int k,
+                       std::vector<std::pair<float, std::string>>& distances, QueryExplain& explain) {
+  // sorted so ties break by path, same as sorting {distance, path} pairs
+  std::sort(imageFiles.begin(), imageFiles.end());
+
+  // Stage 1: DNN term only, no image decoding
+  std::vector<int> candidates;  // index into imageFiles
+  std::vector<float> dnnDistances;
+  for (int i = 0; i < (int)imageFiles.size(); i++) {
+    std::string imageFilename = std::filesystem::path(imageFiles[i]).filename().string();
+    auto it = lookupIndex.find(imageFilename);
+    if (it == lookupIndex.end()) {
+      std::println(stderr, "Error: Failed to extract features from image {}", imageFiles[i]);
+      explain.csvMisses++;
+      continue;
+    }
+    candidates.push_back(i);
+    dnnDistances.push_back(customDnnDistance(queryFeatures, embeddings[it->second]));
+  }
+
+  // Stage 2: skin and brightness for the survivors
+  std::vector<std::pair<float, int>> found;
+  CustomCascadeStats stats;
+  customCascadeTopK(dnnDistances, k, [&](int id, float& distance) {
+    const std::string& imageFile = imageFiles[candidates[id]];
+    cv::Mat image = readImage(imageFile);
+    if (image.empty()) {
+      std::println(stderr, "Error: Failed to load image {}", imageFile);
+      explain.decodeFailures++;
+      return false;
+    }
+    std::string imageFilename = std::filesystem::path(imageFile).filename().string();
+    std::vector<float> features;
+    if (extractCustomFeaturesWithEmbedding(image, embeddings[lookupIndex.at(imageFilename)], features) != 0) {
+      std::println(stderr, "Error: Failed to extract features from image {}", imageFile);
+      explain.extractFailures++;
+      return false;
+    }
+    distance = customDistance(queryFeatures, features);
+    return true;
+  }, found, &stats);
+
+  std::println("Custom cascade: decoded {} of {} images ({} within cutoff {:.4f})",
+    stats.fullyScored, stats.candidates, stats.survivors, stats.cutoff);
+  explain.path = "custom cascade";
+  explain.images = static_cast<int>(imageFiles.size());
+  explain.candidates = stats.candidates;
+  explain.pruned = stats.candidates - stats.survivors;
+  explain.fullyScored = stats.fullyScored;
+
+  for (const auto& match : found) {
+    distances.push_back(std::make_pair(match.first, imageFiles[candidates[match.second]]));
+  }
+}
+
+// Print the top 4 results and show the query next to the top 3 matches
+void displayResults(const cv::Mat& src, const std::vector<std::pair<float, std::string>>& distances) {
+  // Display top 4 results (query image + top 3 matches)
+  std::println("\nTop 4 similar images:");
+  for (int i = 0; i < 4 && i < (int)distances.size(); i++) {
+    std::filesystem::path p(distances[i].second); // get filename from path
+    std::println("{}: {} (distance: {:.6f})", i + 1, p.filename().string(), distances[i].first); // round to 6 decimal places
+  }
+
+  // Create combined display
+  cv::Mat display;
+  std::vector<cv::Mat> images;
+  images.push_back(src);
+
+  for (int i = 1; i < 4 && i < distances.size(); i++) {
+    cv::Mat match = readImage(distances[i].second);
+    if (match.empty()) continue;  // e.g. a server result that is not readable from here
+    images.push_back(match);
+  }
+
+  cv::hconcat(images, display);  // combine horizontally
+  cv::imshow("Query and Top 3 Matches", display);
+  cv::waitKey(0);
+}
+
+
+/*
+  Thin client for cbir_server: sends the query image bytes and prints the
+  results, no index is loaded and no features are extracted locally
+
+  Input:
+    address - server address (host:port)
+    queryPath - path of the query image (its filename finds the DNN embedding)
+    featureArg - feature type name, empty to use the only index on the server
+    k - number of results
+    distances - output {distance, path} pairs, best first
+
+  Output:
+    int - CBIRExitCode
+*/
+int queryServer(const std::string& address, const std::string& queryPath, const std::string& featureArg,
+                int k, std::vector<std::pair<float, std::string>>& distances) {
+  std::string host;
+  int port;
+  if (!parseHostPort(address, host, port)) {
+    std::println(stderr, "Error: Server address must be host:port, got {}", address);
+    return MissingArg;
+  }
+
+  std::ifstream file(queryPath, std::ios::binary);
+  if (!file) {
+    std::println(stderr, "Error: Failed to load query image {}", queryPath);
+    return ImageLoadFailed;
   }
-  return embeddings[it->second];  // use the [2nd] index to get the embedding
+  std::stringstream bytes;
+  bytes << file.rdbuf();
+
+  std::string target = "/query?format=tsv&k=" + std::to_string(k) +
+                       "&name=" + urlEncode(std::filesystem::path(queryPath).filename().string());
+  if (!featureArg.empty()) target += "&type=" + urlEncode(featureArg);
+
+  HttpResponse response;
+  if (httpFetch(host, port, "POST", target, bytes.str(), response) != 0) {
+    std::println(stderr, "Error: Failed to reach cbir_server at {}", address);
+    return ServerFailed;
+  }
+  if (response.status != 200) {
+    std::println(stderr, "Error: Server returned {}: {}", response.status, response.body);
+    return ServerFailed;
+  }
+
+  // one "distance<TAB>path" line per result
+  std::istringstream lines(response.body);
+  std::string line;
+  while (std::getline(lines, line)) {
+    size_t tab = line.find('\t');
+    if (tab == std::string::npos) continue;
+    distances.push_back(std::make_pair(std::stof(line.substr(0, tab)), line.substr(tab + 1)));
+  }
+  return Success;
 }
 
 
@@ -64,6 +473,12 @@ std::vector<float> getEmbedding(
   Usage:
   ./cbir.exe <query_image> <image_database_directory> [feature_type]
   ./cbir.exe data/olympus/pic.0164.jpg data/olympus rghistogram
+  ./cbir.exe <query_image> <index_file.cbix>
+  ./cbir.exe data/olympus/pic.0164.jpg features/olympus_rgb.cbix
+  ./cbir.exe --server <host:port> <query_image> [feature_type] [k]
+  ./cbir.exe --server 127.0.0.1:5330 data/olympus/pic.0164.jpg rgbhistogram
+  ./cbir.exe data/olympus/pic.0164.jpg data/olympus rghistogram --io-depth 64 --io-buffers 128
+  ./cbir.exe data/olympus/pic.0164.jpg data/olympus.cbpk rghistogram
   feature_type options:
     baseline  - 7x7 center pixel block (default)
     rghistogram - 2D rg chromaticity histogram with intersection
@@ -73,12 +488,99 @@ std::vector<float> getEmbedding(
     dnnembedding - DNN embedding with cosine distance
     customdesign - custom features and distance function 
     orientedgradient - histogram of edge orientations with custom distance
+  an image pack (built with cbir_pack) can be used in place of the
+  directory, images inside it are "<pack.cbpk>/<name>", an index file
+  (built with cbir_index) replaces the directory scan, the
+  feature type is the one the index was built with, --server sends the
+  query to a running cbir_server instead. --io-depth (files read at the
+  same time), --io-buffers (file buffers) and --io-pread (no io_uring)
+  tune the directory scan and can go anywhere on the command line.
+  Nested directories are listed too and the listing is kept in a manifest
+  that later runs only stat: --flat lists the top directory only,
+  --enum-threads N sets the listing threads, --manifest FILE picks the
+  manifest and --no-manifest always walks the tree. --explain prints what
+  the query did (path, candidates, skipped images, time per stage) and
+  --explain-json FILE also writes it as JSON ("-" prints only the JSON on
+  stdout, everything else goes to stderr). --explain is local only, the
+  server reports its own numbers on /stats.
+  --sample-stride N (every Nth pixel of every Nth row) or --sample-count N
+  (about N stratified random pixels) builds the color histograms from a
+  sample of the pixels, for the query and the scanned images alike.
+  --alloc-check counts the heap allocations of every scan iteration after
+  a warm-up and fails if anything but the decoder itself allocated
 */
 int main(int argc, char* argv[]) {
+  // Read-ahead and listing options are taken out first, the remaining arguments are positional
+  ImageReaderOptions ioOptions;
+  EnumerateOptions enumerateOptions;
+  QueryExplain explain;
+  PixelSampling sampling;  // histograms of the query and of the scanned images
+  ScanAllocations scanAllocations;
+  ScanAllocations* allocations = nullptr;  // set by --alloc-check
+  int positional = 1;
+  for (int i = 1; i < argc; i++) {
+    if (parseImageReaderOption(argc, argv, i, ioOptions) || parseEnumerateOption(argc, argv, i, enumerateOptions) ||
+        parsePixelSamplingOption(argc, argv, i, sampling)) {
+      continue;
+    }
+    std::string arg = argv[i];
+    if (arg == "--explain") {
+      explain.enabled = true;
+      continue;
+    }
+    if (arg == "--explain-json" && i + 1 < argc) {
+      explain.enabled = true;
+      explain.jsonFile = argv[++i];
+      continue;
+    }
+    if (arg == "--alloc-check") {
+      allocations = &scanAllocations;
+      continue;
+    }
+    argv[positional++] = argv[i];
+  }
+  argc = positional;
+
+  // Thin client mode: the server already has the index in memory
+  if (argc >= 3 && std::string(argv[1]) == "--server") {
+    if (explain.enabled) {
+      std::println(stderr, "Error: --explain reports a local query, the server's own numbers are on its /stats");
+      exit(MissingArg);
+    }
+    if (argc < 4) {
+      std::println("Usage: {} --server <host:port> <query_image> [feature_type] [k]", argv[0]);
+      exit(MissingArg);
+    }
+    std::string featureArg = argc >= 5 ? argv[4] : "";
+    int k = argc >= 6 ? std::atoi(argv[5]) : 4;
+    std::vector<std::pair<float, std::string>> distances;
+    int serverStatus = queryServer(argv[2], argv[3], featureArg, k, distances);
+    if (serverStatus != Success) {
+      exit(serverStatus);
+    }
+    cv::Mat src = readImage(argv[3]);
+    if (src.empty()) {
+      std::println(stderr, "Error: Failed to load query image {}", argv[3]);
+      exit(ImageLoadFailed);
+    }
+    displayResults(src, distances);
+    return Success;
+  }
+
+  // --explain-json -: stdout is the JSON alone from here on
+  if (explain.jsonFile == "-") explain.jsonOut = takeStdoutForJson();
+
   // 1. parse command line arguments
   // Error handling for missing arguments
   if (argc < 3) {
     std::println("Usage: {} <query_image> <image_database_directory> [feature_type]", argv[0]);
+    std::println("       {} <query_image> <index_file.cbix>", argv[0]);
+    std::println("       {} --server <host:port> <query_image> [feature_type] [k]", argv[0]);
+    std::println("  scan options: --io-depth N (default 16), --io-buffers N (default 32), --io-pread");
+    std::println("  listing options: --flat, --enum-threads N, --manifest FILE, --no-manifest");
+    std::println("  histogram options: --sample-stride N, --sample-count N (count a sample of the pixels)");
+    std::println("  report options: --explain, --explain-json FILE (- prints only the JSON on stdout), not with --server");
+    std::println("  check options: --alloc-check (the directory or pack scan must not allocate per image)");
     std::println("  feature_type: baseline (default), rghistogram, rgbhistogram, multihistogram, textureandcolor, customdesign, dnnembedding");
     exit(MissingArg);  // exit with error code
   }
@@ -104,8 +606,8 @@ int main(int argc, char* argv[]) {
     }
     else if (featureArg == "dnnembedding") {
       featureType = DNNEmbedding;
-      // requires a csv file
-      if (argc < 5) {
+      // requires a csv file (unless an index is used)
+      if (argc < 5 && !isFeatureIndexFile(imageDir)) {
         std::println(stderr, "Error: Missing csv file for DNN embedding");
         exit(MissingArg);
       } 
@@ -120,21 +622,58 @@ int main(int argc, char* argv[]) {
   
 
   // Read and load the query image
-  src = cv::imread(argv[1]);
+  auto lap = std::chrono::steady_clock::now();
+  explain.type = featureType;
+  explain.sampling = pixelSamplingName(sampling);
+  src = readImage(argv[1]);
   // Error handling: empty image
   if (src.empty()) {
     std::println(stderr, "Error: Failed to load query image {}", argv[1]);
     exit(ImageLoadFailed);
   }
+  explain.stageMs[StageQuery] += lapMs(lap);
+
+  // Precomputed feature index: no directory scan or feature extraction
+  if (isFeatureIndexFile(imageDir)) {
+    std::vector<std::pair<float, std::string>> distances;
+    int indexStatus = queryFeatureIndex(imageDir, argv[1], src, 4, distances, sampling, explain);
+    if (indexStatus != Success) {
+      exit(indexStatus);
+    }
+    reportExplain(explain);
+    displayResults(src, distances);
+    return Success;
+  }
 
 
-  // 2. Read directory
+  // 2. Read directory (or the table of an image pack)
   std::vector<std::string> imageFiles;
-  for (const auto& entry : std::filesystem::directory_iterator(imageDir)) {
-    if (entry.is_regular_file() && isImageFile(entry.path())) {
-      imageFiles.push_back(entry.path().string());
+  std::shared_ptr<const ImagePack> pack;
+  if (isImagePackFile(imageDir)) {
+    pack = openImagePack(imageDir);
+    if (!pack) {
+      exit(ImageLoadFailed);
+    }
+    for (int i = 0; i < pack->size(); i++) {
+      imageFiles.push_back(pack->path(i));
+    }
+  }
+  else {
+    auto listStart = std::chrono::steady_clock::now();
+    EnumerateStats listStats;
+    if (enumerateImages(imageDir, imageFiles, enumerateOptions, &listStats) != 0) {
+      exit(ImageLoadFailed);
+    }
+    double listMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - listStart).count();
+    if (listStats.fromManifest) {
+      std::println("Listed {} images from the manifest in {:.1f} ms ({} directories, {} files checked)",
+                   imageFiles.size(), listMs, listStats.directoriesStatted, listStats.filesStatted);
+    } else {
+      std::println("Listed {} images in {:.1f} ms ({} directories read)", imageFiles.size(), listMs,
+                   listStats.directoriesListed);
     }
   }
+  explain.stageMs[StageList] += lapMs(lap);
 
 
   // For DNN: load embeddings from CSV file
@@ -149,22 +688,23 @@ int main(int argc, char* argv[]) {
 
   if (featureType == RGChromHistogram) {
     std::println("2D RG Chromaticity Histogram (16x16 bins) with Histogram Intersection");
-    status = extractRGChromHistogram(src, queryFeatures, 16);
+    status = extractRGChromHistogram(src, queryFeatures, 16, sampling);
   }
   else if (featureType == RGBChromHistogram) {
     std::println("3D RGB Chromaticity Histogram (8x8x8 bins) with Histogram Intersection");
-    status = extractRGBChromHistogram(src, queryFeatures, 8);
+    status = extractRGBChromHistogram(src, queryFeatures, 8, sampling);
   }
   else if (featureType == MultiHistogram) {
     std::println("Multi-histogram");
-    status = extractMultiHistogram(src, queryFeatures);
+    status = extractMultiHistogram(src, queryFeatures, sampling);
   }
   else if (featureType == TextureAndColor) {
     std::println("Texture + Color");
-    status = extractTextureAndColor(src, queryFeatures);
+    status = extractTextureAndColor(src, queryFeatures, sampling);
   }
   else if (featureType == DNNEmbedding) {
     // read the csv file using the csv util
+    explain.stageMs[StageQuery] += lapMs(lap);
     int csvStatus = read_image_data_csv(argv[4], csvFilenames, csvEmbeddings, 0);
     if (csvStatus != 0) {
       std::println(stderr, "Error: Failed to read CSV file {}", argv[4]);
@@ -176,6 +716,7 @@ int main(int argc, char* argv[]) {
     for (int i = 0; i < csvFilenames.size(); i++) {
       csvLookupIndex[csvFilenames[i]] = i; // just the index to save memory
     }
+    explain.stageMs[StageLoad] += lapMs(lap);
 
     // find the index of the query image in the csv file
     // get just the filename from the query path
@@ -197,15 +738,17 @@ int main(int argc, char* argv[]) {
     // }
 
     // Fast method: O(1) lookup with hash map, using auto keyword to infer type
-    queryFeatures = getEmbedding(queryFilename, csvLookupIndex, csvEmbeddings);
-    if (queryFeatures.empty()) {  // not found
+    const std::vector<float>* queryEmbedding = getEmbedding(queryFilename, csvLookupIndex, csvEmbeddings);
+    if (!queryEmbedding) {  // not found
       std::println(stderr, "Error: Query image {} not found in CSV file", queryFilename);
       exit(ImageLoadFailed);
     }
+    queryFeatures = *queryEmbedding;
     status = 0;
   }
   else if (featureType == CustomDesign) {
     // read the csv file using the csv util (ONCE)
+    explain.stageMs[StageQuery] += lapMs(lap);
     int csvStatus = read_image_data_csv(const_cast<char*>("data/ResNet18_olym.csv"), csvFilenames, csvEmbeddings, 0);
     if (csvStatus != 0) {
       std::println(stderr, "Error: Failed to read CSV file");
@@ -217,21 +760,22 @@ int main(int argc, char* argv[]) {
     for (int i = 0; i < csvFilenames.size(); i++) {
       csvLookupIndex[csvFilenames[i]] = i;
     }
+    explain.stageMs[StageLoad] += lapMs(lap);
 
     std::println("Custom (DNN + skin + brightness)");
     
     // Get query embedding
     std::filesystem::path queryPath(argv[1]);
     std::string queryFilename = queryPath.filename().string();
-    std::vector<float> queryEmbedding = getEmbedding(queryFilename, csvLookupIndex, csvEmbeddings);
+    const std::vector<float>* queryEmbedding = getEmbedding(queryFilename, csvLookupIndex, csvEmbeddings);
     
-    if (queryEmbedding.empty()) {
+    if (!queryEmbedding) {
       std::println(stderr, "Error: Query image {} not found in CSV", queryFilename);
       exit(ImageLoadFailed);
     }
   
   // Extract custom features
-   status = extractCustomFeaturesWithEmbedding(src, queryEmbedding, queryFeatures);
+   status = extractCustomFeaturesWithEmbedding(src, *queryEmbedding, queryFeatures);
   }
   else if (featureType == OrientedGradientHistogram) {
     std::println("Oriented Gradient Histogram");
@@ -247,55 +791,89 @@ int main(int argc, char* argv[]) {
     std::println(stderr, "Error: Failed to extract features from query image");
     exit(ImageLoadFailed);
   }
+  explain.stageMs[StageQuery] += lapMs(lap);
+  explain.dim = static_cast<int>(queryFeatures.size());
+
+
+  // Custom design: the DNN term ranks the images before any of them is decoded
+  if (featureType == CustomDesign) {
+    std::vector<std::pair<float, std::string>> distances;
+    scanCustomCascade(imageFiles, queryFeatures, csvLookupIndex, csvEmbeddings, 4, distances, explain);
+    explain.stageMs[StageSearch] += lapMs(lap);
+    reportExplain(explain);
+    displayResults(src, distances);
+    return Success;
+  }
 
 
   // 4. Sort images by distance
-  std::vector<std::pair<float, std::string>> distances;
-
-  // iterate through all images in the directory
-  for (const auto& imageFile : imageFiles) {
-    cv::Mat image = cv::imread(imageFile);
+  // iterate through all images in the directory, files are read ahead while the previous one is decoded
+  // (a pack is decoded straight from its mapping)
+  std::unique_ptr<ImageReader> reader = pack ? std::make_unique<ImageReader>(pack, ioOptions)
+                                             : std::make_unique<ImageReader>(imageFiles, ioOptions);
+  // the file, the decoded image, the feature vector and the filename are reused from image to image and a
+  // result only keeps the reader's index of its path, so once warmed up an iteration allocates nothing
+  cv::Mat& image = threadFeatureScratch().decoded;
+  std::vector<float> features;
+  std::string imageFilename;
+  std::vector<std::pair<float, int>> scored;  // {distance, index of the path in the reader}
+  scored.reserve(imageFiles.size());
+  ImageFile file;
+  int iteration = 0;
+  lap = std::chrono::steady_clock::now();
+  for (;;) {
+    uint64_t start = heapAllocationCount();
+    if (!reader->next(file)) break;
+    uint64_t afterRead = heapAllocationCount();
+    bool measured = allocations && iteration++ >= allocations->warmupImages;
+    const std::string& imageFile = file.path;
+    explain.stageMs[StageRead] += lapMs(lap);
 
     // Error handling for image loading failure
-    if (image.empty()) {
+    uint64_t beforeDecode = heapAllocationCount();
+    if (!decodeImageFile(file, image)) {
       std::println(stderr, "Error: Failed to load image {}", imageFile);
+      explain.decodeFailures++;
       continue;
     }
+    uint64_t afterDecode = heapAllocationCount();
+    explain.stageMs[StageDecode] += lapMs(lap);
 
-    std::vector<float> features;
     int extractStatus;
+    bool csvMiss = false;  // no embedding for the image, counted apart from real extraction failures
+    const std::vector<float>* row = &features;  // a DNN embedding is used in place in the CSV table
 
     if (featureType == RGChromHistogram) {
-      extractStatus = extractRGChromHistogram(image, features, 16);
+      extractStatus = extractRGChromHistogram(image, features, 16, sampling);
     }
     else if (featureType == RGBChromHistogram) {
-      extractStatus = extractRGBChromHistogram(image, features, 8);
+      extractStatus = extractRGBChromHistogram(image, features, 8, sampling);
     }
     else if (featureType == MultiHistogram) {
-      extractStatus = extractMultiHistogram(image, features);
+      extractStatus = extractMultiHistogram(image, features, sampling);
     }
     else if (featureType == TextureAndColor) {
-      extractStatus = extractTextureAndColor(image, features);
+      extractStatus = extractTextureAndColor(image, features, sampling);
     }
     else if (featureType == DNNEmbedding) {
       // get the filename from the image path
-      std::filesystem::path imagePath(imageFile);
-      std::string imageFilename = imagePath.filename().string();
+      imageFilename.assign(imageFile, imageFile.find_last_of("/\\") + 1);  // npos + 1 is the whole path
 
       // O(1) lookup in hash map
-      features = getEmbedding(imageFilename, csvLookupIndex, csvEmbeddings);
-      extractStatus = features.empty() ? -1 : 0;
+      row = getEmbedding(imageFilename, csvLookupIndex, csvEmbeddings);
+      csvMiss = !row;
+      extractStatus = csvMiss ? -1 : 0;
     } 
     else if (featureType == CustomDesign) {
       // Get embedding for this image
-      std::filesystem::path imagePath(imageFile);
-      std::string imageFilename = imagePath.filename().string();
-      std::vector<float> imgEmbedding = getEmbedding(imageFilename, csvLookupIndex, csvEmbeddings);
+      imageFilename.assign(imageFile, imageFile.find_last_of("/\\") + 1);
+      const std::vector<float>* imgEmbedding = getEmbedding(imageFilename, csvLookupIndex, csvEmbeddings);
       
-      if (imgEmbedding.empty()) {
+      if (!imgEmbedding) {
+        csvMiss = true;
         extractStatus = -1;
       } else {
-        extractStatus = extractCustomFeaturesWithEmbedding(image, imgEmbedding, features);
+        extractStatus = extractCustomFeaturesWithEmbedding(image, *imgEmbedding, features);
       }
     } 
     else if (featureType == OrientedGradientHistogram) {
@@ -308,60 +886,71 @@ int main(int argc, char* argv[]) {
     // Error handling for feature extraction failure
     if (extractStatus != 0) {
       std::println(stderr, "Error: Failed to extract features from image {}", imageFile);
+      (csvMiss ? explain.csvMisses : explain.extractFailures)++;
       continue;
     }
+    explain.stageMs[StageExtract] += lapMs(lap);
 
-    // compute distance and store it with the filename
+    // compute distance and store it with the index of the path
+    CBIR_TRACE_SCOPE("distance");
     float distance;
     if (featureType == RGChromHistogram) {
-      distance = histogramIntersectionDistance(queryFeatures, features);
+      distance = histogramIntersectionDistance(queryFeatures, *row);
     }
     else if (featureType == RGBChromHistogram) {
-      distance = histogramIntersectionDistance(queryFeatures, features);
+      distance = histogramIntersectionDistance(queryFeatures, *row);
     }
     else if (featureType == MultiHistogram) {
-      distance = multiHistogramDistance(queryFeatures, features);
+      distance = multiHistogramDistance(queryFeatures, *row);
     }
     else if (featureType == TextureAndColor) {
-      distance = textureAndColorDistance(queryFeatures, features);
+      distance = textureAndColorDistance(queryFeatures, *row);
     }
     else if (featureType == DNNEmbedding) {
-      distance = cosineDistance(queryFeatures, features);
+      distance = cosineDistance(queryFeatures, *row);
     }
     else if (featureType == CustomDesign) {
-      distance = customDistance(queryFeatures, features);
+      distance = customDistance(queryFeatures, *row);
     }
     else if (featureType == OrientedGradientHistogram) {
-      distance = histogramIntersectionDistance(queryFeatures, features);
+      distance = histogramIntersectionDistance(queryFeatures, *row);
     }
     else {
-      distance = sumOfSquaredDifference(queryFeatures, features);
+      distance = sumOfSquaredDifference(queryFeatures, *row);
     }
 
-    distances.push_back(std::make_pair(distance, imageFile)); // {distance, filename} pair
+    scored.push_back(std::make_pair(distance, file.index)); // {distance, path index} pair
+    explain.stageMs[StageDistance] += lapMs(lap);
+    if (measured) allocations->add(start, afterRead, beforeDecode, afterDecode, heapAllocationCount());
   }
-  std::sort(distances.begin(), distances.end());
 
-  // 4.5 Display top 4 results (query image + top 3 matches)
-  std::println("\nTop 4 similar images:");
-  for (int i = 0; i < 4 && i < (int)distances.size(); i++) {
-    std::filesystem::path p(distances[i].second); // get filename from path
-    std::println("{}: {} (distance: {:.6f})", i + 1, p.filename().string(), distances[i].first); // round to 6 decimal places
+  // only the results shown need their path, ties break by path as before
+  std::vector<std::pair<float, std::string>> distances;
+  {
+    CBIR_TRACE_SCOPE("sort");
+    size_t shown = std::min<size_t>(4, scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + shown, scored.end(),
+                      [&](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+      if (a.first != b.first) return a.first < b.first;
+      return reader->path(a.second) < reader->path(b.second);
+    });
+    for (size_t i = 0; i < shown; i++) {
+      distances.push_back(std::make_pair(scored[i].first, reader->path(scored[i].second)));
+    }
   }
-
-  // Create combined display
-  cv::Mat display;
-  std::vector<cv::Mat> images;
-  images.push_back(src);
-
-  for (int i = 1; i < 4 && i < distances.size(); i++) {
-    cv::Mat match = cv::imread(distances[i].second);
-    images.push_back(match);
+  explain.stageMs[StageSort] += lapMs(lap);
+  explain.images = explain.candidates = static_cast<int>(imageFiles.size());
+  explain.fullyScored = static_cast<int>(scored.size());
+  reportExplain(explain);
+
+  // steady state: after the warm-up the loop must not allocate, only the decoder's own objects are allowed
+  int exitCode = Success;
+  if (allocations && reportScanAllocations(*allocations) != 0) {
+    exitCode = AllocCheckFailed;
   }
 
-  cv::hconcat(images, display);  // combine horizontally
-  cv::imshow("Query and Top 3 Matches", display);
-  cv::waitKey(0);
+  // 4.5 Display top 4 results (query image + top 3 matches)
+  displayResults(src, distances);
 
-  return Success;
+  return exitCode;
 }
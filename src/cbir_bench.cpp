@@ -0,0 +1,380 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Microbenchmarks for the hot functions - every extractor in features.h on
+  synthetic images of several sizes and on real database images, and every
+  distance in distance.h over batches of rows. Results can be written as
+  JSON and a later run compared against them with a regression threshold.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <print>  // for modern C++ printing (C++23)
+#include <format>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include "features.h"
+#include "distance.h"
+#include "image_enumerator.h"
+#include "image_pack.h"
+
+enum BenchToolExitCode {
+  Success = 0,
+  MissingArg = 1,
+  LoadFailed = 2,
+  Regression = 3
+};
+
+static void printUsage(const char* prog) {
+  std::println("Usage:");
+  std::println("  {} [--filter TEXT] [--data DIR|PACK] [--images N] [--min-time S] [--repetitions N]", prog);
+  std::println("     [--json FILE] [--compare BASELINE.json] [--threshold 0.10]");
+}
+
+struct BenchOptions {
+  double minSeconds = 0.2;          // time per repetition, the iteration count is grown until it is reached
+  int repetitions = 5;              // the median repetition is reported
+  std::string filter;               // only benchmarks whose name contains this
+  std::string dataDir = "data/olympus";
+  int realImages = 16;              // database images used for the real-image runs
+  std::string jsonFile;             // write the results here
+  std::string compareFile;          // compare against the results of an earlier run
+  double threshold = 0.10;          // slower than the baseline by more than this is a regression
+};
+
+// One benchmark result
+struct BenchResult {
+  std::string name;
+  double nsPerOp = 0.0;
+  double itemsPerSecond = 0.0;  // pixels/s for extractors, comparisons/s for distances
+  double bytesPerSecond = 0.0;
+  const char* itemUnit = "";
+  long long iterations = 0;
+};
+
+// Keeps results alive so the optimizer cannot drop the measured calls
+static volatile float g_sink;
+
+/*
+  Time one operation
+
+  The iteration count is doubled until a repetition takes at least
+  minSeconds, then the median of the repetitions is reported.
+
+  Input:
+    name - benchmark name
+    op - runs the operation once
+    itemsPerOp - pixels or comparisons done by one call
+    bytesPerOp - bytes read by one call
+    itemUnit - "pixels" or "comparisons"
+    options - timing settings
+
+  Output:
+    BenchResult - ns per call and the derived rates
+*/
+static BenchResult runBenchmark(const std::string& name, const std::function<void()>& op, double itemsPerOp,
+                                double bytesPerOp, const char* itemUnit, const BenchOptions& options) {
+  using clock = std::chrono::steady_clock;
+  auto timeIterations = [&](long long iterations) {
+    auto start = clock::now();
+    for (long long i = 0; i < iterations; i++) op();
+    return std::chrono::duration<double>(clock::now() - start).count();
+  };
+
+  op();  // warm-up, scratch buffers grow here
+  long long iterations = 1;
+  double seconds = timeIterations(iterations);
+  while (seconds < options.minSeconds && iterations < (1LL << 40)) {
+    iterations = seconds > 0.0 ? std::max(iterations * 2, static_cast<long long>(iterations * options.minSeconds / seconds * 1.2))
+                               : iterations * 10;
+    seconds = timeIterations(iterations);
+  }
+
+  std::vector<double> nsPerOp{seconds * 1e9 / iterations};
+  for (int r = 1; r < options.repetitions; r++) nsPerOp.push_back(timeIterations(iterations) * 1e9 / iterations);
+  std::sort(nsPerOp.begin(), nsPerOp.end());
+
+  BenchResult result;
+  result.name = name;
+  result.nsPerOp = nsPerOp[nsPerOp.size() / 2];
+  result.itemsPerSecond = itemsPerOp * 1e9 / result.nsPerOp;
+  result.bytesPerSecond = bytesPerOp * 1e9 / result.nsPerOp;
+  result.itemUnit = itemUnit;
+  result.iterations = iterations;
+  return result;
+}
+
+static void printResult(const BenchResult& result) {
+  std::println("{:<44} {:12.1f} ns/op  {:10.2f} M{}/s  {:9.1f} MB/s", result.name, result.nsPerOp,
+    result.itemsPerSecond / 1e6, result.itemUnit, result.bytesPerSecond / 1e6);
+}
+
+// Deterministic BGR test image: smooth gradients plus noise, so histograms have many occupied bins
+static cv::Mat syntheticImage(int width, int height) {
+  cv::Mat image(height, width, CV_8UC3);
+  std::mt19937 rng(5330);
+  for (int y = 0; y < height; y++) {
+    cv::Vec3b* row = image.ptr<cv::Vec3b>(y);
+    for (int x = 0; x < width; x++) {
+      unsigned noise = rng();
+      row[x][0] = static_cast<uchar>((x * 255 / width + (noise & 31)) & 255);
+      row[x][1] = static_cast<uchar>((y * 255 / height + ((noise >> 8) & 31)) & 255);
+      row[x][2] = static_cast<uchar>(((x + y) * 127 / (width + height) + ((noise >> 16) & 63)) & 255);
+    }
+  }
+  return image;
+}
+
+struct ExtractorCase {
+  const char* name;
+  std::function<int(const cv::Mat&, std::vector<float>&)> extract;
+};
+
+// Every extractor of features.h (the custom one with a fixed 512-value embedding)
+static std::vector<ExtractorCase> extractorCases(const std::vector<float>& embedding) {
+  return {
+    {"baseline", [](const cv::Mat& image, std::vector<float>& f) { return extractBaselineFeatures(image, f); }},
+    {"rghistogram", [](const cv::Mat& image, std::vector<float>& f) { return extractRGChromHistogram(image, f, 16); }},
+    {"rgbhistogram", [](const cv::Mat& image, std::vector<float>& f) { return extractRGBChromHistogram(image, f, 8); }},
+    {"multihistogram", [](const cv::Mat& image, std::vector<float>& f) { return extractMultiHistogram(image, f); }},
+    {"textureandcolor", [](const cv::Mat& image, std::vector<float>& f) { return extractTextureAndColor(image, f); }},
+    {"customdesign", [&embedding](const cv::Mat& image, std::vector<float>& f) {
+      return extractCustomFeaturesWithEmbedding(image, embedding, f);
+    }},
+    {"orientedgradient", [](const cv::Mat& image, std::vector<float>& f) { return extractOrientedGradientHistogram(image, f); }},
+  };
+}
+
+static bool selected(const std::string& name, const BenchOptions& options) {
+  return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+// Extractors on synthetic images of several sizes and on the first database images
+static void benchExtractors(const BenchOptions& options, std::vector<BenchResult>& results) {
+  std::vector<float> embedding(512);
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+  for (float& value : embedding) value = uniform(rng);
+
+  const int sizes[][2] = {{160, 120}, {640, 480}, {1920, 1080}};
+  std::vector<float> features;
+  for (const auto& extractor : extractorCases(embedding)) {
+    for (const auto& size : sizes) {
+      std::string name = std::format("extract/{}/synthetic_{}x{}", extractor.name, size[0], size[1]);
+      if (!selected(name, options)) continue;
+      cv::Mat image = syntheticImage(size[0], size[1]);
+      double pixels = static_cast<double>(size[0]) * size[1];
+      results.push_back(runBenchmark(name, [&]() {
+        extractor.extract(image, features);
+        g_sink = features.empty() ? 0.0f : features[0];
+      }, pixels, pixels * 3, "pixels", options));
+      printResult(results.back());
+    }
+  }
+
+  // real photographs have different histograms (and branch behaviour) than the synthetic ones
+  std::vector<std::string> files;
+  if (isImagePackFile(options.dataDir)) {
+    std::shared_ptr<const ImagePack> pack = openImagePack(options.dataDir);
+    for (int i = 0; pack && i < pack->size(); i++) files.push_back(pack->path(i));
+  } else if (std::filesystem::is_directory(options.dataDir)) {
+    enumerateImages(options.dataDir, files);
+  }
+  std::vector<cv::Mat> images;
+  double totalPixels = 0.0;
+  for (const auto& file : files) {
+    if (static_cast<int>(images.size()) >= options.realImages) break;
+    cv::Mat image = readImage(file);
+    if (image.empty()) continue;
+    totalPixels += static_cast<double>(image.total());
+    images.push_back(image);
+  }
+  if (images.empty()) {
+    std::println("(no images in {}, real-image extractor runs skipped)", options.dataDir);
+    return;
+  }
+
+  // one op is one image, cycling through the set
+  double pixelsPerImage = totalPixels / images.size();
+  for (const auto& extractor : extractorCases(embedding)) {
+    std::string name = std::format("extract/{}/real", extractor.name);
+    if (!selected(name, options)) continue;
+    size_t next = 0;
+    results.push_back(runBenchmark(name, [&]() {
+      extractor.extract(images[next], features);
+      next = next + 1 == images.size() ? 0 : next + 1;
+      g_sink = features.empty() ? 0.0f : features[0];
+    }, pixelsPerImage, pixelsPerImage * 3, "pixels", options));
+    printResult(results.back());
+  }
+}
+
+struct DistanceCase {
+  const char* name;
+  int dim;
+  bool histogram;  // rows are non-negative counts rather than signed values
+  float (*distance)(const std::vector<float>&, const std::vector<float>&);
+};
+
+// Every distance of distance.h across batch sizes: one op compares a query against a batch of rows
+static void benchDistances(const BenchOptions& options, std::vector<BenchResult>& results) {
+  const DistanceCase cases[] = {
+    {"sumOfSquaredDifference", 147, false, sumOfSquaredDifference},
+    {"histogramIntersectionDistance", 512, true, histogramIntersectionDistance},
+    {"multiHistogramDistance", 1024, true, multiHistogramDistance},
+    {"textureAndColorDistance", 528, true, textureAndColorDistance},
+    {"cosineDistance", 512, false, cosineDistance},
+    {"customDistance", 529, false, customDistance},
+    {"customDnnDistance", 529, false, customDnnDistance},
+  };
+  const int batchSizes[] = {1, 64, 1024, 16384};
+
+  std::mt19937 rng(7);
+  for (const auto& c : cases) {
+    auto randomRow = [&]() {
+      std::vector<float> row(c.dim);
+      std::uniform_real_distribution<float> value(c.histogram ? 0.0f : -1.0f, c.histogram ? 100.0f : 1.0f);
+      for (float& v : row) v = value(rng);
+      if (c.name == std::string("customDistance") || c.name == std::string("customDnnDistance")) {
+        for (int i = 512; i < c.dim; i++) row[i] = std::abs(row[i]) * 100.0f;  // skin counts and brightness
+      }
+      return row;
+    };
+    std::vector<float> query = randomRow();
+    std::vector<std::vector<float>> rows;
+    for (int batch : batchSizes) {
+      std::string name = std::format("distance/{}/batch_{}", c.name, batch);
+      if (!selected(name, options)) continue;
+      while (static_cast<int>(rows.size()) < batch) rows.push_back(randomRow());
+      results.push_back(runBenchmark(name, [&]() {
+        float sum = 0.0f;
+        for (int i = 0; i < batch; i++) sum += c.distance(query, rows[i]);
+        g_sink = sum;
+      }, batch, static_cast<double>(batch) * c.dim * sizeof(float) * 2, "comparisons", options));
+      printResult(results.back());
+    }
+  }
+}
+
+static void escapeJson(const std::string& text, std::string& out) {
+  for (char ch : text) {
+    if (ch == '"' || ch == '\\') out += '\\';
+    out += ch;
+  }
+}
+
+// One result per line, so a compare run (and a diff) can read it without a JSON library
+static int writeJson(const std::string& filename, const std::vector<BenchResult>& results) {
+  std::ofstream out(filename, std::ios::trunc);
+  if (!out) {
+    std::println(stderr, "Error: Unable to open {} for writing", filename);
+    return -1;
+  }
+  out << "{\"benchmarks\":[\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult& r = results[i];
+    std::string name;
+    escapeJson(r.name, name);
+    out << std::format("{{\"name\":\"{}\",\"ns_per_op\":{:.3f},\"items_per_second\":{:.1f},\"item_unit\":\"{}\","
+                       "\"bytes_per_second\":{:.1f},\"iterations\":{}}}{}\n",
+                       name, r.nsPerOp, r.itemsPerSecond, r.itemUnit, r.bytesPerSecond, r.iterations,
+                       i + 1 < results.size() ? "," : "");
+  }
+  out << "]}\n";
+  return out ? 0 : -1;
+}
+
+// ns/op of every benchmark in a file written by writeJson
+static int readJson(const std::string& filename, std::unordered_map<std::string, double>& nsPerOp) {
+  std::ifstream in(filename);
+  if (!in) {
+    std::println(stderr, "Error: Unable to open baseline {}", filename);
+    return -1;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    size_t name = line.find("\"name\":\"");
+    size_t ns = line.find("\"ns_per_op\":");
+    if (name == std::string::npos || ns == std::string::npos) continue;
+    name += 8;
+    std::string key;
+    for (size_t i = name; i < line.size() && line[i] != '"'; i++) {
+      if (line[i] == '\\' && i + 1 < line.size()) i++;
+      key += line[i];
+    }
+    nsPerOp[key] = std::atof(line.c_str() + ns + 12);
+  }
+  return 0;
+}
+
+// Benchmarks slower than the baseline by more than the threshold (returns the number of regressions)
+static int compareResults(const std::vector<BenchResult>& results, const std::unordered_map<std::string, double>& baseline,
+                          double threshold) {
+  int regressions = 0, compared = 0;
+  std::println("\nCompared with the baseline (threshold {:.0f}%):", threshold * 100.0);
+  for (const auto& r : results) {
+    auto it = baseline.find(r.name);
+    if (it == baseline.end() || it->second <= 0.0) continue;
+    compared++;
+    double change = r.nsPerOp / it->second - 1.0;
+    const char* verdict = change > threshold ? "REGRESSION" : change < -threshold ? "faster" : "";
+    if (change > threshold) regressions++;
+    if (*verdict) std::println("{:<44} {:12.1f} -> {:12.1f} ns/op  {:+7.1f}%  {}", r.name, it->second, r.nsPerOp, change * 100.0, verdict);
+  }
+  std::println("{} benchmarks compared, {} regressions", compared, regressions);
+  return regressions;
+}
+
+
+/*
+  Microbenchmark tool
+
+  Usage:
+  ./cbir_bench
+  ./cbir_bench --filter extract/rgbhistogram --json bench/rgb.json
+  ./cbir_bench --data data/olympus --images 32 --min-time 0.5 --repetitions 7
+  ./cbir_bench --compare bench/baseline.json --threshold 0.05 --json bench/current.json
+
+  ns/op is the median of the repetitions. With --compare the run exits
+  with Regression if any benchmark got slower than the threshold allows.
+*/
+int main(int argc, char* argv[]) {
+  BenchOptions options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--filter" && hasValue) options.filter = argv[++i];
+    else if (arg == "--data" && hasValue) options.dataDir = argv[++i];
+    else if (arg == "--images" && hasValue) options.realImages = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--min-time" && hasValue) options.minSeconds = std::atof(argv[++i]);
+    else if (arg == "--repetitions" && hasValue) options.repetitions = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--json" && hasValue) options.jsonFile = argv[++i];
+    else if (arg == "--compare" && hasValue) options.compareFile = argv[++i];
+    else if (arg == "--threshold" && hasValue) options.threshold = std::atof(argv[++i]);
+    else {
+      printUsage(argv[0]);
+      return MissingArg;
+    }
+  }
+
+  std::unordered_map<std::string, double> baseline;
+  if (!options.compareFile.empty() && readJson(options.compareFile, baseline) != 0) return LoadFailed;
+
+  std::vector<BenchResult> results;
+  benchExtractors(options, results);
+  benchDistances(options, results);
+
+  if (!options.jsonFile.empty() && writeJson(options.jsonFile, results) != 0) return LoadFailed;
+  if (!options.compareFile.empty() && compareResults(results, baseline, options.threshold) > 0) return Regression;
+  return Success;
+}
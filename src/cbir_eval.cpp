@@ -0,0 +1,434 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Evaluation tool - measures what the approximate and pruned search modes
+  cost in result quality. The exact top-k of a sample of database images is
+  computed with the exhaustive search, then every alternate mode (index
+  search modes, SimHash candidate counts, int8-quantized features,
+  reduced-resolution decode, pixel-sampled histograms) answers the same
+  queries. Each mode gets
+  recall@k, rank correlation and queries/s, and the table marks the
+  Pareto-optimal operating points.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <print>  // for modern C++ printing (C++23)
+#include <format>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <atomic>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include "feature_index.h"
+#include "index_search.h"
+#include "image_pack.h"
+#include "image_enumerator.h"
+#include "thread_pool.h"
+#include "http_util.h"
+
+enum EvalToolExitCode {
+  Success = 0,
+  MissingArg = 1,
+  LoadFailed = 2
+};
+
+static void printUsage(const char* prog) {
+  std::println("Usage:");
+  std::println("  {} <image_database_directory|pack.cbpk|index.cbix> <feature_type> [options]", prog);
+  std::println("  options: --queries N (default 100), --k N (default 10), --seed N, --csv FILE (embeddings),");
+  std::println("           --modes LIST (comma separated name prefixes, e.g. simhash,decode,sample), --threads N,");
+  std::println("           --json FILE, --flat, --enum-threads N, --manifest FILE, --no-manifest");
+  std::println("  feature_type: baseline, rghistogram, rgbhistogram, multihistogram, textureandcolor,");
+  std::println("                dnnembedding, custom, gradient");
+}
+
+struct EvalOptions {
+  int queries = 100;    // database images used as queries
+  int k = 10;
+  unsigned seed = 5330; // picks the query sample
+  std::string csvPath = "data/ResNet18_olym.csv";
+  std::string modes;    // empty = every mode
+  int threads = 0;      // extraction threads for the re-extracted indexes (0 = hardware threads)
+  std::string jsonFile;
+  EnumerateOptions enumerate;
+};
+
+// One way of answering a query: how the query image is decoded and extracted and which index is searched how
+struct EvalMode {
+  std::string name;
+  std::shared_ptr<const FeatureIndex> index;
+  SearchOptions search;
+  int decodeFlags = cv::IMREAD_COLOR;
+  PixelSampling sampling;  // pixels counted by the histogram types
+  bool quantize = false;   // query features are quantized like the index rows
+};
+
+struct ModeResult {
+  std::string name;
+  double recall = 0.0;           // mean recall@k against the exact top k
+  double rankCorrelation = 0.0;  // mean Spearman correlation of the returned order with the exact order
+  double msPerQuery = 0.0;       // decode + extraction + search
+  double qps = 0.0;
+  int failed = 0;                // queries whose image could not be read or extracted
+  bool pareto = false;
+};
+
+// Exact answer for one query
+struct GroundTruth {
+  int row;                       // the query image
+  std::vector<float> features;   // its full-resolution features (the index row)
+  float kthDistance;             // distance of the k-th exact match
+};
+
+static bool modeSelected(const std::string& name, const std::string& modes) {
+  if (modes.empty()) return true;
+  size_t start = 0;
+  while (start <= modes.size()) {
+    size_t comma = modes.find(',', start);
+    std::string prefix = modes.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+    if (!prefix.empty() && name.starts_with(prefix)) return true;
+    if (comma == std::string::npos) break;
+    start = comma + 1;
+  }
+  return false;
+}
+
+// Symmetric int8 quantization with one scale per row (values are replaced by what int8 storage would give back)
+static void quantizeRow(std::vector<float>& row) {
+  float maxAbs = 0.0f;
+  for (float v : row) maxAbs = std::max(maxAbs, std::abs(v));
+  if (maxAbs == 0.0f) return;
+  float scale = maxAbs / 127.0f;
+  for (float& v : row) v = std::round(v / scale) * scale;
+}
+
+static std::shared_ptr<const FeatureIndex> quantizedIndex(const FeatureIndex& exact) {
+  auto index = std::make_shared<FeatureIndex>();
+  index->type = exact.type;
+  index->dim = exact.dim;
+  index->paths = exact.paths;
+  index->features = exact.features;
+  for (auto& row : index->features) quantizeRow(row);
+  return index;
+}
+
+/*
+  Features of every database image decoded at reduced resolution and/or
+  extracted from a sample of its pixels
+
+  Rows stay in the order of the exact index (an image that fails to decode
+  keeps its full-resolution row, so the row numbers still line up).
+  DNN/custom embeddings come from the exact rows.
+*/
+static std::shared_ptr<const FeatureIndex> reducedIndex(const FeatureIndex& exact, int decodeFlags,
+                                                        const PixelSampling& sampling, int threads) {
+  auto index = std::make_shared<FeatureIndex>();
+  index->type = exact.type;
+  index->dim = exact.dim;
+  index->paths = exact.paths;
+  index->features.resize(exact.size());
+  std::atomic<int> next{0};
+  std::atomic<int> failed{0};
+  {
+    ThreadPool pool(threads);
+    for (int t = 0; t < pool.size(); t++) {
+      pool.submit([&]() {
+        std::vector<float> embedding;
+        for (int row = next++; row < exact.size(); row = next++) {
+          const std::vector<float>& exactRow = exact.features[row];
+          embedding.assign(exactRow.begin(), exactRow.begin() + std::min<size_t>(exactRow.size(), 512));
+          cv::Mat image = readImage(exact.paths[row], decodeFlags);
+          std::vector<float>& features = index->features[row];
+          if (image.empty() || extractFeatures(exact.type, image, embedding, features, sampling) != 0 ||
+              static_cast<int>(features.size()) != exact.dim) {
+            features = exactRow;
+            failed++;
+          }
+        }
+      });
+    }
+  }
+  if (failed > 0) std::println("  {} images kept their full-resolution features", failed.load());
+  return index;
+}
+
+// Spearman rank correlation of the returned order with the order of the exact distances of the same items
+static double rankCorrelation(const std::vector<float>& exactDistances) {
+  int n = static_cast<int>(exactDistances.size());
+  if (n < 2) return 1.0;
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return exactDistances[a] < exactDistances[b]; });
+  double sumSquares = 0.0;
+  for (int exactRank = 0; exactRank < n; exactRank++) {
+    double d = order[exactRank] - exactRank;  // returned position minus exact position
+    sumSquares += d * d;
+  }
+  return 1.0 - 6.0 * sumSquares / (static_cast<double>(n) * (static_cast<double>(n) * n - 1.0));
+}
+
+/*
+  Answer every ground-truth query with one mode
+
+  A query is decoded and extracted from its image file the way the mode
+  decodes it, then searched for k + 1 results so the query image itself can
+  be dropped. A returned image counts for recall if its exact distance is
+  within the k-th exact distance (images tied with the k-th match are as good).
+
+  Output:
+    ModeResult - quality and speed of the mode
+*/
+static ModeResult evaluateMode(const EvalMode& mode, const FeatureIndex& exact, const std::vector<GroundTruth>& truth,
+                               int k) {
+  ModeResult result;
+  result.name = mode.name;
+  double totalMs = 0.0;
+  int answered = 0;
+  std::vector<float> embedding, features;
+  std::vector<IndexMatch> matches;
+  for (const auto& query : truth) {
+    auto start = std::chrono::steady_clock::now();
+    embedding.assign(query.features.begin(), query.features.begin() + std::min<size_t>(query.features.size(), 512));
+    cv::Mat image;
+    if (exact.type != DNNEmbedding) image = readImage(exact.paths[query.row], mode.decodeFlags);
+    if ((exact.type != DNNEmbedding && image.empty()) || extractFeatures(exact.type, image, embedding, features, mode.sampling) != 0) {
+      result.failed++;
+      continue;
+    }
+    if (mode.quantize) quantizeRow(features);
+    if (searchIndex(*mode.index, features, k + 1, mode.search, matches) != 0) {
+      result.failed++;
+      continue;
+    }
+    totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    answered++;
+
+    // quality is judged with the exact (full-resolution, float) distances
+    std::vector<float> exactDistances;
+    int hits = 0;
+    for (const auto& match : matches) {
+      if (match.row == query.row || static_cast<int>(exactDistances.size()) == k) continue;
+      float distance = computeDistance(exact.type, query.features, exact.features[match.row]);
+      exactDistances.push_back(distance);
+      if (distance <= query.kthDistance) hits++;
+    }
+    result.recall += static_cast<double>(hits) / k;
+    result.rankCorrelation += rankCorrelation(exactDistances);
+  }
+  if (answered > 0) {
+    result.recall /= answered;
+    result.rankCorrelation /= answered;
+    result.msPerQuery = totalMs / answered;
+    result.qps = totalMs > 0.0 ? answered * 1000.0 / totalMs : 0.0;
+  }
+  return result;
+}
+
+// A mode is Pareto-optimal if no other mode is at least as fast and as accurate and better in one of them
+static void markPareto(std::vector<ModeResult>& results) {
+  for (auto& a : results) {
+    a.pareto = true;
+    for (const auto& b : results) {
+      bool noWorse = b.recall >= a.recall && b.qps >= a.qps;
+      bool better = b.recall > a.recall || b.qps > a.qps;
+      if (&a != &b && noWorse && better) {
+        a.pareto = false;
+        break;
+      }
+    }
+  }
+}
+
+static int writeJson(const std::string& filename, const std::string& collection, const FeatureIndex& exact,
+                     int k, int queries, const std::vector<ModeResult>& results) {
+  std::ofstream out(filename, std::ios::trunc);
+  if (!out) {
+    std::println(stderr, "Error: Unable to open {} for writing", filename);
+    return -1;
+  }
+  out << std::format("{{\"collection\":\"{}\",\"type\":\"{}\",\"images\":{},\"k\":{},\"queries\":{},\"modes\":[\n",
+                     jsonEscape(collection), featureTypeName(exact.type), exact.size(), k, queries);
+  for (size_t i = 0; i < results.size(); i++) {
+    const ModeResult& r = results[i];
+    out << std::format("{{\"mode\":\"{}\",\"recall\":{:.5f},\"rank_correlation\":{:.5f},\"ms_per_query\":{:.4f},"
+                       "\"qps\":{:.3f},\"failed\":{},\"pareto\":{}}}{}\n",
+                       jsonEscape(r.name), r.recall, r.rankCorrelation, r.msPerQuery, r.qps, r.failed,
+                       r.pareto ? "true" : "false", i + 1 < results.size() ? "," : "");
+  }
+  out << "]}\n";
+  return out ? 0 : -1;
+}
+
+
+/*
+  Recall-vs-speed evaluation
+
+  Usage:
+  ./cbir_eval <image_database_directory|pack.cbpk|index.cbix> <feature_type> [options]
+  ./cbir_eval data/olympus rgbhistogram --queries 200 --k 10 --json eval/olympus_rgb.json
+  ./cbir_eval features/olympus_dnn.cbix dnnembedding --modes simhash,int8
+  ./cbir_eval data/olympus.cbpk textureandcolor --modes exhaustive,decode
+  ./cbir_eval data/photos rgbhistogram --modes exhaustive,sample
+
+  An index file supplies the exact features; its image paths must still be
+  readable because every mode decodes the query images (and the decode
+  modes the whole collection). Modes:
+    exhaustive     - the exact reference
+    auto           - the exact pruned search (pyramid / VP-tree / cascade), if the type has one
+    simhash-N      - SimHash prefilter with N exact candidates
+    int8           - features quantized to int8 with a per-row scale
+    decode/2,4,8   - images decoded at 1/2, 1/4, 1/8 resolution (IMREAD_REDUCED_COLOR_*)
+    sample/stride/2,4,8          - histograms from every 2nd, 4th, 8th pixel of every 2nd, 4th, 8th row
+    sample/stratified/65536,...  - histograms from about 65536, 16384, 4096 stratified random pixels
+*/
+int main(int argc, char* argv[]) {
+  EvalOptions options;
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (parseEnumerateOption(argc, argv, i, options.enumerate)) continue;
+    if (arg == "--queries" && hasValue) options.queries = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--k" && hasValue) options.k = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--seed" && hasValue) options.seed = static_cast<unsigned>(std::atoll(argv[++i]));
+    else if (arg == "--csv" && hasValue) options.csvPath = argv[++i];
+    else if (arg == "--modes" && hasValue) options.modes = argv[++i];
+    else if (arg == "--threads" && hasValue) options.threads = std::atoi(argv[++i]);
+    else if (arg == "--json" && hasValue) options.jsonFile = argv[++i];
+    else if (arg.starts_with("--")) {
+      printUsage(argv[0]);
+      return MissingArg;
+    }
+    else positional.push_back(arg);
+  }
+  if (positional.size() < 2) {
+    printUsage(argv[0]);
+    return MissingArg;
+  }
+  FeatureType type;
+  if (!parseFeatureType(positional[1], type)) {
+    std::println(stderr, "Error: Unknown feature type {}", positional[1]);
+    return MissingArg;
+  }
+
+  // 1. exact features of the whole collection
+  auto exact = std::make_shared<FeatureIndex>();
+  const std::string& collection = positional[0];
+  if (isFeatureIndexFile(collection)) {
+    if (loadFeatureIndex(collection, *exact) != 0) return LoadFailed;
+    if (exact->type != type) {
+      std::println(stderr, "Error: {} holds {} features, not {}", collection, featureTypeName(exact->type),
+                   featureTypeName(type));
+      return LoadFailed;
+    }
+  } else {
+    IndexBuildOptions buildOptions;
+    buildOptions.enumerate = options.enumerate;
+    if (buildFeatureIndex(collection, type, options.csvPath, *exact, buildOptions) != 0) return LoadFailed;
+  }
+  if (exact->size() <= options.k) {
+    std::println(stderr, "Error: {} has {} images, need more than k = {}", collection, exact->size(), options.k);
+    return LoadFailed;
+  }
+
+  // 2. ground truth for a random sample of database images
+  std::vector<int> rows(exact->size());
+  std::iota(rows.begin(), rows.end(), 0);
+  std::shuffle(rows.begin(), rows.end(), std::mt19937(options.seed));
+  rows.resize(std::min(options.queries, exact->size()));
+  std::vector<GroundTruth> truth;
+  std::vector<IndexMatch> matches;
+  for (int row : rows) {
+    searchExhaustive(*exact, exact->features[row], options.k + 1, matches);
+    std::erase_if(matches, [row](const IndexMatch& match) { return match.row == row; });
+    truth.push_back({row, exact->features[row], matches[std::min<size_t>(options.k, matches.size()) - 1].distance});
+  }
+  std::println("{}: {} images, {} ({} features), k = {}, {} queries", collection, exact->size(),
+               featureTypeName(type), exact->dim, options.k, truth.size());
+
+  // 3. every alternate mode against the same queries
+  std::vector<EvalMode> modes;
+  EvalMode reference{"exhaustive", exact};
+  reference.search.mode = SearchExhaustive;
+  modes.push_back(reference);
+  if (resolveSearchMode(*exact, SearchAuto) != SearchExhaustive) {
+    modes.push_back({"auto", exact});
+  }
+  if (!exact->simhash.empty()) {
+    for (int candidates : {100, 250, 500, 1000, 2000, 5000}) {
+      if (candidates >= exact->size()) break;
+      EvalMode mode{std::format("simhash-{}", candidates), exact};
+      mode.search.mode = SearchSimHash;
+      mode.search.simhashCandidates = candidates;
+      modes.push_back(mode);
+    }
+  }
+  if (modeSelected("int8", options.modes)) {
+    EvalMode mode{"int8", quantizedIndex(*exact)};
+    mode.search.mode = SearchExhaustive;
+    mode.quantize = true;
+    modes.push_back(mode);
+  }
+  if (type != DNNEmbedding) {
+    const std::pair<int, int> reductions[] = {
+      {2, cv::IMREAD_REDUCED_COLOR_2}, {4, cv::IMREAD_REDUCED_COLOR_4}, {8, cv::IMREAD_REDUCED_COLOR_8}
+    };
+    for (const auto& [factor, flags] : reductions) {
+      std::string name = std::format("decode/{}", factor);
+      if (!modeSelected(name, options.modes)) continue;
+      std::println("Extracting the collection at 1/{} resolution...", factor);
+      EvalMode mode{name, reducedIndex(*exact, flags, PixelSampling(), options.threads)};
+      mode.search.mode = SearchExhaustive;
+      mode.decodeFlags = flags;
+      modes.push_back(mode);
+    }
+  }
+  if (featureTypeSupportsSampling(type)) {
+    std::vector<PixelSampling> samplings;
+    for (int stride : {2, 4, 8}) samplings.push_back({SampleStride, stride, 0});
+    for (int count : {65536, 16384, 4096}) samplings.push_back({SampleStratified, 1, count});
+    for (const auto& sampling : samplings) {
+      std::string name = "sample/" + pixelSamplingName(sampling);
+      if (!modeSelected(name, options.modes)) continue;
+      std::println("Extracting the collection from {} pixels...", pixelSamplingName(sampling));
+      EvalMode mode{name, reducedIndex(*exact, cv::IMREAD_COLOR, sampling, options.threads)};
+      mode.search.mode = SearchExhaustive;
+      mode.sampling = sampling;
+      modes.push_back(mode);
+    }
+  }
+
+  std::vector<ModeResult> results;
+  for (const auto& mode : modes) {
+    if (!modeSelected(mode.name, options.modes)) continue;
+    results.push_back(evaluateMode(mode, *exact, truth, options.k));
+  }
+  markPareto(results);
+
+  // 4. fastest first, * marks the operating points worth choosing between
+  std::sort(results.begin(), results.end(), [](const ModeResult& a, const ModeResult& b) { return a.qps > b.qps; });
+  double referenceMs = 0.0;
+  for (const auto& r : results) {
+    if (r.name == "exhaustive") referenceMs = r.msPerQuery;
+  }
+  std::println("\n{:<24} {:>9} {:>10} {:>10} {:>10} {:>8}  {}", "mode", std::format("recall@{}", options.k),
+               "rank corr", "ms/query", "queries/s", "speedup", "pareto");
+  for (const auto& r : results) {
+    std::println("{:<24} {:9.4f} {:10.4f} {:10.3f} {:10.1f} {:>8}  {}{}", r.name, r.recall, r.rankCorrelation,
+                 r.msPerQuery, r.qps, referenceMs > 0.0 && r.msPerQuery > 0.0 ? std::format("{:.2f}x", referenceMs / r.msPerQuery) : "-",
+                 r.pareto ? "*" : "", r.failed ? std::format(" ({} failed)", r.failed) : "");
+  }
+
+  if (!options.jsonFile.empty() &&
+      writeJson(options.jsonFile, collection, *exact, options.k, static_cast<int>(truth.size()), results) != 0) {
+    return LoadFailed;
+  }
+  return Success;
+}
@@ -0,0 +1,374 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Feature index tool - builds the precomputed feature index for an image
+  directory, benchmarks the index search modes against each other and
+  finds duplicate images.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <print>  // for modern C++ printing (C++23)
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include "feature_index.h"
+#include "index_search.h"
+#include "index_shard.h"
+
+// this tool counts its heap allocations for build --alloc-check
+#define CBIR_COUNT_ALLOCATIONS
+#include "alloc_counter.h"
+
+enum IndexToolExitCode {
+  Success = 0,
+  MissingArg = 1,
+  BuildFailed = 2,
+  LoadFailed = 3,
+  BenchMismatch = 4,
+  AllocCheckFailed = 5
+};
+
+static void printUsage(const char* prog) {
+  std::println("Usage:");
+  std::println("  {} build <image_database_directory> <feature_type> <index_file.cbix> [csv_file] [--simhash-bits N]", prog);
+  std::println("        [--io-depth N] [--io-buffers N] [--io-pread]");
+  std::println("        [--flat] [--enum-threads N] [--manifest FILE] [--no-manifest] [--alloc-check]");
+  std::println("        [--sample-stride N | --sample-count N]");
+  std::println("  {} export <image_database_directory> <feature_type> <features.csv|features.cbft> [csv_file] [--threads N]", prog);
+  std::println("        [--sample-stride N | --sample-count N]");
+  std::println("  {} bench <index_file.cbix> [k] [num_queries] [simhash_candidates]", prog);
+  std::println("  {} duplicates <index_file.cbix> [max_distance]", prog);
+  std::println("  {} shard <index_file.cbix> <num_shards> <output_prefix>", prog);
+  std::println("  feature_type: baseline, rghistogram, rgbhistogram, multihistogram, textureandcolor,");
+  std::println("                dnnembedding, custom, gradient");
+}
+
+// Build an index and save it
+static int runBuild(int argc, char* argv[]) {
+  if (argc < 5) {
+    printUsage(argv[0]);
+    return MissingArg;
+  }
+
+  FeatureType type;
+  if (!parseFeatureType(argv[3], type)) {
+    std::println(stderr, "Error: Unknown feature type {}", argv[3]);
+    return MissingArg;
+  }
+  std::string csvPath = "data/ResNet18_olym.csv";
+  IndexBuildOptions options;
+  ScanAllocations allocations;
+  for (int i = 5; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--simhash-bits" && i + 1 < argc) {
+      options.simhashBits = std::atoi(argv[++i]);
+    } else if (arg == "--alloc-check") {
+      options.allocations = &allocations;
+    } else if (parseImageReaderOption(argc, argv, i, options.io) || parseEnumerateOption(argc, argv, i, options.enumerate) ||
+               parsePixelSamplingOption(argc, argv, i, options.sampling)) {
+      continue;
+    } else {
+      csvPath = arg;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  FeatureIndex index;
+  if (buildFeatureIndex(argv[2], type, csvPath, index, options) != 0) return BuildFailed;
+  if (saveFeatureIndex(argv[4], index) != 0) return BuildFailed;
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::println("Indexed {} images ({} features each) in {:.2f}s -> {}", index.size(), index.dim, seconds, argv[4]);
+  if (options.sampling.mode != SampleAll && featureTypeSupportsSampling(type)) {
+    std::println("Histograms counted from a pixel sample ({})", pixelSamplingName(options.sampling));
+  }
+
+  // steady state: after the warm-up the loop must not allocate, only the decoder's own objects are allowed
+  if (options.allocations && reportScanAllocations(allocations) != 0) {
+    return AllocCheckFailed;
+  }
+  return Success;
+}
+
+// Extract features into a CSV or binary feature file
+static int runExport(int argc, char* argv[]) {
+  if (argc < 5) {
+    printUsage(argv[0]);
+    return MissingArg;
+  }
+
+  FeatureType type;
+  if (!parseFeatureType(argv[3], type)) {
+    std::println(stderr, "Error: Unknown feature type {}", argv[3]);
+    return MissingArg;
+  }
+  std::string csvPath = "data/ResNet18_olym.csv";
+  FeatureExportOptions options;
+  for (int i = 5; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      options.threads = std::atoi(argv[++i]);
+    } else if (parseEnumerateOption(argc, argv, i, options.enumerate) ||
+               parsePixelSamplingOption(argc, argv, i, options.sampling)) {
+      continue;
+    } else {
+      csvPath = arg;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  if (exportFeatures(argv[2], type, csvPath, argv[4], options) != 0) return BuildFailed;
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::println("Exported {} features in {:.2f}s -> {}", featureTypeName(type), seconds, argv[4]);
+  return Success;
+}
+
+// Time one search mode over all sample queries, results are kept for comparison
+static double timeMode(const FeatureIndex& index, const std::vector<int>& queryRows, int k,
+                       const SearchOptions& options, std::vector<std::vector<IndexMatch>>& results,
+                       SearchStats& total) {
+  results.assign(queryRows.size(), {});
+  total = SearchStats();
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t q = 0; q < queryRows.size(); q++) {
+    SearchStats stats;
+    searchIndex(index, index.features[queryRows[q]], k, options, results[q], &stats);
+    total.candidates += stats.candidates;
+    total.fullyScored += stats.fullyScored;
+    total.pruned += stats.pruned;
+    total.binsTouched += stats.binsTouched;
+    total.nodesVisited += stats.nodesVisited;
+    total.nodesSkipped += stats.nodesSkipped;
+  }
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void printModeStats(const char* name, double ms, const SearchStats& total, int queries) {
+  std::println("{:<12} {:9.3f} ms/query  scored {:8.1f}  pruned {:8.1f}  bins {:12.0f}",
+    name, ms / queries, (double)total.fullyScored / queries, (double)total.pruned / queries,
+    (double)total.binsTouched / queries);
+}
+
+// Fraction of the exact top-k rows that an approximate search also returned
+static double recallAtK(const std::vector<std::vector<IndexMatch>>& exact,
+                        const std::vector<std::vector<IndexMatch>>& approx) {
+  double found = 0.0, total = 0.0;
+  for (size_t q = 0; q < exact.size(); q++) {
+    for (const auto& match : exact[q]) {
+      for (const auto& candidate : approx[q]) {
+        if (candidate.row == match.row) {
+          found += 1.0;
+          break;
+        }
+      }
+      total += 1.0;
+    }
+  }
+  return total > 0.0 ? found / total : 1.0;
+}
+
+// True if an exact mode returned exactly the exhaustive results, reports the first mismatch
+static bool sameResults(const char* name, const FeatureIndex& index, const std::vector<int>& queryRows,
+                        const std::vector<std::vector<IndexMatch>>& exact,
+                        const std::vector<std::vector<IndexMatch>>& results) {
+  for (size_t q = 0; q < queryRows.size(); q++) {
+    bool same = results[q].size() == exact[q].size();
+    for (size_t i = 0; same && i < exact[q].size(); i++) {
+      same = results[q][i].row == exact[q][i].row && results[q][i].distance == exact[q][i].distance;
+    }
+    if (!same) {
+      std::println(stderr, "Error: {} results differ from exhaustive for query {}", name, index.paths[queryRows[q]]);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Compare the accelerated modes against the exhaustive scan
+static int runBench(int argc, char* argv[]) {
+  if (argc < 3) {
+    printUsage(argv[0]);
+    return MissingArg;
+  }
+  int k = argc >= 4 ? std::atoi(argv[3]) : 10;
+  int numQueries = argc >= 5 ? std::atoi(argv[4]) : 100;
+  int simhashCandidates = argc >= 6 ? std::atoi(argv[5]) : SearchOptions().simhashCandidates;
+
+  FeatureIndex index;
+  if (loadFeatureIndex(argv[2], index) != 0) return LoadFailed;
+  if (index.size() == 0 || k <= 0 || numQueries <= 0) {
+    std::println(stderr, "Error: Nothing to benchmark");
+    return LoadFailed;
+  }
+
+  // evenly spaced rows of the index are used as queries
+  std::vector<int> queryRows;
+  for (int q = 0; q < numQueries && q < index.size(); q++) {
+    queryRows.push_back(static_cast<int>(static_cast<long long>(q) * index.size() / std::min(numQueries, index.size())));
+  }
+  int queries = static_cast<int>(queryRows.size());
+
+  std::println("Index: {} images, {} ({} features), k = {}, {} queries",
+    index.size(), featureTypeName(index.type), index.dim, k, queries);
+
+  std::vector<std::vector<IndexMatch>> exact, results;
+  SearchStats total;
+  SearchOptions options;
+  options.mode = SearchExhaustive;
+  double ms = timeMode(index, queryRows, k, options, exact, total);
+  printModeStats("exhaustive", ms, total, queries);
+
+  int status = Success;
+  if (!index.pyramid.empty()) {
+    options.mode = SearchPyramid;
+    ms = timeMode(index, queryRows, k, options, results, total);
+    printModeStats("pyramid", ms, total, queries);
+    if (!sameResults("pyramid", index, queryRows, exact, results)) status = BenchMismatch;
+  }
+
+  if (!index.vptree.empty()) {
+    options.mode = SearchVPTree;
+    ms = timeMode(index, queryRows, k, options, results, total);
+    printModeStats("vptree", ms, total, queries);
+    std::println("{:<12} nodes visited {:.1f}, skipped {:.1f} per query", "",
+      (double)total.nodesVisited / queries, (double)total.nodesSkipped / queries);
+    if (!sameResults("vptree", index, queryRows, exact, results)) status = BenchMismatch;
+  }
+
+  if (index.type == CustomDesign) {
+    options.mode = SearchCascade;
+    ms = timeMode(index, queryRows, k, options, results, total);
+    printModeStats("cascade", ms, total, queries);
+    if (!sameResults("cascade", index, queryRows, exact, results)) status = BenchMismatch;
+  }
+
+  // approximate: report recall@k against the exhaustive results
+  if (!index.simhash.empty()) {
+    options.mode = SearchSimHash;
+    options.simhashCandidates = simhashCandidates;
+    ms = timeMode(index, queryRows, k, options, results, total);
+    printModeStats("simhash", ms, total, queries);
+    std::println("{:<12} {} bits, {} candidates, recall@{} = {:.4f}",
+      "", index.simhash.bits, simhashCandidates, k, recallAtK(exact, results));
+  }
+
+  return status;
+}
+
+
+/*
+  Find groups of near-identical images with one range query per image
+
+  maxDistance is in the units of the index distance (SSD for baseline,
+  0 = exact duplicates). Baseline indexes answer the queries with the
+  VP-tree instead of a linear scan.
+*/
+static int runDuplicates(int argc, char* argv[]) {
+  if (argc < 3) {
+    printUsage(argv[0]);
+    return MissingArg;
+  }
+  float maxDistance = argc >= 4 ? static_cast<float>(std::atof(argv[3])) : 0.0f;
+
+  FeatureIndex index;
+  if (loadFeatureIndex(argv[2], index) != 0) return LoadFailed;
+
+  auto start = std::chrono::steady_clock::now();
+  SearchStats total;
+  int groups = 0;
+  std::vector<bool> reported(index.size(), false);
+  for (int row = 0; row < index.size(); row++) {
+    if (reported[row]) continue;
+
+    std::vector<IndexMatch> matches;
+    SearchStats stats;
+    searchIndexRange(index, index.features[row], maxDistance, matches, &stats);
+    total.fullyScored += stats.fullyScored;
+    total.nodesSkipped += stats.nodesSkipped;
+
+    if (matches.size() < 2) continue;
+    groups++;
+    std::println("Group {}:", groups);
+    for (const auto& match : matches) {
+      reported[match.row] = true;
+      std::println("  {} (distance: {:.6f})", index.paths[match.row], match.distance);
+    }
+  }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  std::println("{} duplicate groups in {} images, {:.1f} distance evaluations per query, {:.1f} ms total",
+    groups, index.size(), index.size() > 0 ? (double)total.fullyScored / index.size() : 0.0, ms);
+  return Success;
+}
+
+
+/*
+  Split an index into shards by image ID hash
+
+  Writes <prefix>.shard<i>of<n>.cbix for every shard, each server process
+  then loads only the shard files it owns.
+*/
+static int runShard(int argc, char* argv[]) {
+  if (argc < 5) {
+    printUsage(argv[0]);
+    return MissingArg;
+  }
+  int shardCount = std::atoi(argv[3]);
+  if (shardCount <= 0) {
+    std::println(stderr, "Error: Number of shards must be positive");
+    return MissingArg;
+  }
+
+  FeatureIndex index;
+  if (loadFeatureIndex(argv[2], index) != 0) return LoadFailed;
+
+  std::vector<FeatureIndex> shards;
+  if (splitFeatureIndex(index, shardCount, shards) != 0) return BuildFailed;
+  for (int id = 0; id < shardCount; id++) {
+    std::string filename = shardIndexFilename(argv[4], id, shardCount);
+    if (saveFeatureIndex(filename, shards[id]) != 0) return BuildFailed;
+    std::println("Shard {}: {} images -> {}", id, shards[id].size(), filename);
+  }
+  return Success;
+}
+
+
+/*
+  Feature index tool
+
+  Usage:
+  ./cbir_index build data/olympus rgbhistogram features/olympus_rgb.cbix
+  ./cbir_index build data/olympus dnnembedding features/olympus_dnn.cbix data/ResNet18_olym.csv
+  ./cbir_index build data/olympus multihistogram features/olympus_multi.cbix --simhash-bits 128
+  ./cbir_index build data/olympus rgbhistogram features/olympus_rgb.cbix --alloc-check
+  ./cbir_index build data/photos rgbhistogram features/photos_rgb.cbix --sample-count 65536
+  ./cbir_index export data/olympus rgbhistogram features/olympus_rgb.csv
+  ./cbir_index export data/olympus multihistogram features/olympus_multi.cbft --threads 8
+  ./cbir_index bench features/olympus_rgb.cbix 10 100
+  ./cbir_index bench features/olympus_dnn.cbix 10 100 200
+  ./cbir_index duplicates features/olympus_baseline.cbix 0
+  ./cbir_index shard features/olympus_dnn.cbix 4 features/olympus_dnn
+*/
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printUsage(argv[0]);
+    exit(MissingArg);
+  }
+
+  std::string command = argv[1];
+  if (command == "build") return runBuild(argc, argv);
+  if (command == "export") return runExport(argc, argv);
+  if (command == "bench") return runBench(argc, argv);
+  if (command == "duplicates") return runDuplicates(argc, argv);
+  if (command == "shard") return runShard(argc, argv);
+
+  printUsage(argv[0]);
+  return MissingArg;
+}
@@ -0,0 +1,588 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Load test tool - replays a list of query images against one or more
+  collections (an image directory or pack scanned per query like cbir does,
+  or a precomputed .cbix index) from several threads at once, and reports
+  queries/s, latency percentiles, where each query's time went and the peak
+  resident memory of the process.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <print>  // for modern C++ printing (C++23)
+#include <format>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include "feature_index.h"
+#include "feature_writer.h"
+#include "features.h"
+#include "index_search.h"
+#include "query_service.h"
+#include "http_util.h"
+#include "image_reader.h"
+#include "image_pack.h"
+#include "image_enumerator.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+enum LoadTestExitCode {
+  Success = 0,
+  MissingArg = 1,
+  LoadFailed = 2,
+  QueriesFailed = 3
+};
+
+// Where a query's time goes, in the order a scan query runs through them
+enum QueryStage {
+  StageEnumerate,    // listing the collection (directory walk or manifest, pack table)
+  StageRead,         // reading files, for the scan only the time spent waiting for the read-ahead
+  StageDecode,       // imdecode
+  StageExtract,      // feature extraction and embedding lookup
+  StageDistance,     // distances (for an index: the whole search, which scores and keeps the top k together)
+  StageTopK,         // sorting the distances (the scan sorts every image, like cbir)
+  StageMaterialize,  // result paths and the JSON response
+  StageCount
+};
+
+static const char* kStageNames[StageCount] = {
+  "enumerate", "read", "decode", "extract", "distance", "topk", "materialize"
+};
+
+static void printUsage(const char* prog) {
+  std::println("Usage:");
+  std::println("  {} <queries.txt|query_image|query_directory> <feature_type> <collection>... [options]", prog);
+  std::println("  collection: image directory, image pack (.cbpk) or feature index (.cbix)");
+  std::println("  options: --concurrency N (default 1), --requests N (default one per query image),");
+  std::println("           --warmup N (default 2), --k N (default 4), --csv FILE (embeddings for the scan),");
+  std::println("           --search auto|exhaustive, --json FILE");
+  std::println("           --io-depth N, --io-buffers N, --io-pread, --flat, --enum-threads N, --manifest FILE, --no-manifest");
+  std::println("  feature_type: baseline, rghistogram, rgbhistogram, multihistogram, textureandcolor,");
+  std::println("                dnnembedding, custom, gradient");
+}
+
+struct LoadOptions {
+  int concurrency = 1;   // queries running at the same time, one thread each
+  int requests = 0;      // queries to replay, the list is repeated as needed (0 = once through the list)
+  int warmup = 2;        // queries run before the clock starts
+  int k = 4;
+  std::string csvPath = "data/ResNet18_olym.csv";
+  std::string jsonFile;
+  SearchOptions search;
+  ImageReaderOptions io;
+  EnumerateOptions enumerate;
+};
+
+// A collection with everything that is loaded once, not per query
+struct LoadTarget {
+  std::string collection;
+  bool isIndex = false;
+  FeatureType type = Baseline;
+  std::shared_ptr<const FeatureIndex> index;            // index path
+  std::unordered_map<std::string, int> embeddingLookup; // scan path, DNN/custom embeddings by filename
+  std::vector<std::vector<float>> embeddings;
+  double setupMs = 0.0;                                 // loading the index or the embeddings
+};
+
+struct QueryTiming {
+  bool ok = false;
+  double totalMs = 0.0;
+  double stageMs[StageCount] = {};
+};
+
+// Adds the time since the previous lap to a stage
+class StageClock {
+public:
+  explicit StageClock(QueryTiming& timing) : timing_(timing), start_(std::chrono::steady_clock::now()), last_(start_) {}
+
+  void lap(QueryStage stage) {
+    auto now = std::chrono::steady_clock::now();
+    timing_.stageMs[stage] += std::chrono::duration<double, std::milli>(now - last_).count();
+    last_ = now;
+  }
+
+  void finish() {
+    timing_.totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+  }
+
+private:
+  QueryTiming& timing_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point last_;
+};
+
+// Buffers one worker thread reuses from query to query
+struct QueryWorker {
+  std::string fileBytes;
+  cv::Mat queryImage;
+  std::vector<float> embedding;
+  std::vector<float> queryFeatures;
+  std::vector<float> features;
+  std::vector<std::string> imageFiles;
+  std::vector<std::pair<float, std::string>> distances;
+  std::vector<IndexMatch> matches;
+  QueryResponse response;
+  std::string json;
+};
+
+// Peak resident set size of this process in bytes (0 if unknown)
+static uint64_t peakRssBytes() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+  return counters.PeakWorkingSetSize;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  return static_cast<uint64_t>(usage.ru_maxrss);         // bytes
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;  // kilobytes
+#endif
+#endif
+}
+
+// Read and decode the query image, an image inside a pack is decoded from the mapping
+static bool readQueryImage(const std::string& path, QueryWorker& worker, StageClock& clock) {
+  ImageFile file;
+  file.path = path;
+  std::shared_ptr<const ImagePack> pack;
+  std::string packFile, name;
+  if (splitPackPath(path, packFile, name)) {
+    pack = openImagePack(packFile);
+    int entry = pack ? pack->find(name) : -1;
+    if (entry < 0) return false;
+    file.data = pack->data(entry);
+    file.size = pack->entry(entry).size;
+  } else {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    worker.fileBytes.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(worker.fileBytes.data(), worker.fileBytes.size())) return false;
+    file.data = reinterpret_cast<const unsigned char*>(worker.fileBytes.data());
+    file.size = worker.fileBytes.size();
+  }
+  clock.lap(StageRead);
+  bool decoded = decodeImageFile(file, worker.queryImage);
+  clock.lap(StageDecode);
+  return decoded;
+}
+
+// Embedding of an image from the scan's embedding file (nullptr if the type needs none or it is missing)
+static const std::vector<float>* findEmbedding(const LoadTarget& target, const std::string& path) {
+  if (!featureTypeNeedsEmbedding(target.type)) return nullptr;
+  auto it = target.embeddingLookup.find(std::filesystem::path(path).filename().string());
+  return it == target.embeddingLookup.end() ? nullptr : &target.embeddings[it->second];
+}
+
+static void buildResponse(const LoadTarget& target, QueryWorker& worker) {
+  worker.response.status = QueryOk;
+  worker.response.type = target.type;
+  worker.json = queryResponseToJson(worker.response);
+}
+
+/*
+  One query against an image directory or pack, the same work as cbir:
+  extract the query, list the collection, read/decode/extract every image,
+  compute every distance and sort them
+
+  Output:
+    bool - false if the query image could not be read or its features failed
+*/
+static bool runScanQuery(const LoadTarget& target, const std::string& queryPath, const LoadOptions& options,
+                         QueryWorker& worker, QueryTiming& timing) {
+  static const std::vector<float> kNoEmbedding;
+  StageClock clock(timing);
+  if (!readQueryImage(queryPath, worker, clock)) return false;
+  const std::vector<float>* queryEmbedding = findEmbedding(target, queryPath);
+  if (featureTypeNeedsEmbedding(target.type) && !queryEmbedding) return false;
+  if (extractFeatures(target.type, worker.queryImage, queryEmbedding ? *queryEmbedding : kNoEmbedding,
+                      worker.queryFeatures) != 0) {
+    return false;
+  }
+  clock.lap(StageExtract);
+
+  worker.imageFiles.clear();
+  std::shared_ptr<const ImagePack> pack;
+  if (isImagePackFile(target.collection)) {
+    pack = openImagePack(target.collection);
+    if (!pack) return false;
+    for (int i = 0; i < pack->size(); i++) worker.imageFiles.push_back(pack->path(i));
+  } else if (enumerateImages(target.collection, worker.imageFiles, options.enumerate) != 0) {
+    return false;
+  }
+  clock.lap(StageEnumerate);
+
+  std::unique_ptr<ImageReader> reader = pack ? std::make_unique<ImageReader>(pack, options.io)
+                                             : std::make_unique<ImageReader>(worker.imageFiles, options.io);
+  cv::Mat& image = threadFeatureScratch().decoded;
+  worker.distances.clear();
+  ImageFile file;
+  clock.lap(StageRead);
+  while (reader->next(file)) {
+    clock.lap(StageRead);
+    bool decoded = decodeImageFile(file, image);
+    clock.lap(StageDecode);
+    if (!decoded) continue;
+    const std::vector<float>* embedding = findEmbedding(target, file.path);
+    int status = featureTypeNeedsEmbedding(target.type) && !embedding
+                   ? -1 : extractFeatures(target.type, image, embedding ? *embedding : kNoEmbedding, worker.features);
+    clock.lap(StageExtract);
+    if (status != 0) continue;
+    worker.distances.emplace_back(computeDistance(target.type, worker.queryFeatures, worker.features), file.path);
+    clock.lap(StageDistance);
+  }
+  reader.reset();
+  clock.lap(StageRead);
+
+  std::sort(worker.distances.begin(), worker.distances.end());
+  clock.lap(StageTopK);
+
+  worker.response.hits.clear();
+  worker.response.stats = SearchStats();
+  worker.response.stats.candidates = static_cast<int>(worker.imageFiles.size());
+  worker.response.stats.fullyScored = static_cast<int>(worker.distances.size());
+  for (int i = 0; i < options.k && i < (int)worker.distances.size(); i++) {
+    worker.response.hits.push_back({worker.distances[i].second, worker.distances[i].first});
+  }
+  buildResponse(target, worker);
+  clock.lap(StageMaterialize);
+  clock.finish();
+  return true;
+}
+
+/*
+  One query against a loaded index: extract the query (DNN/custom take the
+  embedding from the index row of the query image), search, build the result
+
+  Output:
+    bool - false if the query image could not be read or its features failed
+*/
+static bool runIndexQuery(const LoadTarget& target, const std::string& queryPath, const LoadOptions& options,
+                          QueryWorker& worker, QueryTiming& timing) {
+  StageClock clock(timing);
+  if (!readQueryImage(queryPath, worker, clock)) return false;
+  // DNN and custom features take the query embedding from the index row of the query image
+  worker.embedding.clear();
+  if (featureTypeNeedsEmbedding(target.type)) {
+    int row = findIndexRow(*target.index, std::filesystem::path(queryPath).filename().string());
+    if (row < 0) return false;
+    const std::vector<float>& rowFeatures = target.index->features[row];
+    worker.embedding.assign(rowFeatures.begin(), rowFeatures.begin() + std::min<size_t>(rowFeatures.size(), 512));
+  }
+  if (extractFeatures(target.type, worker.queryImage, worker.embedding, worker.queryFeatures) != 0) return false;
+  clock.lap(StageExtract);
+
+  worker.response.stats = SearchStats();
+  if (searchIndex(*target.index, worker.queryFeatures, options.k, options.search, worker.matches,
+                  &worker.response.stats) != 0) {
+    return false;
+  }
+  clock.lap(StageDistance);
+
+  worker.response.hits.clear();
+  for (const auto& match : worker.matches) {
+    worker.response.hits.push_back({target.index->paths[match.row], match.distance});
+  }
+  buildResponse(target, worker);
+  clock.lap(StageMaterialize);
+  clock.finish();
+  return true;
+}
+
+// Load the index, or the embeddings a scan needs, before any query is timed
+static int loadTarget(const std::string& collection, FeatureType type, const LoadOptions& options, LoadTarget& target) {
+  auto start = std::chrono::steady_clock::now();
+  target.collection = collection;
+  target.type = type;
+  target.isIndex = isFeatureIndexFile(collection);
+  if (target.isIndex) {
+    auto index = std::make_shared<FeatureIndex>();
+    if (loadFeatureIndex(collection, *index) != 0) return -1;
+    if (index->type != type) {
+      std::println(stderr, "Error: {} holds {} features, not {}", collection, featureTypeName(index->type),
+                   featureTypeName(type));
+      return -1;
+    }
+    target.index = std::move(index);
+  } else if (featureTypeNeedsEmbedding(type)) {
+    std::vector<std::string> names;
+    if (readFeatureFile(options.csvPath, names, target.embeddings) != 0) return -1;
+    for (int i = 0; i < (int)names.size(); i++) target.embeddingLookup[names[i]] = i;
+  } else if (!isImagePackFile(collection) && !std::filesystem::is_directory(collection)) {
+    std::println(stderr, "Error: {} is not an image directory, pack or index", collection);
+    return -1;
+  }
+  target.setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return 0;
+}
+
+struct LoadReport {
+  std::string collection;
+  const char* path = "";
+  int ok = 0;
+  int failed = 0;
+  double seconds = 0.0;
+  double qps = 0.0;
+  double p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0, mean = 0.0;
+  double stageMean[StageCount] = {};
+  double stageP95[StageCount] = {};
+  double setupMs = 0.0;
+  uint64_t peakRss = 0;
+};
+
+// Nearest-rank percentile of sorted values
+static double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) return 0.0;
+  size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+  return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+/*
+  Replay the queries against one collection
+
+  Each of the concurrency threads takes the next request number until
+  requests have been sent, request i queries queries[i % size]. Latency is
+  per query from reading the query image to the finished JSON response.
+
+  Output:
+    LoadReport - throughput, latency percentiles, per-stage times and peak RSS
+*/
+static LoadReport runLoad(const LoadTarget& target, const std::vector<std::string>& queries, const LoadOptions& options) {
+  auto runQuery = [&](const std::string& query, QueryWorker& worker, QueryTiming& timing) {
+    timing.ok = target.isIndex ? runIndexQuery(target, query, options, worker, timing)
+                               : runScanQuery(target, query, options, worker, timing);
+  };
+
+  {
+    QueryWorker worker;
+    for (int i = 0; i < options.warmup; i++) {
+      QueryTiming timing;
+      runQuery(queries[i % queries.size()], worker, timing);
+    }
+  }
+
+  int requests = options.requests > 0 ? options.requests : static_cast<int>(queries.size());
+  std::atomic<int> nextRequest{0};
+  std::vector<std::vector<QueryTiming>> timings(options.concurrency);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < options.concurrency; t++) {
+    threads.emplace_back([&, t]() {
+      QueryWorker worker;
+      for (int i = nextRequest++; i < requests; i = nextRequest++) {
+        QueryTiming timing;
+        runQuery(queries[i % queries.size()], worker, timing);
+        timings[t].push_back(timing);
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  LoadReport report;
+  report.collection = target.collection;
+  report.path = target.isIndex ? "index" : "scan";
+  report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  report.setupMs = target.setupMs;
+
+  std::vector<double> latencies;
+  std::vector<double> stages[StageCount];
+  for (const auto& threadTimings : timings) {
+    for (const auto& timing : threadTimings) {
+      if (!timing.ok) {
+        report.failed++;
+        continue;
+      }
+      latencies.push_back(timing.totalMs);
+      for (int s = 0; s < StageCount; s++) stages[s].push_back(timing.stageMs[s]);
+    }
+  }
+  report.ok = static_cast<int>(latencies.size());
+  report.qps = report.seconds > 0.0 ? report.ok / report.seconds : 0.0;
+  std::sort(latencies.begin(), latencies.end());
+  report.p50 = percentile(latencies, 50);
+  report.p95 = percentile(latencies, 95);
+  report.p99 = percentile(latencies, 99);
+  report.max = latencies.empty() ? 0.0 : latencies.back();
+  for (double latency : latencies) report.mean += latency / latencies.size();
+  for (int s = 0; s < StageCount; s++) {
+    for (double ms : stages[s]) report.stageMean[s] += ms / stages[s].size();
+    std::sort(stages[s].begin(), stages[s].end());
+    report.stageP95[s] = percentile(stages[s], 95);
+  }
+  report.peakRss = peakRssBytes();
+  return report;
+}
+
+static void printReport(const LoadReport& report, FeatureType type, const LoadOptions& options) {
+  std::println("\n== {} {} ({}), {} concurrent, k={} ==", report.path, report.collection, featureTypeName(type),
+               options.concurrency, options.k);
+  if (report.setupMs > 0.0) std::println("Setup (not timed per query): {:.1f} ms", report.setupMs);
+  std::println("Throughput: {:.2f} queries/s ({} ok, {} failed in {:.2f} s)", report.qps, report.ok, report.failed,
+               report.seconds);
+  std::println("Latency ms: p50 {:.3f}  p95 {:.3f}  p99 {:.3f}  max {:.3f}  mean {:.3f}", report.p50, report.p95,
+               report.p99, report.max, report.mean);
+  std::println("{:<12} {:>12} {:>12} {:>7}", "stage", "mean ms", "p95 ms", "share");
+  for (int s = 0; s < StageCount; s++) {
+    std::println("{:<12} {:12.3f} {:12.3f} {:6.1f}%", kStageNames[s], report.stageMean[s], report.stageP95[s],
+                 report.mean > 0.0 ? report.stageMean[s] / report.mean * 100.0 : 0.0);
+  }
+  std::println("Peak RSS: {:.1f} MB", report.peakRss / (1024.0 * 1024.0));
+}
+
+static int writeJson(const std::string& filename, const std::vector<LoadReport>& reports, FeatureType type,
+                     const LoadOptions& options) {
+  std::ofstream out(filename, std::ios::trunc);
+  if (!out) {
+    std::println(stderr, "Error: Unable to open {} for writing", filename);
+    return -1;
+  }
+  out << std::format("{{\"type\":\"{}\",\"concurrency\":{},\"k\":{},\"targets\":[\n", featureTypeName(type),
+                     options.concurrency, options.k);
+  for (size_t i = 0; i < reports.size(); i++) {
+    const LoadReport& r = reports[i];
+    std::string stages;
+    for (int s = 0; s < StageCount; s++) {
+      stages += std::format("{}\"{}\":{{\"mean_ms\":{:.4f},\"p95_ms\":{:.4f}}}", s ? "," : "", kStageNames[s],
+                            r.stageMean[s], r.stageP95[s]);
+    }
+    out << std::format("{{\"collection\":\"{}\",\"path\":\"{}\",\"setup_ms\":{:.3f},\"ok\":{},\"failed\":{},"
+                       "\"seconds\":{:.4f},\"qps\":{:.3f},\"latency_ms\":{{\"p50\":{:.4f},\"p95\":{:.4f},"
+                       "\"p99\":{:.4f},\"max\":{:.4f},\"mean\":{:.4f}}},\"stages\":{{{}}},\"peak_rss_bytes\":{}}}{}\n",
+                       jsonEscape(r.collection), r.path, r.setupMs, r.ok, r.failed, r.seconds, r.qps, r.p50, r.p95,
+                       r.p99, r.max, r.mean, stages, r.peakRss, i + 1 < reports.size() ? "," : "");
+  }
+  out << "]}\n";
+  return out ? 0 : -1;
+}
+
+// Query images from a list file (one path per line), a directory or a single image
+static int readQueryList(const std::string& source, const EnumerateOptions& enumerate, std::vector<std::string>& queries) {
+  if (std::filesystem::is_directory(source) || isImagePackFile(source)) {
+    if (isImagePackFile(source)) {
+      std::shared_ptr<const ImagePack> pack = openImagePack(source);
+      for (int i = 0; pack && i < pack->size(); i++) queries.push_back(pack->path(i));
+    } else if (enumerateImages(source, queries, enumerate) != 0) {
+      return -1;
+    }
+  } else if (isImageFile(source)) {
+    queries.push_back(source);
+  } else {
+    std::ifstream in(source);
+    if (!in) {
+      std::println(stderr, "Error: Unable to open query list {}", source);
+      return -1;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      if (!line.empty() && line[0] != '#') queries.push_back(line);
+    }
+  }
+  if (queries.empty()) {
+    std::println(stderr, "Error: No query images in {}", source);
+    return -1;
+  }
+  return 0;
+}
+
+
+/*
+  Load test
+
+  Usage:
+  ./cbir_loadtest <queries.txt|query_image|query_directory> <feature_type> <collection>... [options]
+  ./cbir_loadtest queries.txt rgbhistogram data/olympus features/olympus_rgb.cbix --concurrency 4 --requests 200
+  ./cbir_loadtest data/olympus/pic.0164.jpg custom data/olympus.cbpk --csv data/ResNet18_olym.csv
+  ./cbir_loadtest data/olympus baseline features/olympus_baseline.cbix --concurrency 8 --json load.json
+
+  Every collection gets the same queries, one after the other; with more
+  than one the throughput and p50 of each is compared to the first. Peak
+  RSS is for the whole process so far, so it only grows from one
+  collection to the next.
+*/
+int main(int argc, char* argv[]) {
+  LoadOptions options;
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (parseImageReaderOption(argc, argv, i, options.io) || parseEnumerateOption(argc, argv, i, options.enumerate)) continue;
+    if (arg == "--concurrency" && hasValue) options.concurrency = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--requests" && hasValue) options.requests = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--warmup" && hasValue) options.warmup = std::max(0, std::atoi(argv[++i]));
+    else if (arg == "--k" && hasValue) options.k = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--csv" && hasValue) options.csvPath = argv[++i];
+    else if (arg == "--json" && hasValue) options.jsonFile = argv[++i];
+    else if (arg == "--search" && hasValue) {
+      std::string mode = argv[++i];
+      if (mode == "exhaustive") options.search.mode = SearchExhaustive;
+      else if (mode == "auto") options.search.mode = SearchAuto;
+      else {
+        std::println(stderr, "Error: Unknown search mode {}", mode);
+        printUsage(argv[0]);
+        return MissingArg;
+      }
+    }
+    else if (arg.starts_with("--")) {
+      printUsage(argv[0]);
+      return MissingArg;
+    }
+    else positional.push_back(arg);
+  }
+  if (positional.size() < 3) {
+    printUsage(argv[0]);
+    return MissingArg;
+  }
+
+  FeatureType type;
+  if (!parseFeatureType(positional[1], type)) {
+    std::println(stderr, "Error: Unknown feature type {}", positional[1]);
+    return MissingArg;
+  }
+  std::vector<std::string> queries;
+  if (readQueryList(positional[0], options.enumerate, queries) != 0) return LoadFailed;
+  std::println("{} query images, {} requests per collection", queries.size(),
+               options.requests > 0 ? options.requests : static_cast<int>(queries.size()));
+
+  std::vector<LoadReport> reports;
+  for (size_t c = 2; c < positional.size(); c++) {
+    LoadTarget target;
+    if (loadTarget(positional[c], type, options, target) != 0) return LoadFailed;
+    reports.push_back(runLoad(target, queries, options));
+    printReport(reports.back(), type, options);
+  }
+
+  if (reports.size() > 1) {
+    std::println("\nCompared with {} {}:", reports[0].path, reports[0].collection);
+    for (size_t c = 1; c < reports.size(); c++) {
+      const LoadReport& r = reports[c];
+      std::println("{} {}: {:.2f}x queries/s, p50 {:.3f} ms vs {:.3f} ms ({:.2f}x)", r.path, r.collection,
+                   reports[0].qps > 0.0 ? r.qps / reports[0].qps : 0.0, r.p50, reports[0].p50,
+                   r.p50 > 0.0 ? reports[0].p50 / r.p50 : 0.0);
+    }
+  }
+
+  if (!options.jsonFile.empty() && writeJson(options.jsonFile, reports, type, options) != 0) return LoadFailed;
+  for (const auto& report : reports) {
+    if (report.failed > 0) return QueriesFailed;
+  }
+  return Success;
+}
@@ -0,0 +1,103 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Image pack tool - packs the images of a directory into one .cbpk
+  container, appends new images to a pack and lists its contents.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <print>  // for modern C++ printing (C++23)
+#include <chrono>
+#include "image_pack.h"
+
+enum PackToolExitCode {
+  Success = 0,
+  MissingArg = 1,
+  PackFailed = 2,
+  LoadFailed = 3
+};
+
+static void printUsage(const char* prog) {
+  std::println("Usage:");
+  std::println("  {} create <image_database_directory> <pack_file.cbpk>", prog);
+  std::println("  {} append <pack_file.cbpk> <image_file_or_directory>...", prog);
+  std::println("  {} list <pack_file.cbpk>", prog);
+}
+
+// Pack a whole directory
+static int runCreate(int argc, char* argv[]) {
+  if (argc < 4) {
+    printUsage(argv[0]);
+    return MissingArg;
+  }
+  auto start = std::chrono::steady_clock::now();
+  if (createImagePack(argv[2], argv[3]) != 0) return PackFailed;
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::shared_ptr<const ImagePack> pack = ImagePack::open(argv[3]);
+  if (!pack) return LoadFailed;
+  std::println("Packed {} images in {:.2f}s -> {}", pack->size(), seconds, argv[3]);
+  return Success;
+}
+
+// Add images to an existing pack
+static int runAppend(int argc, char* argv[]) {
+  if (argc < 4) {
+    printUsage(argv[0]);
+    return MissingArg;
+  }
+  std::vector<std::string> inputs(argv + 3, argv + argc);
+  int added = appendImagePack(argv[2], inputs);
+  if (added < 0) return PackFailed;
+
+  std::shared_ptr<const ImagePack> pack = ImagePack::open(argv[2]);
+  if (!pack) return LoadFailed;
+  std::println("Added {} images, {} in {}", added, pack->size(), argv[2]);
+  return Success;
+}
+
+// Print one line per image: name, offset and size
+static int runList(int argc, char* argv[]) {
+  if (argc < 3) {
+    printUsage(argv[0]);
+    return MissingArg;
+  }
+  std::shared_ptr<const ImagePack> pack = ImagePack::open(argv[2]);
+  if (!pack) return LoadFailed;
+  uint64_t bytes = 0;
+  for (int i = 0; i < pack->size(); i++) {
+    const ImagePackEntry& entry = pack->entry(i);
+    std::println("{}\t{}\t{}", entry.name, entry.offset, entry.size);
+    bytes += entry.size;
+  }
+  std::println("{} images, {} bytes", pack->size(), bytes);
+  return Success;
+}
+
+/*
+  Usage:
+  ./cbir_pack create data/olympus data/olympus.cbpk
+  ./cbir_pack append data/olympus.cbpk new_images/
+  ./cbir_pack list data/olympus.cbpk
+  A pack can be used wherever an image directory is expected:
+  ./cbir data/olympus/pic.0164.jpg data/olympus.cbpk rgbhistogram
+*/
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printUsage(argv[0]);
+    return MissingArg;
+  }
+
+  std::string command = argv[1];
+  if (command == "create") return runCreate(argc, argv);
+  if (command == "append") return runAppend(argc, argv);
+  if (command == "list") return runList(argc, argv);
+
+  printUsage(argv[0]);
+  return MissingArg;
+}
@@ -0,0 +1,412 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  CBIR query server - loads one or more feature indexes once and answers
+  top-k queries over localhost HTTP, so repeated queries skip the index
+  load (and the directory scan) that a cbir process pays every time.
+
+  Endpoints:
+    GET  /query?name=pic.0164.jpg&k=4[&type=rgbhistogram][&format=tsv]
+    GET  /query?path=data/olympus/pic.0164.jpg&k=4
+    POST /query?name=pic.0164.jpg&k=4   (body = encoded query image)
+    POST /features?name=pic.0164.jpg    (query features only, raw float32)
+    POST /reload[?force=1]              (reload changed index files in the background)
+    GET  /health
+    GET  /stats  (includes the result cache and batching counters)
+    GET  /trace[?start=1|stop=1]        (recorded trace events as Chrome Trace Event JSON)
+    GET  /metrics                       (counters and latency histograms in the Prometheus text format)
+
+  A sharded index is served by one server per group of shards plus a
+  coordinator (--coordinator --shard <id>=<host:port> ...) that answers
+  /query by fanning it out to the shard servers and merging the results.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <print>  // for modern C++ printing (C++23)
+#include <format>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include "feature_index.h"
+#include "query_service.h"
+#include "thread_pool.h"
+#include "http_util.h"
+#include "trace.h"
+#include "metrics.h"
+#include "shard_coordinator.h"
+
+enum ServerExitCode {
+  Success = 0,
+  MissingArg = 1,
+  LoadFailed = 3,
+  ListenFailed = 4
+};
+
+static const int kDefaultPort = 5330;
+static const int kConnectionTimeoutMs = 10000;  // slow or idle clients give up their worker
+
+// Counters reported by /stats
+struct ServerStats {
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> queries{0};
+  std::atomic<uint64_t> failedQueries{0};
+  std::atomic<uint64_t> queryMicros{0};  // total time spent in QueryService::query
+  std::atomic<uint64_t> reloads{0};      // index types reloaded while serving
+  std::atomic<uint64_t> failedReloads{0};
+  std::atomic<bool> reloading{false};
+};
+
+static void printUsage(const char* prog) {
+  std::println("Usage: {} <index_file.cbix> [more.cbix ...] [--port N] [--threads N] [--cache-mb N]", prog);
+  std::println("       [--batch N] [--batch-wait-us N] [--host ADDR] [--watch-ms N] [--trace]");
+  std::println("       [--metrics-file FILE] [--metrics-interval-ms N]");
+  std::println("       {} --coordinator --shard <id>=<host:port> [--shard ...] [--port N] [--shard-timeout-ms N]", prog);
+  std::println("  serves http://127.0.0.1:{}/query by default", kDefaultPort);
+}
+
+static int httpStatusFor(QueryStatus status) {
+  switch (status) {
+    case QueryOk:          return 200;
+    case QueryNoIndex:
+    case QueryNotInIndex:  return 404;
+    default:               return 400;
+  }
+}
+
+/*
+  Turn the URL parameters and body of a /query request into a QueryRequest
+
+  Output:
+    bool - false if a parameter is invalid (error describes it)
+*/
+static bool parseQueryRequest(const HttpRequest& http, QueryRequest& request, std::string& error) {
+  auto get = [&](const char* key) -> std::string {
+    auto it = http.query.find(key);
+    return it == http.query.end() ? "" : it->second;
+  };
+
+  std::string type = get("type");
+  if (!type.empty()) {
+    if (!parseFeatureType(type, request.type)) {
+      error = std::format("unknown feature type {}", type);
+      return false;
+    }
+    request.hasType = true;
+  }
+
+  std::string k = get("k");
+  if (!k.empty()) request.k = std::atoi(k.c_str());
+
+  std::string mode = get("mode");
+  if (mode == "exhaustive") request.search.mode = SearchExhaustive;
+  else if (mode == "simhash") request.search.mode = SearchSimHash;
+  else if (!mode.empty() && mode != "auto") {
+    error = std::format("unknown search mode {}", mode);
+    return false;
+  }
+
+  request.name = get("name");
+  request.path = get("path");
+  if (get("features") == "1") {
+    // features extracted by another shard server, native float32
+    if (http.body.empty() || http.body.size() % sizeof(float) != 0) {
+      error = "features body is not a float32 array";
+      return false;
+    }
+    request.features.resize(http.body.size() / sizeof(float));
+    std::memcpy(request.features.data(), http.body.data(), http.body.size());
+  } else {
+    request.imageBytes = http.body;
+  }
+  return true;
+}
+
+static HttpResponse handleQuery(const QueryService& service, const HttpRequest& http, ServerStats& stats) {
+  HttpResponse response;
+  QueryRequest request;
+  QueryResponse result;
+  std::string error;
+  if (!parseQueryRequest(http, request, error)) {
+    result.status = QueryBadRequest;
+    result.error = error;
+  } else {
+    auto start = std::chrono::steady_clock::now();
+    service.query(request, result);
+    stats.queryMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  stats.queries++;
+  if (result.status != QueryOk) stats.failedQueries++;
+
+  response.status = httpStatusFor(result.status);
+  auto format = http.query.find("format");
+  if (format != http.query.end() && format->second == "tsv" && result.status == QueryOk) {
+    response.contentType = "text/tab-separated-values";
+    response.body = queryResponseToTsv(result);
+  } else {
+    response.body = queryResponseToJson(result);
+  }
+  return response;
+}
+
+// Query features only, for the shard coordinator (same parameters as /query)
+static HttpResponse handleFeatures(const QueryService& service, const HttpRequest& http) {
+  QueryRequest request;
+  QueryResponse result;
+  std::vector<float> features;
+  std::shared_ptr<const FeatureIndex> index;
+  if (!parseQueryRequest(http, request, result.error)) {
+    result.status = QueryBadRequest;
+  } else {
+    result.status = service.queryFeatures(request, features, index, result.error);
+  }
+  if (result.status != QueryOk) {
+    return {httpStatusFor(result.status), "application/json", queryResponseToJson(result)};
+  }
+  std::string body(reinterpret_cast<const char*>(features.data()), features.size() * sizeof(float));
+  return {200, "application/octet-stream", body};
+}
+
+// Reload on a thread of its own (not a pool worker), queries keep running on the old snapshot
+static void reloadInBackground(QueryService& service, ServerStats& stats, bool force) {
+  if (stats.reloading.exchange(true)) return;  // one reload at a time
+  std::thread([&service, &stats, force] {
+    int reloaded = service.reloadIndexes(force);
+    if (reloaded < 0) stats.failedReloads++;
+    else stats.reloads += reloaded;
+    stats.reloading = false;
+  }).detach();
+}
+
+static HttpResponse handleReload(QueryService& service, const HttpRequest& http, ServerStats& stats) {
+  auto force = http.query.find("force");
+  reloadInBackground(service, stats, force != http.query.end() && force->second == "1");
+  return {202, "application/json", std::format("{{\"status\":\"reloading\",\"generation\":{}}}\n",
+                                               service.snapshot()->generation)};
+}
+
+// Start/stop recording, or hand back what the trace ring buffers hold right now
+static HttpResponse handleTrace(const HttpRequest& http) {
+  auto start = http.query.find("start");
+  auto stop = http.query.find("stop");
+  if (start != http.query.end() && start->second == "1") {
+    startTrace();
+    return {200, "application/json", "{\"status\":\"tracing\"}\n"};
+  }
+  if (stop != http.query.end() && stop->second == "1") {
+    stopTrace();
+    return {200, "application/json", "{\"status\":\"stopped\"}\n"};
+  }
+  return {200, "application/json", traceToJson()};
+}
+
+static HttpResponse handleStats(const QueryService& service, const ServerStats& stats, int threads,
+                                std::chrono::steady_clock::time_point started) {
+  double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  uint64_t queries = stats.queries;
+  ResultCacheStats cache = service.cacheStats();
+  std::string json = std::format("{{\"uptime_s\":{:.1f},\"threads\":{},\"requests\":{},\"queries\":{},"
+                                 "\"failed_queries\":{},\"mean_query_ms\":{:.3f},",
+                                 uptime, threads, stats.requests.load(), queries, stats.failedQueries.load(),
+                                 queries ? stats.queryMicros / 1000.0 / queries : 0.0);
+  BatchStats batch = service.batchStats();
+  json += std::format("\"batching\":{{\"batches\":{},\"queries\":{},\"mean_batch\":{:.2f},\"largest_batch\":{},"
+                      "\"window_us\":{:.0f}}},",
+                      batch.batches, batch.queries, batch.batches ? double(batch.queries) / batch.batches : 0.0,
+                      batch.largestBatch, batch.windowUs);
+  json += std::format("\"cache\":{{\"enabled\":{},\"hits\":{},\"misses\":{},\"entries\":{},\"bytes\":{},"
+                      "\"budget_bytes\":{},\"evictions\":{},\"invalidations\":{}}},",
+                      cache.budgetBytes > 0 ? "true" : "false", cache.hits, cache.misses, cache.entries, cache.bytes,
+                      cache.budgetBytes, cache.evictions, cache.invalidations);
+  auto snapshot = service.snapshot();  // one consistent view, even during a reload
+  json += std::format("\"generation\":{},\"reloads\":{},\"failed_reloads\":{},\"indexes\":[", snapshot->generation,
+                      stats.reloads.load(), stats.failedReloads.load());
+  bool first = true;
+  for (const auto& [type, index] : snapshot->indexes) {
+    json += std::format("{}{{\"type\":\"{}\",\"images\":{},\"dim\":{},\"version\":{}}}",
+                        first ? "" : ",", featureTypeName(type), index->size(), index->dim, index->version);
+    first = false;
+  }
+  json += "]}\n";
+  return {200, "application/json", json};
+}
+
+// Serve one connection on a pool thread (a coordinator answers /query and /stats itself)
+static void handleConnection(SocketHandle conn, QueryService& service, ShardCoordinator* coordinator,
+                             ServerStats& stats, int threads, std::chrono::steady_clock::time_point started) {
+  httpSetTimeout(conn, kConnectionTimeoutMs);
+  HttpRequest request;
+  HttpResponse response;
+  if (!httpReadRequest(conn, request)) {
+    response = {400, "application/json", "{\"status\":\"error\",\"error\":\"malformed request\"}\n"};
+  } else if (coordinator && request.path == "/query") {
+    response = coordinator->handleQuery(request);
+    stats.queries++;
+    if (response.status != 200) stats.failedQueries++;
+  } else if (coordinator && request.path == "/stats") {
+    response.body = std::format("{{\"requests\":{},\"queries\":{},\"failed_queries\":{},\"coordinator\":{}}}\n",
+                                stats.requests.load(), stats.queries.load(), stats.failedQueries.load(),
+                                coordinator->statsJson());
+  } else if (request.path == "/query") {
+    response = handleQuery(service, request, stats);
+  } else if (request.path == "/features") {
+    response = handleFeatures(service, request);
+  } else if (request.path == "/reload" && !coordinator) {
+    response = handleReload(service, request, stats);
+  } else if (request.path == "/trace") {
+    response = handleTrace(request);
+  } else if (request.path == "/metrics") {
+    response = {200, "text/plain; version=0.0.4", metricsToPrometheus()};
+  } else if (request.path == "/health") {
+    response.body = "{\"status\":\"ok\"}\n";
+  } else if (request.path == "/stats") {
+    response = handleStats(service, stats, threads, started);
+  } else {
+    response = {404, "application/json", "{\"status\":\"error\",\"error\":\"unknown endpoint\"}\n"};
+  }
+  stats.requests++;
+  httpWriteResponse(conn, response);
+  httpClose(conn);
+}
+
+
+/*
+  Usage:
+  ./cbir_server.exe features/olympus_rgb.cbix features/olympus_dnn.cbix --port 5330
+  ./cbir.exe --server 127.0.0.1:5330 data/olympus/pic.0164.jpg
+
+  Sharded:
+  ./cbir_index.exe shard features/olympus_rgb.cbix 2 features/olympus_rgb
+  ./cbir_server.exe features/olympus_rgb.shard0of2.cbix --port 5331
+  ./cbir_server.exe features/olympus_rgb.shard1of2.cbix --port 5332
+  ./cbir_server.exe --coordinator --shard 0=127.0.0.1:5331 --shard 1=127.0.0.1:5332
+*/
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printUsage(argv[0]);
+    exit(MissingArg);
+  }
+
+  int port = kDefaultPort;
+  int threads = 0;
+  long cacheMb = kDefaultResultCacheBytes / (1024 * 1024);
+  std::string host = "127.0.0.1";
+  int watchMs = 0;
+  std::string metricsFile;
+  int metricsIntervalMs = 10000;
+  BatchOptions batchOptions;
+  CoordinatorOptions coordinatorOptions;
+  bool coordinatorMode = false;
+  std::vector<std::string> shardArgs;
+  std::vector<std::string> indexFiles;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--port" && i + 1 < argc) {
+      port = std::atoi(argv[++i]);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      threads = std::atoi(argv[++i]);
+    } else if (arg == "--cache-mb" && i + 1 < argc) {
+      cacheMb = std::atol(argv[++i]);
+    } else if (arg == "--batch" && i + 1 < argc) {
+      batchOptions.maxBatch = std::atoi(argv[++i]);
+    } else if (arg == "--batch-wait-us" && i + 1 < argc) {
+      batchOptions.maxWaitUs = std::atoi(argv[++i]);
+    } else if (arg == "--host" && i + 1 < argc) {
+      host = argv[++i];
+    } else if (arg == "--watch-ms" && i + 1 < argc) {
+      watchMs = std::atoi(argv[++i]);
+    } else if (arg == "--trace") {
+      startTrace();  // fetched with GET /trace, the server is stopped rather than exiting
+    } else if (arg == "--metrics-file" && i + 1 < argc) {
+      metricsFile = argv[++i];  // for the node_exporter textfile collector, GET /metrics is always served
+    } else if (arg == "--metrics-interval-ms" && i + 1 < argc) {
+      metricsIntervalMs = std::atoi(argv[++i]);
+    } else if (arg == "--coordinator") {
+      coordinatorMode = true;
+    } else if (arg == "--shard" && i + 1 < argc) {
+      shardArgs.push_back(argv[++i]);
+    } else if (arg == "--shard-timeout-ms" && i + 1 < argc) {
+      coordinatorOptions.timeoutMs = std::atoi(argv[++i]);
+    } else {
+      indexFiles.push_back(arg);
+    }
+  }
+  if (coordinatorMode ? shardArgs.empty() : indexFiles.empty()) {
+    printUsage(argv[0]);
+    exit(MissingArg);
+  }
+
+  // 1. a coordinator only knows where the shards are served
+  std::unique_ptr<ShardCoordinator> coordinator;
+  if (coordinatorMode) {
+    coordinator = std::make_unique<ShardCoordinator>(coordinatorOptions);
+    for (const auto& shardArg : shardArgs) {
+      size_t eq = shardArg.find('=');
+      if (eq == std::string::npos || coordinator->addShard(std::atoi(shardArg.substr(0, eq).c_str()),
+                                                           shardArg.substr(eq + 1)) != 0) {
+        std::println(stderr, "Error: Invalid shard {} (expected <id>=<host:port>)", shardArg);
+        exit(MissingArg);
+      }
+    }
+    if (coordinator->validate() != 0) {
+      std::println(stderr, "Error: Shard ids must cover 0..n-1");
+      exit(MissingArg);
+    }
+  }
+
+  // 2. load every index once, they stay in memory for the lifetime of the server
+  QueryService service;
+  service.setCacheBudget(static_cast<size_t>(std::max(0L, cacheMb)) * 1024 * 1024);
+  service.enableBatching(batchOptions);
+  for (const auto& indexFile : indexFiles) {
+    if (service.loadIndex(indexFile) != 0) {
+      exit(LoadFailed);
+    }
+  }
+
+  // 3. listen on localhost by default, the server has no authentication
+  SocketHandle listener = httpListen(host, port);
+  if (listener == kInvalidSocket) {
+    std::println(stderr, "Error: Failed to listen on {}:{}", host, port);
+    exit(ListenFailed);
+  }
+
+  ThreadPool pool(threads);
+  ServerStats stats;
+  auto started = std::chrono::steady_clock::now();
+  std::println("Listening on http://{}:{} with {} threads{}", host, port, pool.size(),
+               coordinator ? " (shard coordinator)" : "");
+  if (!metricsFile.empty()) startMetricsFile(metricsFile, metricsIntervalMs);
+
+  // 4. published index files are picked up without a restart
+  if (watchMs > 0 && !coordinator) {
+    std::thread([&service, &stats, watchMs] {
+      for (;;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(watchMs));
+        reloadInBackground(service, stats, false);
+      }
+    }).detach();
+  }
+
+  // 5. accept loop, each connection is served by a pool thread
+  for (;;) {
+    SocketHandle conn = httpAcceptRetry(listener);
+    if (conn == kInvalidSocket) break;
+    ShardCoordinator* shards = coordinator.get();
+    pool.submit([conn, &service, shards, &stats, &pool, started] {
+      handleConnection(conn, service, shards, stats, pool.size(), started);
+    });
+  }
+  // the listener is gone, a server that cannot accept should not look alive
+  httpClose(listener);
+  exit(ListenFailed);
+}
@@ -15,6 +15,7 @@ The function returns a std::vector of char* for the filenames and a 2D std::vect
 #include <cstring>
 #include <vector>
 #include "opencv2/opencv.hpp"
+#include "feature_writer.h"
 
 /*
   reads a string from a CSV file. the 0-terminated string is returned in the char array os.
@@ -112,36 +113,18 @@ int getfloat(FILE *fp, float *v) {
   The function returns a non-zero value in case of an error.
  */
 int append_image_data_csv( char *filename, char *image_filename, std::vector<float> &image_data, int reset_file ) {
-  char buffer[256];
-  char mode[8];
-  FILE *fp;
-
-  strcpy(mode, "a");
+  // one row through the buffered writer, callers writing many rows should keep a FeatureWriter open instead
+  FeatureWriterOptions options;
+  options.append = !reset_file;
 
-  if( reset_file ) {
-    strcpy( mode, "w" );
-  }
-  
-  fp = fopen( filename, mode );
-  if(!fp) {
+  FeatureWriter writer;
+  if( writer.open( filename, options ) != 0 ) {
     printf("Unable to open output file %s\n", filename );
     exit(-1);
   }
+  writer.write( image_filename, image_data );
 
-  // write the filename and the feature vector to the CSV file
-  strcpy(buffer, image_filename);
-  std::fwrite(buffer, sizeof(char), strlen(buffer), fp );
-  for(int i=0;i<image_data.size();i++) {
-    char tmp[256];
-    sprintf(tmp, ",%.4f", image_data[i] );
-    std::fwrite(tmp, sizeof(char), strlen(tmp), fp );
-  }
-      
-  std::fwrite("\n", sizeof(char), 1, fp); // EOL
-
-  fclose(fp);
-  
-  return(0);
+  return( writer.close() );
 }
 
 /*
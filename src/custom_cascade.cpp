@@ -0,0 +1,93 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the two-stage evaluator for the custom portrait distance.
+*/
+
+#include "custom_cascade.h"
+#include "distance.h"
+#include <algorithm>
+#include <numeric>
+#include <queue>
+
+// the full distance is rounded to float, keep the bounds a hair on the safe side
+static const double kCascadeSlack = 1e-6;
+
+/*
+  Stage 1: every candidate gets the bounds
+    lower = 0.7 * dnn              (skin and brightness terms are >= 0)
+    upper = 0.7 * dnn + 0.2 + 0.1  (skin and brightness terms are <= 1)
+  The k-th smallest upper bound is the cutoff: at least k candidates have a
+  full distance <= cutoff, so a candidate with lower > cutoff never makes it.
+
+  Stage 2: survivors are scored in lower bound order, stopping as soon as the
+  next lower bound is above the k-th best full distance. A candidate that
+  fails to score just moves the stop further down the list, so the result is
+  always the exhaustive top-k.
+*/
+void customCascadeTopK(const std::vector<float>& dnnDistances, int k,
+                       const std::function<bool(int id, float& distance)>& scoreFull,
+                       std::vector<std::pair<float, int>>& results, CustomCascadeStats* stats) {
+  results.clear();
+  if (k <= 0) return;
+
+  int n = static_cast<int>(dnnDistances.size());
+  const double remainingWeight = kCustomSkinWeight + kCustomBrightnessWeight;
+
+  std::vector<double> lower(n);
+  for (int i = 0; i < n; i++) {
+    lower[i] = kCustomDnnWeight * dnnDistances[i] - kCascadeSlack;
+  }
+
+  // cutoff from the k-th smallest upper bound (stats only, stage 2 stops on its own)
+  double cutoff = 0.0;
+  int survivors = n;
+  if (k < n) {
+    std::vector<double> upper(n);
+    for (int i = 0; i < n; i++) upper[i] = lower[i] + remainingWeight + 2 * kCascadeSlack;
+    std::nth_element(upper.begin(), upper.begin() + (k - 1), upper.end());
+    cutoff = upper[k - 1];
+    survivors = static_cast<int>(std::count_if(lower.begin(), lower.end(), [&](double l) { return l <= cutoff; }));
+  }
+
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    if (lower[a] != lower[b]) return lower[a] < lower[b];
+    return a < b;
+  });
+
+  // max-heap on {distance, id}, top is the current k-th best
+  std::priority_queue<std::pair<float, int>> best;
+  int fullyScored = 0;
+  for (int id : order) {
+    if (static_cast<int>(best.size()) >= k && lower[id] > best.top().first) break;
+
+    float distance;
+    fullyScored++;
+    if (!scoreFull(id, distance)) continue;
+
+    if (static_cast<int>(best.size()) < k) {
+      best.push({distance, id});
+    } else if (std::make_pair(distance, id) < best.top()) {
+      best.pop();
+      best.push({distance, id});
+    }
+  }
+
+  while (!best.empty()) {
+    results.push_back(best.top());
+    best.pop();
+  }
+  std::reverse(results.begin(), results.end());
+
+  if (stats) {
+    stats->candidates = n;
+    stats->survivors = survivors;
+    stats->fullyScored = fullyScored;
+    stats->cutoff = static_cast<float>(cutoff);
+  }
+}
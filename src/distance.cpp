@@ -9,6 +9,8 @@
 
 #include "distance.h"
 #include <iostream>
+#include <cmath>
+#include <algorithm>
 
 
 /*
@@ -240,16 +242,7 @@ float cosineDistance(const std::vector<float>& vA,
 float customDistance(const std::vector<float>& f1, const std::vector<float>& f2) {
   
   // cosine distance on DNN features
-  float dot = 0, mag1 = 0, mag2 = 0;
-  for (int i = 0; i < 512; i++) {
-    dot += f1[i] * f2[i];
-    mag1 += f1[i] * f1[i];
-    mag2 += f2[i] * f2[i];
-  }
-  
-  float similarity = dot / (sqrt(mag1) * sqrt(mag2));
-  similarity = std::min(similarity, 1.0f);  // clamp to avoid -0
-  float dnn_dist = 1.0 - similarity;
+  float dnn_dist = customDnnDistance(f1, f2);
   
   // skin tone histogram comparison
   float s1 = 0, s2 = 0;
@@ -267,5 +260,23 @@ float customDistance(const std::vector<float>& f1, const std::vector<float>& f2)
   float bright_dist = std::abs(f1[528] - f2[528]) / 255.0;
   
   // weighted combo - tweaked these to get better results
-  return 0.7 * dnn_dist + 0.2 * skin_dist + 0.1 * bright_dist;
+  return kCustomDnnWeight * dnn_dist + kCustomSkinWeight * skin_dist + kCustomBrightnessWeight * bright_dist;
+}
+
+/*
+  DNN term of the custom distance
+  Cosine distance on the first 512 values, shared with the cascaded
+  evaluator so both stages see the exact same value
+*/
+float customDnnDistance(const std::vector<float>& f1, const std::vector<float>& f2) {
+  float dot = 0, mag1 = 0, mag2 = 0;
+  for (int i = 0; i < 512; i++) {
+    dot += f1[i] * f2[i];
+    mag1 += f1[i] * f1[i];
+    mag2 += f2[i] * f2[i];
+  }
+  
+  float similarity = dot / (sqrt(mag1) * sqrt(mag2));
+  similarity = std::min(similarity, 1.0f);  // clamp to avoid -0
+  return 1.0 - similarity;
 }
\ No newline at end of file
@@ -0,0 +1,708 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the feature/distance dispatch helpers and the
+  precomputed feature index (build, save and load).
+*/
+
+#include "feature_index.h"
+#include "features.h"
+#include "distance.h"
+#include "image_pack.h"
+#include "feature_writer.h"
+#include "alloc_counter.h"
+#include <print>  // for modern C++ printing (C++23)
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <format>
+#include <mutex>
+
+// File layout: header, rows, then optional tagged sections until EOF
+static const char kIndexMagic[4] = {'C', 'B', 'I', 'X'};
+static const uint32_t kIndexFormatVersion = 1;
+static const char kPyramidTag[4] = {'P', 'Y', 'R', 'M'};
+static const char kSimHashTag[4] = {'S', 'I', 'M', 'H'};
+static const char kVPTreeTag[4] = {'V', 'P', 'T', 'R'};
+static const char kShardTag[4] = {'S', 'H', 'R', 'D'};
+
+struct FeatureTypeName {
+  FeatureType type;
+  const char* name;
+};
+
+// same names as the cbir command line
+static const FeatureTypeName kFeatureTypeNames[] = {
+  {Baseline, "baseline"},
+  {RGChromHistogram, "rghistogram"},
+  {RGBChromHistogram, "rgbhistogram"},
+  {MultiHistogram, "multihistogram"},
+  {TextureAndColor, "textureandcolor"},
+  {DNNEmbedding, "dnnembedding"},
+  {CustomDesign, "custom"},
+  {OrientedGradientHistogram, "gradient"},
+};
+
+
+bool parseFeatureType(const std::string& name, FeatureType& type) {
+  for (const auto& entry : kFeatureTypeNames) {
+    if (name == entry.name) {
+      type = entry.type;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* featureTypeName(FeatureType type) {
+  for (const auto& entry : kFeatureTypeNames) {
+    if (entry.type == type) return entry.name;
+  }
+  return "unknown";
+}
+
+bool featureTypeNeedsEmbedding(FeatureType type) {
+  return type == DNNEmbedding || type == CustomDesign;
+}
+
+bool featureTypeSupportsSampling(FeatureType type) {
+  return type == RGChromHistogram || type == RGBChromHistogram || type == MultiHistogram || type == TextureAndColor;
+}
+
+
+// Extract features for any feature type (returns 0 on success)
+int extractFeatures(FeatureType type, const cv::Mat& image, const std::vector<float>& embedding,
+                    std::vector<float>& features, const PixelSampling& sampling) {
+  switch (type) {
+    case RGChromHistogram:          return extractRGChromHistogram(image, features, 16, sampling);
+    case RGBChromHistogram:         return extractRGBChromHistogram(image, features, 8, sampling);
+    case MultiHistogram:            return extractMultiHistogram(image, features, sampling);
+    case TextureAndColor:           return extractTextureAndColor(image, features, sampling);
+    case OrientedGradientHistogram: return extractOrientedGradientHistogram(image, features);
+    case DNNEmbedding:
+      features = embedding;
+      return features.empty() ? -1 : 0;
+    case CustomDesign:
+      return embedding.empty() ? -1 : extractCustomFeaturesWithEmbedding(image, embedding, features);
+    default: return extractBaselineFeatures(image, features);
+  }
+}
+
+// Compute distance between two feature vectors
+float computeDistance(FeatureType type, const std::vector<float>& a, const std::vector<float>& b) {
+  switch (type) {
+    case RGChromHistogram:
+    case RGBChromHistogram:
+    case OrientedGradientHistogram: return histogramIntersectionDistance(a, b);
+    case MultiHistogram:            return multiHistogramDistance(a, b);
+    case TextureAndColor:           return textureAndColorDistance(a, b);
+    case DNNEmbedding:              return cosineDistance(a, b);
+    case CustomDesign:              return customDistance(a, b);
+    default:                        return sumOfSquaredDifference(a, b);
+  }
+}
+
+
+// Histogram layout of the feature types that support the coarse pyramid
+static std::vector<HistogramSegment> histogramSegments(FeatureType type) {
+  switch (type) {
+    case RGBChromHistogram: return {{0, 512, true}};
+    case MultiHistogram:    return {{0, 512, true}, {512, 512, true}};
+    case TextureAndColor:   return {{0, 16, false}, {16, 512, true}};
+    default:                return {};
+  }
+}
+
+// True if dim is the width the segments of the type cover (a feature type without segments has no pyramid)
+static bool segmentsMatchDim(const std::vector<HistogramSegment>& segments, int dim) {
+  return !segments.empty() && segments.back().offset + segments.back().size == dim;
+}
+
+// SimHash support: embeddings are projected as is, histograms are normalized per segment
+static bool simhashLayout(FeatureType type, int dim, std::vector<HistogramSegment>& segments) {
+  switch (type) {
+    case DNNEmbedding:
+      segments.clear();
+      return true;
+    case RGChromHistogram:
+    case RGBChromHistogram:
+    case OrientedGradientHistogram:
+      segments = {{0, dim, false}};
+      return true;
+    case MultiHistogram:
+    case TextureAndColor:
+      segments = histogramSegments(type);
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Database images sorted by path (pack entries or the listing of a directory), -1 if neither can be read
+static int listDatabaseImages(const std::string& imageDir, const EnumerateOptions& enumerate,
+                              std::shared_ptr<const ImagePack>& pack, std::vector<std::string>& imageFiles) {
+  if (isImagePackFile(imageDir)) {
+    pack = openImagePack(imageDir);
+    if (!pack) return -1;
+  } else if (!std::filesystem::is_directory(imageDir)) {
+    std::println(stderr, "Error: {} is not a directory", imageDir);
+    return -1;
+  }
+
+  // sorted so the row order matches sorting {distance, path} pairs
+  if (pack) {
+    for (int i = 0; i < pack->size(); i++) imageFiles.push_back(pack->path(i));
+  } else if (enumerateImages(imageDir, imageFiles, enumerate) != 0) {
+    return -1;
+  }
+  std::sort(imageFiles.begin(), imageFiles.end());
+  return 0;
+}
+
+// DNN embeddings by filename for the types that need them (CSV or binary feature file)
+static int loadEmbeddings(FeatureType type, const std::string& csvPath, std::unordered_map<std::string, int>& lookup,
+                          std::vector<std::vector<float>>& embeddings) {
+  if (!featureTypeNeedsEmbedding(type)) return 0;
+  std::vector<std::string> names;
+  if (readFeatureFile(csvPath, names, embeddings) != 0) {
+    std::println(stderr, "Error: Failed to read CSV file {}", csvPath);
+    return -1;
+  }
+  for (int i = 0; i < (int)names.size(); i++) lookup[names[i]] = i;
+  return 0;
+}
+
+/*
+  Build the feature index for a directory of images
+
+  Input:
+    imageDir - image database directory or image pack (.cbpk)
+    type - feature type to extract
+    csvPath - DNN embedding CSV (only used for DNNEmbedding and CustomDesign)
+    index - output index
+    options - optional acceleration structures
+
+  Output:
+    int - 0 on success, -1 if the directory or the CSV could not be read
+*/
+int buildFeatureIndex(const std::string& imageDir, FeatureType type, const std::string& csvPath,
+                      FeatureIndex& index, const IndexBuildOptions& options) {
+  std::shared_ptr<const ImagePack> pack;
+  std::vector<std::string> imageFiles;
+  if (listDatabaseImages(imageDir, options.enumerate, pack, imageFiles) != 0) return -1;
+
+  // DNN embeddings for the types that need them
+  std::vector<std::vector<float>> csvEmbeddings;
+  std::unordered_map<std::string, int> csvLookup;
+  if (loadEmbeddings(type, csvPath, csvLookup, csvEmbeddings) != 0) return -1;
+
+  index.type = type;
+  index.dim = 0;
+  index.paths.clear();
+  index.features.clear();
+  index.version = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+
+  // files are read ahead in path order (pack entries come from its mapping), DNN embeddings need no image at all
+  std::unique_ptr<ImageReader> reader;
+  if (type != DNNEmbedding) {
+    reader = pack ? std::make_unique<ImageReader>(pack, options.io) : std::make_unique<ImageReader>(imageFiles, options.io);
+  }
+
+  // Rows are allocated before the loop and extracted into in place, the decoded image and the
+  // extractors' intermediates live in this thread's scratch, so once those have grown to the
+  // largest image the loop allocates nothing of its own
+  FeatureScratch& scratch = threadFeatureScratch();
+  index.paths.reserve(imageFiles.size());
+  index.features.resize(imageFiles.size());
+  int rows = 0;
+  std::string filename;
+
+  static const std::vector<float> noEmbedding;
+  ScanAllocations* allocations = options.allocations;
+  ImageFile file;  // reused, the reader fills it in place
+  for (size_t i = 0; i < imageFiles.size(); i++) {
+    std::string& imageFile = imageFiles[i];
+    uint64_t start = heapAllocationCount();
+    if (reader) reader->next(file);  // one per image, before anything can skip it
+    uint64_t afterRead = heapAllocationCount();
+
+    const std::vector<float>* embedding = &noEmbedding;
+    if (featureTypeNeedsEmbedding(type)) {
+      filename.assign(imageFile, imageFile.find_last_of("/\\") + 1);  // npos + 1 is the whole path
+      auto it = csvLookup.find(filename);
+      if (it == csvLookup.end()) {
+        std::println(stderr, "Error: No embedding for image {}", imageFile);
+        continue;
+      }
+      embedding = &csvEmbeddings[it->second];
+    }
+
+    // DNN embeddings come straight from the CSV, no need to decode the image
+    uint64_t beforeDecode = heapAllocationCount();
+    if (type != DNNEmbedding && !decodeImageFile(file, scratch.decoded)) {
+      std::println(stderr, "Error: Failed to load image {}", imageFile);
+      continue;
+    }
+    uint64_t afterDecode = heapAllocationCount();
+
+    std::vector<float>& features = index.features[rows];
+    if (extractFeatures(type, scratch.decoded, *embedding, features, options.sampling) != 0) {
+      std::println(stderr, "Error: Failed to extract features from image {}", imageFile);
+      continue;
+    }
+
+    // the first row gives the width, every row after it gets that capacity in one pass
+    if (rows == 0) {
+      index.dim = static_cast<int>(features.size());
+      for (size_t r = 1; r < index.features.size(); r++) index.features[r].reserve(index.dim);
+    }
+    index.paths.push_back(std::move(imageFile));  // the reader has its own copy of the paths
+    rows++;
+
+    if (allocations && static_cast<int>(i) >= allocations->warmupImages) {
+      allocations->add(start, afterRead, beforeDecode, afterDecode, heapAllocationCount());
+    }
+  }
+  index.features.resize(rows);
+
+  index.pyramid = HistogramPyramid();
+  index.simhash = SimHash();
+  index.vptree = VPTree();
+  finalizeFeatureIndex(index);
+
+  // signatures are only built here, they are too expensive to rebuild on every load
+  std::vector<HistogramSegment> segments;
+  if (options.simhashBits > 0 && simhashLayout(type, index.dim, segments)) {
+    buildSimHash(index.features, index.dim, options.simhashBits, segments, index.simhash);
+  }
+  return 0;
+}
+
+
+int reportScanAllocations(const ScanAllocations& allocations) {
+  int measured = std::max(1, allocations.images);
+  std::println("Allocations per image after {} warm-up images ({} measured): read {:.2f}, decode {:.2f}, "
+               "extract {:.2f} ({} images allocated outside imdecode)",
+               allocations.warmupImages, allocations.images, (double)allocations.read / measured,
+               (double)allocations.decode / measured, (double)allocations.extract / measured,
+               allocations.imagesAllocating);
+  if (allocations.read + allocations.extract > 0) {
+    std::println(stderr, "Error: The scan loop allocated in steady state");
+    return -1;
+  }
+  return 0;
+}
+
+
+/*
+  Write the features of every image to a feature file
+
+  Images are decoded and their features extracted on several threads; the
+  rows go through an ordered FeatureWriter, so the file lists them in path
+  order whatever order the threads finish in. Each row is named by the
+  image path below imageDir (the filename for a flat directory).
+
+  Input:
+    imageDir - image database directory or image pack (.cbpk)
+    type - feature type to extract
+    csvPath - DNN embedding CSV (only used for DNNEmbedding and CustomDesign)
+    outFile - CSV, or binary for a .cbft name
+    options - extraction threads and directory listing
+
+  Output:
+    int - 0 on success, -1 if the images, the CSV or the output file could not be read/written
+*/
+int exportFeatures(const std::string& imageDir, FeatureType type, const std::string& csvPath,
+                   const std::string& outFile, const FeatureExportOptions& options) {
+  std::shared_ptr<const ImagePack> pack;
+  std::vector<std::string> imageFiles;
+  if (listDatabaseImages(imageDir, options.enumerate, pack, imageFiles) != 0) return -1;
+
+  std::vector<std::vector<float>> csvEmbeddings;
+  std::unordered_map<std::string, int> csvLookup;
+  if (loadEmbeddings(type, csvPath, csvLookup, csvEmbeddings) != 0) return -1;
+
+  FeatureWriterOptions writerOptions;
+  writerOptions.format = featureFileFormat(outFile);
+  writerOptions.ordered = true;
+  FeatureWriter writer;
+  if (writer.open(outFile, writerOptions) != 0) return -1;
+
+  std::atomic<size_t> next{0};
+  auto work = [&]() {
+    static const std::vector<float> noEmbedding;
+    std::vector<float> features;
+    for (size_t i = next++; i < imageFiles.size(); i = next++) {
+      const std::string& imageFile = imageFiles[i];
+      const std::vector<float>* embedding = &noEmbedding;
+      if (featureTypeNeedsEmbedding(type)) {
+        auto it = csvLookup.find(std::filesystem::path(imageFile).filename().string());
+        if (it == csvLookup.end()) {
+          std::println(stderr, "Error: No embedding for image {}", imageFile);
+          writer.skip(i);
+          continue;
+        }
+        embedding = &csvEmbeddings[it->second];
+      }
+
+      cv::Mat image;
+      if (type != DNNEmbedding) image = readImage(imageFile);
+      if ((type != DNNEmbedding && image.empty()) || extractFeatures(type, image, *embedding, features, options.sampling) != 0) {
+        std::println(stderr, "Error: Failed to extract features from image {}", imageFile);
+        writer.skip(i);
+        continue;
+      }
+
+      std::string name = pack ? imageFile.substr(pack->filename().size() + 1)
+                              : std::filesystem::path(imageFile).lexically_relative(imageDir).generic_string();
+      writer.write(i, name, features);
+    }
+  };
+
+  int threads = options.threads > 0 ? options.threads : static_cast<int>(std::thread::hardware_concurrency());
+  std::vector<std::thread> pool;
+  for (int t = 1; t < std::min<int>(threads, static_cast<int>(imageFiles.size())); t++) pool.emplace_back(work);
+  work();
+  for (auto& thread : pool) thread.join();
+  return writer.close();
+}
+
+
+// Rebuild the filename lookup and the acceleration structures from the rows
+void finalizeFeatureIndex(FeatureIndex& index) {
+  index.nameLookup.clear();
+  for (int i = 0; i < index.size(); i++) {
+    index.nameLookup[std::filesystem::path(index.paths[i]).filename().string()] = i;
+  }
+
+  auto segments = histogramSegments(index.type);
+  if (segmentsMatchDim(segments, index.dim) && index.pyramid.segments.empty()) {
+    buildHistogramPyramid(index.features, segments, index.pyramid);
+  }
+
+  if (index.type == Baseline && index.vptree.empty() && index.size() > 0) {
+    buildVPTree(index.features, index.vptree);
+  }
+}
+
+
+// small helpers for the binary format
+template <typename T>
+static void writeValue(std::ofstream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::ifstream& in, T& value) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+static void writeFloats(std::ofstream& out, const std::vector<float>& values) {
+  out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+}
+
+static bool readFloats(std::ifstream& in, std::vector<float>& values, size_t count) {
+  values.resize(count);
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(values.data()), count * sizeof(float)));
+}
+
+// SimHash section: bits, dim, segments, mean, planes, signatures
+static void writeSimHash(std::ofstream& out, const SimHash& simhash) {
+  uint64_t length = sizeof(int32_t) * (4 + 3 * simhash.normalizeSegments.size()) +
+                    sizeof(float) * (simhash.mean.size() + simhash.planes.size()) +
+                    sizeof(uint64_t) * simhash.signatures.size();
+  out.write(kSimHashTag, 4);
+  writeValue(out, length);
+
+  writeValue(out, static_cast<int32_t>(simhash.bits));
+  writeValue(out, static_cast<int32_t>(simhash.dim));
+  writeValue(out, static_cast<int32_t>(simhash.normalizeSegments.size()));
+  for (const auto& seg : simhash.normalizeSegments) {
+    writeValue(out, static_cast<int32_t>(seg.offset));
+    writeValue(out, static_cast<int32_t>(seg.size));
+    writeValue(out, static_cast<int32_t>(seg.rgbCube));
+  }
+  writeValue(out, static_cast<int32_t>(simhash.mean.size()));
+  writeFloats(out, simhash.mean);
+  writeFloats(out, simhash.planes);
+  out.write(reinterpret_cast<const char*>(simhash.signatures.data()), simhash.signatures.size() * sizeof(uint64_t));
+}
+
+static bool readSimHash(std::ifstream& in, int rows, SimHash& simhash) {
+  int32_t bits = 0, dim = 0, numSegments = 0, meanSize = 0;
+  if (!readValue(in, bits) || !readValue(in, dim) || !readValue(in, numSegments) ||
+      bits <= 0 || bits % 64 != 0 || dim <= 0 || numSegments < 0) {
+    return false;
+  }
+  simhash.bits = bits;
+  simhash.dim = dim;
+  simhash.normalizeSegments.resize(numSegments);
+  for (auto& seg : simhash.normalizeSegments) {
+    int32_t offset = 0, size = 0, rgbCube = 0;
+    if (!readValue(in, offset) || !readValue(in, size) || !readValue(in, rgbCube)) return false;
+    seg = {offset, size, rgbCube != 0};
+  }
+  if (!readValue(in, meanSize) || (meanSize != 0 && meanSize != dim)) return false;
+  if (!readFloats(in, simhash.mean, meanSize)) return false;
+  if (!readFloats(in, simhash.planes, static_cast<size_t>(bits) * dim)) return false;
+  simhash.signatures.resize(static_cast<size_t>(rows) * simhash.words());
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(simhash.signatures.data()),
+                                   simhash.signatures.size() * sizeof(uint64_t)));
+}
+
+
+/*
+  Write the index to a binary file
+
+  Layout: "CBIX", format version, feature type, dim, row count, index version,
+  then for every row the path and dim floats, then optional sections
+  (4 byte tag + 64 bit payload length) so readers can skip unknown ones:
+    PYRM - coarse histogram pyramid
+    SIMH - SimHash hyperplanes and signatures
+    VPTR - vantage-point tree nodes
+    SHRD - shard count and the shard ids held by this file
+*/
+int saveFeatureIndex(const std::string& filename, const FeatureIndex& index) {
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    std::println(stderr, "Error: Unable to open index file {} for writing", filename);
+    return -1;
+  }
+
+  out.write(kIndexMagic, 4);
+  writeValue(out, kIndexFormatVersion);
+  writeValue(out, static_cast<int32_t>(index.type));
+  writeValue(out, static_cast<int32_t>(index.dim));
+  writeValue(out, static_cast<int32_t>(index.size()));
+  writeValue(out, index.version);
+
+  for (int i = 0; i < index.size(); i++) {
+    writeValue(out, static_cast<uint32_t>(index.paths[i].size()));
+    out.write(index.paths[i].data(), index.paths[i].size());
+    writeFloats(out, index.features[i]);
+  }
+
+  // coarse histogram pyramid
+  if (!index.pyramid.empty()) {
+    uint64_t length = sizeof(int32_t) * kPyramidLevels;
+    for (int level = 0; level < kPyramidLevels; level++) {
+      length += index.pyramid.levels[level].size() * sizeof(float);
+    }
+    out.write(kPyramidTag, 4);
+    writeValue(out, length);
+    for (int level = 0; level < kPyramidLevels; level++) {
+      writeValue(out, static_cast<int32_t>(index.pyramid.levelDim[level]));
+      writeFloats(out, index.pyramid.levels[level]);
+    }
+  }
+
+  // SimHash signatures
+  if (!index.simhash.empty()) {
+    writeSimHash(out, index.simhash);
+  }
+
+  // vantage-point tree
+  if (!index.vptree.empty()) {
+    uint64_t length = sizeof(int32_t) * 2 + sizeof(VPNode) * index.vptree.nodes.size();
+    out.write(kVPTreeTag, 4);
+    writeValue(out, length);
+    writeValue(out, static_cast<int32_t>(index.vptree.nodes.size()));
+    writeValue(out, static_cast<int32_t>(index.vptree.root));
+    out.write(reinterpret_cast<const char*>(index.vptree.nodes.data()), sizeof(VPNode) * index.vptree.nodes.size());
+  }
+
+  // shard membership
+  if (index.shardCount > 0) {
+    uint64_t length = sizeof(int32_t) * (2 + index.shardIds.size());
+    out.write(kShardTag, 4);
+    writeValue(out, length);
+    writeValue(out, static_cast<int32_t>(index.shardCount));
+    writeValue(out, static_cast<int32_t>(index.shardIds.size()));
+    for (int id : index.shardIds) writeValue(out, static_cast<int32_t>(id));
+  }
+
+  if (!out) {
+    std::println(stderr, "Error: Failed writing index file {}", filename);
+    return -1;
+  }
+  return 0;
+}
+
+
+// Read an index written by saveFeatureIndex (returns 0 on success)
+int loadFeatureIndex(const std::string& filename, FeatureIndex& index) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) {
+    std::println(stderr, "Error: Unable to open index file {}", filename);
+    return -1;
+  }
+
+  char magic[4];
+  uint32_t formatVersion = 0;
+  int32_t type = 0, dim = 0, count = 0;
+  if (!in.read(magic, 4) || std::memcmp(magic, kIndexMagic, 4) != 0 ||
+      !readValue(in, formatVersion) || formatVersion != kIndexFormatVersion) {
+    std::println(stderr, "Error: {} is not a feature index file", filename);
+    return -1;
+  }
+  if (!readValue(in, type) || !readValue(in, dim) || !readValue(in, count) ||
+      !readValue(in, index.version) || type < 0 || type >= FeatureTypeCount || dim < 0 || count < 0) {
+    std::println(stderr, "Error: Corrupt index header in {}", filename);
+    return -1;
+  }
+
+  index.type = static_cast<FeatureType>(type);
+  index.dim = dim;
+  index.paths.assign(count, std::string());
+  index.features.assign(count, std::vector<float>());
+  index.pyramid = HistogramPyramid();
+  index.simhash = SimHash();
+  index.vptree = VPTree();
+  index.shardCount = 0;
+  index.shardIds.clear();
+
+  for (int i = 0; i < count; i++) {
+    uint32_t pathLength = 0;
+    if (!readValue(in, pathLength)) {
+      std::println(stderr, "Error: Truncated index file {}", filename);
+      return -1;
+    }
+    index.paths[i].resize(pathLength);
+    if (!in.read(index.paths[i].data(), pathLength) || !readFloats(in, index.features[i], dim)) {
+      std::println(stderr, "Error: Truncated index file {}", filename);
+      return -1;
+    }
+  }
+
+  // optional sections
+  char tag[4];
+  uint64_t length = 0;
+  while (in.read(tag, 4) && readValue(in, length)) {
+    if (std::memcmp(tag, kPyramidTag, 4) == 0) {
+      // the query levels are sized from levelDim but filled per segment, the two must agree
+      auto segments = histogramSegments(index.type);
+      bool ok = segmentsMatchDim(segments, dim);
+      for (int level = 0; ok && level < kPyramidLevels; level++) {
+        int32_t levelDim = 0;
+        ok = readValue(in, levelDim) && levelDim == pyramidLevelDim(segments, level) &&
+             readFloats(in, index.pyramid.levels[level], static_cast<size_t>(count) * levelDim);
+        index.pyramid.levelDim[level] = levelDim;
+      }
+      if (ok) {
+        index.pyramid.segments = segments;
+      } else {
+        std::println(stderr, "Warning: Ignoring corrupt pyramid section in {}", filename);
+        index.pyramid = HistogramPyramid();  // rebuilt in finalizeFeatureIndex
+        break;
+      }
+    } else if (std::memcmp(tag, kSimHashTag, 4) == 0) {
+      if (!readSimHash(in, count, index.simhash) || index.simhash.dim != dim) {
+        std::println(stderr, "Warning: Ignoring corrupt SimHash section in {}", filename);
+        index.simhash = SimHash();
+        break;
+      }
+    } else if (std::memcmp(tag, kVPTreeTag, 4) == 0) {
+      int32_t nodeCount = 0, root = -1;
+      bool ok = readValue(in, nodeCount) && readValue(in, root) && nodeCount == count &&
+                root >= 0 && root < nodeCount;
+      if (ok) {
+        index.vptree.nodes.resize(nodeCount);
+        ok = static_cast<bool>(in.read(reinterpret_cast<char*>(index.vptree.nodes.data()), sizeof(VPNode) * nodeCount));
+        index.vptree.root = root;
+      }
+      // the search indexes rows and nodes straight from these, children always come after their parent
+      for (int i = 0; ok && i < nodeCount; i++) {
+        const VPNode& node = index.vptree.nodes[i];
+        ok = node.row >= 0 && node.row < count && node.size > 0 &&
+             (node.inside == -1 || (node.inside > i && node.inside < nodeCount)) &&
+             (node.outside == -1 || (node.outside > i && node.outside < nodeCount));
+      }
+      if (!ok) {
+        std::println(stderr, "Warning: Ignoring corrupt VP-tree section in {}", filename);
+        index.vptree = VPTree();  // rebuilt in finalizeFeatureIndex
+        break;
+      }
+    } else if (std::memcmp(tag, kShardTag, 4) == 0) {
+      int32_t shardCount = 0, numIds = 0;
+      if (!readValue(in, shardCount) || !readValue(in, numIds) || shardCount <= 0 || numIds < 0 || numIds > shardCount) {
+        std::println(stderr, "Error: Corrupt shard section in {}", filename);
+        return -1;
+      }
+      index.shardCount = shardCount;
+      index.shardIds.resize(numIds);
+      for (int& id : index.shardIds) {
+        int32_t value = -1;
+        if (!readValue(in, value) || value < 0 || value >= shardCount) {
+          std::println(stderr, "Error: Corrupt shard section in {}", filename);
+          return -1;
+        }
+        id = value;
+      }
+    } else {
+      in.seekg(static_cast<std::streamoff>(length), std::ios::cur);  // unknown section, skip
+    }
+  }
+
+  finalizeFeatureIndex(index);
+  return 0;
+}
+
+
+// Row of an image by its filename (not full path), -1 if not in the index
+int findIndexRow(const FeatureIndex& index, const std::string& filename) {
+  auto it = index.nameLookup.find(filename);
+  return it == index.nameLookup.end() ? -1 : it->second;
+}
+
+// True if the path looks like an index file rather than an image directory
+bool isFeatureIndexFile(const std::string& path) {
+  return std::filesystem::is_regular_file(path) &&
+         std::filesystem::path(path).extension() == ".cbix";
+}
+
+size_t featureIndexMemoryBytes(const FeatureIndex& index) {
+  size_t bytes = index.features.size() * sizeof(std::vector<float>);
+  for (const auto& row : index.features) bytes += row.capacity() * sizeof(float);
+  for (const auto& path : index.paths) bytes += sizeof(std::string) + path.capacity();
+  bytes += index.nameLookup.size() * (sizeof(std::string) + sizeof(int) + 2 * sizeof(void*));
+  for (const auto& level : index.pyramid.levels) bytes += level.capacity() * sizeof(float);
+  bytes += index.simhash.planes.capacity() * sizeof(float) + index.simhash.mean.capacity() * sizeof(float);
+  bytes += index.simhash.signatures.capacity() * sizeof(uint64_t);
+  bytes += index.vptree.nodes.capacity() * sizeof(VPNode);
+  return bytes;
+}
+
+// One metric per type, registered on first use; the registry lookup is kept off the query path
+template <typename Metric>
+static Metric& perTypeMetric(FeatureType type, Metric& (*create)(const std::string&, const std::string&,
+                                                                 const std::string&),
+                             const char* name, const char* help) {
+  static Metric* metrics[FeatureTypeCount] = {};
+  static std::once_flag once;
+  std::call_once(once, [&]() {
+    for (int t = 0; t < FeatureTypeCount; t++) {
+      metrics[t] = &create(name, help, std::format("type=\"{}\"", featureTypeName(static_cast<FeatureType>(t))));
+    }
+  });
+  return *metrics[type];
+}
+
+MetricHistogram& queryDurationMetric(FeatureType type) {
+  return perTypeMetric(type, metricHistogram, "cbir_query_duration_seconds", "Query latency by feature type");
+}
+
+MetricCounter& queryFailuresMetric(FeatureType type) {
+  return perTypeMetric(type, metricCounter, "cbir_query_failures_total", "Queries that returned an error");
+}
+
+MetricGauge& indexMemoryMetric(FeatureType type) {
+  return perTypeMetric(type, metricGauge, "cbir_index_memory_bytes", "Approximate memory held by the loaded index");
+}
@@ -0,0 +1,294 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the buffered feature file writer and reader.
+*/
+
+#include "feature_writer.h"
+#include <print>  // for modern C++ printing (C++23)
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+static const char kFeatureMagic[4] = {'C', 'B', 'F', 'T'};
+static const uint32_t kFeatureFormatVersion = 1;
+
+FeatureFileFormat featureFileFormat(const std::string& filename) {
+  return std::filesystem::path(filename).extension() == ".cbft" ? FeatureFileBinary : FeatureFileCsv;
+}
+
+FeatureWriter::~FeatureWriter() {
+  if (!file_) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (tempFilename_.empty()) flushLocked();  // appended rows are already part of the file
+  std::fclose(file_);
+  file_ = nullptr;
+  std::error_code ec;
+  if (!tempFilename_.empty()) std::filesystem::remove(tempFilename_, ec);
+}
+
+/*
+  Start a feature file
+
+  Input:
+    filename - final name of the file
+    options - format, append/replace, ordering and buffering
+
+  Output:
+    int - 0 on success, -1 if the file cannot be created
+*/
+int FeatureWriter::open(const std::string& filename, const FeatureWriterOptions& options) {
+  if (file_ && close() != 0) return -1;
+  options_ = options;
+  filename_ = filename;
+  buffer_.clear();
+  buffer_.reserve(options_.bufferBytes);
+  early_.clear();
+  nextSequence_ = 0;
+  rows_ = 0;
+  failed_ = false;
+
+  bool emptyFile = true;
+  if (options_.append) {
+    std::error_code ec;
+    emptyFile = std::filesystem::file_size(filename, ec) == 0 || ec;
+    tempFilename_.clear();
+    file_ = std::fopen(filename.c_str(), "ab");
+  } else {
+    // unique per writer, two runs writing the same file do not share a temp file
+    tempFilename_ = filename + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()) ^
+                                                     reinterpret_cast<uintptr_t>(this));
+    file_ = std::fopen(tempFilename_.c_str(), "wb");
+  }
+  if (!file_) {
+    std::println(stderr, "Error: Unable to open feature file {} for writing", filename);
+    return -1;
+  }
+  std::setvbuf(file_, nullptr, _IONBF, 0);  // the writer buffers whole rows itself
+
+  // a binary file starts with its header, unless rows are appended to one that has it
+  if (options_.format == FeatureFileBinary && emptyFile) {
+    buffer_.append(kFeatureMagic, 4);
+    buffer_.append(reinterpret_cast<const char*>(&kFeatureFormatVersion), sizeof(kFeatureFormatVersion));
+  }
+  return 0;
+}
+
+// One row in the output format (done outside the lock, extraction threads format in parallel)
+void FeatureWriter::formatRow(const std::string& name, const std::vector<float>& features, std::string& row) const {
+  row.clear();
+  if (options_.format == FeatureFileBinary) {
+    uint32_t nameLength = static_cast<uint32_t>(name.size());
+    uint32_t count = static_cast<uint32_t>(features.size());
+    row.append(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
+    row.append(name);
+    row.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    row.append(reinterpret_cast<const char*>(features.data()), features.size() * sizeof(float));
+    return;
+  }
+
+  // ",%.4f" per value, the largest float has 39 digits before the point
+  row.resize(name.size() + features.size() * (48 + options_.precision) + 1);
+  char* out = row.data();
+  std::memcpy(out, name.data(), name.size());
+  out += name.size();
+  char* end = row.data() + row.size();
+  for (float value : features) {
+    *out++ = ',';
+    out = std::to_chars(out, end, value, std::chars_format::fixed, options_.precision).ptr;
+  }
+  *out++ = '\n';
+  row.resize(out - row.data());
+}
+
+int FeatureWriter::appendLocked(const std::string& row) {
+  buffer_ += row;
+  rows_++;
+  return buffer_.size() >= options_.bufferBytes ? flushLocked() : 0;
+}
+
+// Ordered rows whose turn has come
+void FeatureWriter::releaseReadyLocked() {
+  for (auto it = early_.begin(); it != early_.end() && it->first == nextSequence_; it = early_.erase(it)) {
+    if (!it->second.empty()) appendLocked(it->second);
+    nextSequence_++;
+  }
+}
+
+int FeatureWriter::flushLocked() {
+  if (!buffer_.empty() && !failed_) {
+    if (std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+      std::println(stderr, "Error: Failed writing feature file {}", filename_);
+      failed_ = true;
+    }
+  }
+  buffer_.clear();
+  return failed_ ? -1 : 0;
+}
+
+int FeatureWriter::write(const std::string& name, const std::vector<float>& features) {
+  std::string row;
+  formatRow(name, features, row);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_) return -1;
+  appendLocked(row);
+  return failed_ ? -1 : 0;
+}
+
+int FeatureWriter::write(size_t sequence, const std::string& name, const std::vector<float>& features) {
+  if (!options_.ordered) return write(name, features);
+  std::string row;
+  formatRow(name, features, row);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_) return -1;
+  if (sequence != nextSequence_) {
+    early_.emplace(sequence, std::move(row));
+    return failed_ ? -1 : 0;
+  }
+  appendLocked(row);
+  nextSequence_++;
+  releaseReadyLocked();
+  return failed_ ? -1 : 0;
+}
+
+void FeatureWriter::skip(size_t sequence) {
+  if (!options_.ordered) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (sequence != nextSequence_) {
+    early_.emplace(sequence, std::string());
+    return;
+  }
+  nextSequence_++;
+  releaseReadyLocked();
+}
+
+/*
+  Finish the file
+
+  Ordered rows still waiting for a missing sequence number are written in
+  sequence order. A replaced file is moved into place only if every write
+  succeeded.
+
+  Output:
+    int - 0 on success, -1 if a write, the close or the rename failed
+*/
+int FeatureWriter::close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_) return -1;
+  for (auto& entry : early_) {
+    if (!entry.second.empty()) appendLocked(entry.second);
+  }
+  early_.clear();
+  flushLocked();
+  if (std::fclose(file_) != 0) failed_ = true;
+  file_ = nullptr;
+  if (tempFilename_.empty()) return failed_ ? -1 : 0;
+
+  std::error_code ec;
+  if (!failed_) std::filesystem::rename(tempFilename_, filename_, ec);
+  if (failed_ || ec) {
+    std::println(stderr, "Error: Failed writing feature file {}", filename_);
+    std::filesystem::remove(tempFilename_, ec);
+    return -1;
+  }
+  return 0;
+}
+
+size_t FeatureWriter::rows() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rows_;
+}
+
+
+// Binary rows after the header, false if the file is cut short
+static bool parseBinaryRows(const std::vector<char>& bytes, std::vector<std::string>& names,
+                            std::vector<std::vector<float>>& data) {
+  size_t pos = 8;
+  auto take = [&](void* out, size_t n) {
+    if (bytes.size() - pos < n) return false;
+    std::memcpy(out, bytes.data() + pos, n);
+    pos += n;
+    return true;
+  };
+  while (pos < bytes.size()) {
+    uint32_t nameLength = 0, count = 0;
+    if (!take(&nameLength, sizeof(nameLength)) || bytes.size() - pos < nameLength) return false;
+    std::string name(bytes.data() + pos, nameLength);
+    pos += nameLength;
+    if (!take(&count, sizeof(count)) || (bytes.size() - pos) / sizeof(float) < count) return false;
+    std::vector<float> values(count);
+    take(values.data(), count * sizeof(float));
+    names.push_back(std::move(name));
+    data.push_back(std::move(values));
+  }
+  return true;
+}
+
+// "name,v1,v2,..." lines
+static void parseCsvRows(const std::vector<char>& bytes, std::vector<std::string>& names,
+                         std::vector<std::vector<float>>& data) {
+  const char* p = bytes.data();
+  const char* end = p + bytes.size();
+  while (p < end) {
+    const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (!lineEnd) lineEnd = end;
+    const char* field = static_cast<const char*>(std::memchr(p, ',', lineEnd - p));
+    if (!field) field = lineEnd;
+    std::string name(p, field);
+    if (!name.empty() && name.back() == '\r') name.pop_back();
+    if (!name.empty()) {
+      std::vector<float> values;
+      while (field < lineEnd) {
+        float value = 0.0f;
+        const char* start = field + 1;
+        while (start < lineEnd && *start == ' ') start++;
+        auto result = std::from_chars(start, lineEnd, value);
+        values.push_back(value);
+        field = static_cast<const char*>(std::memchr(result.ptr, ',', lineEnd - result.ptr));
+        if (!field) field = lineEnd;
+      }
+      names.push_back(std::move(name));
+      data.push_back(std::move(values));
+    }
+    p = lineEnd + 1;
+  }
+}
+
+/*
+  Read a feature file written by FeatureWriter (or append_image_data_csv)
+
+  Input:
+    filename - CSV or binary (.cbft) feature file, the format is taken from its first bytes
+    names - output, first column of every row
+    data - output, feature values of every row
+
+  Output:
+    int - 0 on success, -1 if the file cannot be read or a binary file is cut short
+*/
+int readFeatureFile(const std::string& filename, std::vector<std::string>& names,
+                    std::vector<std::vector<float>>& data) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) {
+    std::println(stderr, "Error: Unable to open feature file {}", filename);
+    return -1;
+  }
+  std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  uint32_t version = 0;
+  if (bytes.size() >= 8 && std::memcmp(bytes.data(), kFeatureMagic, 4) == 0) {
+    std::memcpy(&version, bytes.data() + 4, sizeof(version));
+    if (version != kFeatureFormatVersion || !parseBinaryRows(bytes, names, data)) {
+      std::println(stderr, "Error: {} is not a valid feature file", filename);
+      return -1;
+    }
+    return 0;
+  }
+  parseCsvRows(bytes, names, data);
+  return 0;
+}
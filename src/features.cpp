@@ -11,7 +11,124 @@
 #include <iostream>
 #include <print>  // for modern C++ printing (C++23)
 #include "csv_util/csv_util.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <filesystem>
+#include <format>
+
+
+/*
+  Scratch buffers
+
+  A buffer only grows, so once it has held the largest image of a run the
+  Mats made from it are plain headers over memory that is already there,
+  and OpenCV functions writing into them find the size and type already
+  right and do not reallocate.
+*/
+cv::Mat ScratchBuffer::mat(int rows, int cols, int type) {
+  size_t bytes = static_cast<size_t>(rows) * cols * CV_ELEM_SIZE(type);
+  if (bytes_.size() < bytes) bytes_.resize(bytes);
+  return cv::Mat(rows, cols, type, bytes_.data());
+}
+
+FeatureScratch& threadFeatureScratch() {
+  thread_local FeatureScratch scratch;
+  return scratch;
+}
+
+
+bool parsePixelSamplingOption(int argc, char* argv[], int& i, PixelSampling& sampling) {
+  std::string arg = argv[i];
+  if (arg == "--sample-stride" && i + 1 < argc) {
+    sampling.stride = std::max(1, std::atoi(argv[++i]));
+    sampling.mode = sampling.stride > 1 ? SampleStride : SampleAll;
+    return true;
+  }
+  if (arg == "--sample-count" && i + 1 < argc) {
+    sampling.targetSamples = std::max(0, std::atoi(argv[++i]));
+    sampling.mode = sampling.targetSamples > 0 ? SampleStratified : SampleAll;
+    return true;
+  }
+  return false;
+}
+
+std::string pixelSamplingName(const PixelSampling& sampling) {
+  switch (sampling.mode) {
+    case SampleStride:     return std::format("stride/{}", sampling.stride);
+    case SampleStratified: return std::format("stratified/{}", sampling.targetSamples);
+    default:               return "all";
+  }
+}
+
+// Pseudo-random 32 bits for a grid cell (murmur3 finalizer)
+static uint32_t hashCell(uint32_t seed, uint32_t cell) {
+  uint32_t h = seed ^ (cell * 0x9E3779B9u);
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35u;
+  h ^= h >> 16;
+  return h;
+}
+
+/*
+  Call visit(pixel) for the sampled pixels of a BGR image
+
+  Input:
+    src - 8-bit 3-channel image (or ROI)
+    sampling - which pixels to visit
+    visit - called with each sampled cv::Vec3b
+
+  Output:
+    float - pixels represented by one sample (1 when every pixel is visited),
+            the histogram counts are multiplied by it
+*/
+template <typename Visit>
+static float forEachSampledPixel(const cv::Mat& src, const PixelSampling& sampling, Visit&& visit) {
+  double pixels = static_cast<double>(src.rows) * src.cols;
+
+  if (sampling.mode == SampleStride && sampling.stride > 1) {
+    int stride = sampling.stride;
+    double samples = 0;
+    for (int y = 0; y < src.rows; y += stride) {
+      const cv::Vec3b* rowPtr = src.ptr<cv::Vec3b>(y);
+      for (int x = 0; x < src.cols; x += stride) visit(rowPtr[x]);
+      samples += (src.cols + stride - 1) / stride;
+    }
+    return samples > 0 ? static_cast<float>(pixels / samples) : 1.0f;
+  }
+
+  if (sampling.mode == SampleStratified && sampling.targetSamples > 0 && sampling.targetSamples < pixels) {
+    // square cells of about pixels / targetSamples pixels, one pick in each (clipped at the right and bottom edges)
+    int cell = std::max(1, static_cast<int>(std::lround(std::sqrt(pixels / sampling.targetSamples))));
+    double samples = 0;
+    uint32_t cellId = 0;
+    for (int y0 = 0; y0 < src.rows; y0 += cell) {
+      int height = std::min(cell, src.rows - y0);
+      for (int x0 = 0; x0 < src.cols; x0 += cell, cellId++) {
+        int width = std::min(cell, src.cols - x0);
+        uint32_t h = hashCell(sampling.seed, cellId);
+        visit(src.ptr<cv::Vec3b>(y0 + static_cast<int>((h & 0xFFFF) % height))[x0 + static_cast<int>((h >> 16) % width)]);
+        samples++;
+      }
+    }
+    return static_cast<float>(pixels / samples);
+  }
+
+  for (int y = 0; y < src.rows; y++) {
+    const cv::Vec3b* rowPtr = src.ptr<cv::Vec3b>(y);  // pointer to row y
+    for (int x = 0; x < src.cols; x++) visit(rowPtr[x]);
+  }
+  return 1.0f;
+}
+
+// Scale sampled counts back to the pixel count of the full image
+static void scaleHistogram(float* histogram, int bins, float weight) {
+  if (weight == 1.0f) return;
+  for (int i = 0; i < bins; i++) histogram[i] *= weight;
+}
 
 
 /*
@@ -24,6 +141,7 @@
     features - output feature vector (std::vector<float>) (list of 7*7*3 = 147 values)
 */
 int extractBaselineFeatures(const cv::Mat& src, std::vector<float>& features) {
+  CBIR_TRACE_SCOPE("extract/baseline");
   // Edge case: image too small
   if (src.rows < 7 || src.cols < 7) {
     std::println(stderr, "Error: Image too small for baseline feature extraction");
@@ -66,55 +184,45 @@ int extractBaselineFeatures(const cv::Mat& src, std::vector<float>& features) {
     src - input image (cv::Mat), using const to prevent modifying src img (safety)
     features - output histogram as flattened vector (bins * bins values)
     bins - number of bins for each dimension (default 16 bins)
+    sampling - pixels counted (every pixel by default)
 */
-int extractRGChromHistogram(const cv::Mat& src, std::vector<float>& features, int bins) {
+int extractRGChromHistogram(const cv::Mat& src, std::vector<float>& features, int bins,
+                            const PixelSampling& sampling) {
+  CBIR_TRACE_SCOPE("extract/rghistogram");
   // Edge case: empty image
   if (src.empty()) {
     std::println(stderr, "Error: Empty image for histogram extraction");
     return -1;
   }
 
-  // Create 2D histogram (bins x bins) initialized to zero
-  cv::Mat histogram = cv::Mat::zeros(bins, bins, CV_32F);
+  // 2D histogram (bins x bins) counted straight into the flattened feature vector (raw counts)
+  // normalization is done during histogram intersection
+  features.assign(bins * bins, 0.0f);  // reuses the caller's row, no allocation once it has the capacity
+  float* histogram = features.data();
 
-  // Iterate through all pixels using row pointers for efficiency
-  for (int i = 0; i < src.rows; i++) {
-    const cv::Vec3b* rowPtr = src.ptr<cv::Vec3b>(i);  // pointer to row i
-    for (int j = 0; j < src.cols; j++) {
-      // get the RGB values
-      float B = rowPtr[j][0];
-      float G = rowPtr[j][1];
-      float R = rowPtr[j][2];
+  // Iterate through the (sampled) pixels, row pointers for efficiency
+  float weight = forEachSampledPixel(src, sampling, [&](const cv::Vec3b& pixel) {
+    // get the RGB values
+    float B = pixel[0];
+    float G = pixel[1];
+    float R = pixel[2];
 
-      // compute divisor, handle black pixels
-      float divisor = R + G + B;
-      divisor = divisor > 0.0f ? divisor : 1.0f; // avoid divide by zero
+    // compute divisor, handle black pixels
+    float divisor = R + G + B;
+    divisor = divisor > 0.0f ? divisor : 1.0f; // avoid divide by zero
 
-      // compute rg chromaticity
-      float r = R / divisor; // r and g are in [0, 1] range
-      float g = G / divisor;
+    // compute rg chromaticity
+    float r = R / divisor; // r and g are in [0, 1] range
+    float g = G / divisor;
 
-      // compute bin indices with proper rounding (+0.5)
-      int rIndex = static_cast<int>(r * (bins - 1) + 0.5f);
-      int gIndex = static_cast<int>(g * (bins - 1) + 0.5f);
+    // compute bin indices with proper rounding (+0.5)
+    int rIndex = static_cast<int>(r * (bins - 1) + 0.5f);
+    int gIndex = static_cast<int>(g * (bins - 1) + 0.5f);
 
-      // increment histogram bin
-      histogram.at<float>(rIndex, gIndex) += 1.0f;
-    }
-  }
-
-  // Flatten 2D histogram to 1D feature vector (raw counts)
-  // normalization is done during histogram intersection
-  features.clear(); // clear the features vector before writing
-  features.reserve(bins * bins); // reserve space to avoid multiple reallocations
-  
-  // loop through histogram and push values to features vector
-  for (int i = 0; i < bins; i++) { // r bin
-    const float* histRowPtr = histogram.ptr<float>(i);
-    for (int j = 0; j < bins; j++) { // g bin
-      features.push_back(histRowPtr[j]); // push count for the (r, g) bin
-    }
-  }
+    // increment histogram bin (row r, column g of the flattened histogram)
+    histogram[rIndex * bins + gIndex] += 1.0f;
+  });
+  scaleHistogram(histogram, bins * bins, weight);
 
   return 0;
 }
@@ -134,58 +242,48 @@ int extractRGChromHistogram(const cv::Mat& src, std::vector<float>& features, in
     src - input image (cv::Mat), using const to prevent modifying src img (safety)
     features - output histogram as flattened vector (bins * bins values)
     bins - number of bins for each dimension (default 16 bins)
+    sampling - pixels counted (every pixel by default)
 */
-int extractRGBChromHistogram(const cv::Mat& src, std::vector<float>& features, int bins) {
+int extractRGBChromHistogram(const cv::Mat& src, std::vector<float>& features, int bins,
+                             const PixelSampling& sampling) {
+  CBIR_TRACE_SCOPE("extract/rgbhistogram");
   // Edge case: empty image
   if (src.empty()) {
     std::println(stderr, "Error: Empty image for histogram extraction");
     return -1;
   }
 
-  // Create 3D histogram (bins x bins x bins) initialized to zero
-  cv::Mat histogram = cv::Mat::zeros(bins, bins * bins, CV_32F); // using 2D Mat to store 3D histogram
-
-  // Iterate through all pixels using row pointers for efficiency
-  for (int i = 0; i < src.rows; i++) {
-    const cv::Vec3b* rowPtr = src.ptr<cv::Vec3b>(i);  // pointer to row i
-    for (int j = 0; j < src.cols; j++) {
-      // get the RGB values
-      float B = rowPtr[j][0];
-      float G = rowPtr[j][1];
-      float R = rowPtr[j][2];
-
-      // compute divisor, handle black pixels
-      float divisor = R + G + B;
-      divisor = divisor > 0.0f ? divisor : 1.0f; // avoid divide by zero
-
-      // compute rgb chromaticity
-      float r = R / divisor; // r, g, b are in [0, 1] range
-      float g = G / divisor;
-      float b = 1.0f - (r + g);  // r + g + b = 1
-
-      // compute bin indices with proper rounding (+0.5)
-      int rIndex = static_cast<int>(r * (bins - 1) + 0.5f);
-      int gIndex = static_cast<int>(g * (bins - 1) + 0.5f);
-      int bIndex = static_cast<int>(b * (bins - 1) + 0.5f);
-
-      // increment histogram bin
-      // Mat is bins rows x (bins*bins) cols, so row = rIndex, col = gIndex*bins+bIndex
-      histogram.at<float>(rIndex, gIndex * bins + bIndex) += 1.0f;
-    }
-  }
-
-  // Flatten 2D histogram to 1D feature vector (raw counts)
+  // 3D histogram (bins x bins x bins) counted straight into the flattened feature vector (raw counts)
   // normalization is done during histogram intersection
-  features.clear(); // clear the features vector before writing
-  features.reserve(bins * bins * bins); // reserve space to avoid multiple reallocations
-
-  // loop through histogram and push values to features vector
-  for (int i = 0; i < bins; i++) { // r bin (rows)
-    const float* histRowPtr = histogram.ptr<float>(i);
-    for (int j = 0; j < bins * bins; j++) { // g*bins+b (cols)
-      features.push_back(histRowPtr[j]);
-    }
-  }
+  features.assign(bins * bins * bins, 0.0f);  // reuses the caller's row, no allocation once it has the capacity
+  float* histogram = features.data();
+
+  // Iterate through the (sampled) pixels, row pointers for efficiency
+  float weight = forEachSampledPixel(src, sampling, [&](const cv::Vec3b& pixel) {
+    // get the RGB values
+    float B = pixel[0];
+    float G = pixel[1];
+    float R = pixel[2];
+
+    // compute divisor, handle black pixels
+    float divisor = R + G + B;
+    divisor = divisor > 0.0f ? divisor : 1.0f; // avoid divide by zero
+
+    // compute rgb chromaticity
+    float r = R / divisor; // r, g, b are in [0, 1] range
+    float g = G / divisor;
+    float b = 1.0f - (r + g);  // r + g + b = 1
+
+    // compute bin indices with proper rounding (+0.5)
+    int rIndex = static_cast<int>(r * (bins - 1) + 0.5f);
+    int gIndex = static_cast<int>(g * (bins - 1) + 0.5f);
+    int bIndex = static_cast<int>(b * (bins - 1) + 0.5f);
+
+    // increment histogram bin
+    // flattened as bins rows x (bins*bins) cols, so row = rIndex, col = gIndex*bins+bIndex
+    histogram[rIndex * bins * bins + gIndex * bins + bIndex] += 1.0f;
+  });
+  scaleHistogram(histogram, bins * bins * bins, weight);
 
   return 0;
 }
@@ -198,15 +296,16 @@ int extractRGBChromHistogram(const cv::Mat& src, std::vector<float>& features, i
   This captures color distribution plus some spatial info
   
   512 bins per half (8*8*8), 1024 total
+  sampling picks the pixels counted in each half (every pixel by default)
 */
-int extractMultiHistogram(const cv::Mat& src, std::vector<float>& features) {
+int extractMultiHistogram(const cv::Mat& src, std::vector<float>& features, const PixelSampling& sampling) {
+  CBIR_TRACE_SCOPE("extract/multihistogram");
 
   // check if image is empty
   if (src.empty()) return -1;
 
-  features.clear(); // clear out old features
-  
   int bins = 8; // using 8 bins per color channel
+  features.assign(2 * 512, 0.0f); // both halves counted in place, top first
 
   // split image into top and bottom halves
   int midRow = src.rows / 2;
@@ -217,30 +316,30 @@ int extractMultiHistogram(const cv::Mat& src, std::vector<float>& features) {
   cv::Mat halves[] = {top, bottom};
   
   for (int h = 0; h < 2; h++) {
-    std::vector<float> hist(512, 0); // 8x8x8 = 512 bins
-    
-    // go through every pixel
-    for (int y = 0; y < halves[h].rows; y++) {
-      for (int x = 0; x < halves[h].cols; x++) {
-        cv::Vec3b pixel = halves[h].at<cv::Vec3b>(y, x);
-
-        int r = pixel[2] * bins / 256; 
-        int g = pixel[1] * bins / 256; 
-        int b = pixel[0] * bins / 256; 
-
-        if (r >= bins) r = bins - 1;
-        if (g >= bins) g = bins - 1;
-        if (b >= bins) b = bins - 1;
-
-        int idx = r * 64 + g * 8 + b;  
-        hist[idx]++; 
-      }
-    }
-    
-    // add this histogram to our feature vector
-    for (int i = 0; i < 512; i++) {
-      features.push_back(hist[i]);
+    float* hist = features.data() + h * 512; // 8x8x8 = 512 bins
+
+    // a sample count is for the whole image, each half gets its share of it
+    PixelSampling halfSampling = sampling;
+    if (sampling.mode == SampleStratified && sampling.targetSamples > 0) {
+      double share = static_cast<double>(halves[h].rows) / std::max(1, src.rows);
+      halfSampling.targetSamples = std::max(1, static_cast<int>(std::lround(sampling.targetSamples * share)));
+      halfSampling.seed = sampling.seed + h;
     }
+
+    // go through every (sampled) pixel
+    float weight = forEachSampledPixel(halves[h], halfSampling, [&](const cv::Vec3b& pixel) {
+      int r = pixel[2] * bins / 256; 
+      int g = pixel[1] * bins / 256; 
+      int b = pixel[0] * bins / 256; 
+
+      if (r >= bins) r = bins - 1;
+      if (g >= bins) g = bins - 1;
+      if (b >= bins) b = bins - 1;
+
+      int idx = r * 64 + g * 8 + b;  
+      hist[idx]++; 
+    });
+    scaleHistogram(hist, 512, weight);
   }
   
   return 0;
@@ -254,30 +353,35 @@ int extractMultiHistogram(const cv::Mat& src, std::vector<float>& features) {
   Texture: 16 bins for gradient magnitudes (0-255 range)
   Color: 8 bins per RGB channel = 8*8*8 = 512 bins
   Total 528 features
+  sampling picks the pixels of the color histogram (the texture part uses every pixel)
 */
-int extractTextureAndColor(const cv::Mat& src, std::vector<float>& features) {
+int extractTextureAndColor(const cv::Mat& src, std::vector<float>& features, const PixelSampling& sampling) {
+  CBIR_TRACE_SCOPE("extract/textureandcolor");
   if (src.empty()) return -1;
-  features.clear();
+  features.assign(16 + 512, 0.0f);  // texture bins first, then color
+  FeatureScratch& scratch = threadFeatureScratch();
   
   // Get texture features from edge detection
-  // convert to grayscale
-  cv::Mat gray;
+  // convert to grayscale (every intermediate lives in this thread's scratch buffers)
+  cv::Mat gray = scratch.gray.mat(src.rows, src.cols, CV_8U);
   cv::cvtColor(src, gray, cv::COLOR_BGR2GRAY);
   
   // run Sobel in both x and y directions
-  cv::Mat sobelX, sobelY;
+  cv::Mat sobelX = scratch.sobelX.mat(src.rows, src.cols, CV_16S);
+  cv::Mat sobelY = scratch.sobelY.mat(src.rows, src.cols, CV_16S);
   cv::Sobel(gray, sobelX, CV_16S, 1, 0);
   cv::Sobel(gray, sobelY, CV_16S, 0, 1);
   
   // combine the x and y gradients to get magnitude
-  cv::Mat magnitude;
-  cv::Mat absX, absY;
+  cv::Mat magnitude = scratch.magnitude.mat(src.rows, src.cols, CV_8U);
+  cv::Mat absX = scratch.absX.mat(src.rows, src.cols, CV_8U);
+  cv::Mat absY = scratch.absY.mat(src.rows, src.cols, CV_8U);
   cv::convertScaleAbs(sobelX, absX);
   cv::convertScaleAbs(sobelY, absY);
   cv::addWeighted(absX, 0.5, absY, 0.5, 0, magnitude);
   
   // make a histogram of the edge strengths (16 bins)
-  std::vector<float> texHist(16, 0);
+  float* texHist = features.data();
   for (int y = 0; y < magnitude.rows; y++) {
     for (int x = 0; x < magnitude.cols; x++) {
       int val = magnitude.at<uchar>(y, x);
@@ -287,30 +391,18 @@ int extractTextureAndColor(const cv::Mat& src, std::vector<float>& features) {
     }
   }
   
-  // put texture histogram into features vector
-  for (int i = 0; i < 16; i++) {
-    features.push_back(texHist[i]);
-  }
-  
-  // get color features with RGB histogram
-  std::vector<float> colorHist(512, 0);
-  for (int y = 0; y < src.rows; y++) {
-    for (int x = 0; x < src.cols; x++) {
-      cv::Vec3b pixel = src.at<cv::Vec3b>(y, x);
-      int r = pixel[2] * 8 / 256;  // convert to bin index
-      int g = pixel[1] * 8 / 256;
-      int b = pixel[0] * 8 / 256;
-      if (r >= 8) r = 7; 
-      if (g >= 8) g = 7;
-      if (b >= 8) b = 7;
-      colorHist[r * 64 + g * 8 + b]++;  
-    }
-  }
-  
-  // add color histogram after the texture features
-  for (int i = 0; i < 512; i++) {
-    features.push_back(colorHist[i]);
-  }
+  // get color features with RGB histogram, after the texture features
+  float* colorHist = features.data() + 16;
+  float weight = forEachSampledPixel(src, sampling, [&](const cv::Vec3b& pixel) {
+    int r = pixel[2] * 8 / 256;  // convert to bin index
+    int g = pixel[1] * 8 / 256;
+    int b = pixel[0] * 8 / 256;
+    if (r >= 8) r = 7; 
+    if (g >= 8) g = 7;
+    if (b >= 8) b = 7;
+    colorHist[r * 64 + g * 8 + b]++;  
+  });
+  scaleHistogram(colorHist, 512, weight);
   
   return 0;
 }
@@ -324,21 +416,23 @@ int extractTextureAndColor(const cv::Mat& src, std::vector<float>& features) {
   529 total: 512 DNN (from CSV) + 16 skin bins + 1 brightness
 */
 int extractCustomFeaturesWithEmbedding(const cv::Mat& src, const std::vector<float>& embedding, std::vector<float>& features) {
-  features.clear();
+  CBIR_TRACE_SCOPE("extract/customdesign");
+  FeatureScratch& scratch = threadFeatureScratch();
   
-  // add DNN embedding first
-  features.insert(features.end(), embedding.begin(), embedding.end());
+  // add DNN embedding first, the skin histogram follows it
+  features.assign(embedding.begin(), embedding.end());
+  features.resize(embedding.size() + 16, 0.0f);
   
   // work with center region
   int cx = src.cols / 2, cy = src.rows / 2;
   int size = std::min(cx, cy) / 2;
   cv::Mat centerImg = src(cv::Rect(cx - size, cy - size, size * 2, size * 2));
   
-  cv::Mat hsv;
+  cv::Mat hsv = scratch.hsv.mat(centerImg.rows, centerImg.cols, CV_8UC3);
   cv::cvtColor(centerImg, hsv, cv::COLOR_BGR2HSV);
   
   // build skin tone histogram 
-  std::vector<float> skinHist(16, 0);
+  float* skinHist = features.data() + embedding.size();
   for (int y = 0; y < hsv.rows; y++) {
     for (int x = 0; x < hsv.cols; x++) {
       cv::Vec3b p = hsv.at<cv::Vec3b>(y, x);
@@ -347,10 +441,9 @@ int extractCustomFeaturesWithEmbedding(const cv::Mat& src, const std::vector<flo
       }
     }
   }
-  features.insert(features.end(), skinHist.begin(), skinHist.end());
   
   // add brightness
-  cv::Mat gray;
+  cv::Mat gray = scratch.gray.mat(centerImg.rows, centerImg.cols, CV_8U);
   cv::cvtColor(centerImg, gray, cv::COLOR_BGR2GRAY);
   features.push_back(cv::mean(gray)[0]);
   
@@ -366,18 +459,21 @@ int extractCustomFeaturesWithEmbedding(const cv::Mat& src, const std::vector<flo
 
 */
 int extractOrientedGradientHistogram(const cv::Mat& src, std::vector<float>& features) {
+  CBIR_TRACE_SCOPE("extract/orientedgradient");
   if (src.empty()) return -1;
-  features.clear();
+  FeatureScratch& scratch = threadFeatureScratch();
   
-  cv::Mat gray;
+  cv::Mat gray = scratch.gray.mat(src.rows, src.cols, CV_8U);
   cv::cvtColor(src, gray, cv::COLOR_BGR2GRAY);
   
-  cv::Mat sobelX, sobelY;
+  cv::Mat sobelX = scratch.sobelX.mat(src.rows, src.cols, CV_16S);
+  cv::Mat sobelY = scratch.sobelY.mat(src.rows, src.cols, CV_16S);
   cv::Sobel(gray, sobelX, CV_16S, 1, 0);
   cv::Sobel(gray, sobelY, CV_16S, 0, 1);
   
   const int NUM_BINS = 8;
-  std::vector<float> hist(NUM_BINS, 0);
+  features.assign(NUM_BINS, 0.0f);
+  float* hist = features.data();
   
   for (int y = 0; y < gray.rows; y++) {
     for (int x = 0; x < gray.cols; x++) {
@@ -398,7 +494,5 @@ int extractOrientedGradientHistogram(const cv::Mat& src, std::vector<float>& fea
     }
   }
   
-  features.insert(features.end(), hist.begin(), hist.end());
-  
   return 0;
 }
\ No newline at end of file
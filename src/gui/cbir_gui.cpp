@@ -13,6 +13,17 @@
 #include <print>
 #include <filesystem>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_set>
 #include <opencv2/opencv.hpp>
 
 #include "imgui.h"
@@ -43,47 +54,112 @@
 #include "features.h"
 #include "distance.h"
 #include "csv_util.h"
+#include "feature_index.h"  // FeatureType and the feature/distance dispatch
+#include "index_search.h"
+#include "result_cache.h"
+#include "thread_pool.h"
+#include "streaming_topk.h"
+#include "image_reader.h"
+#include "image_pack.h"
+#include "image_enumerator.h"
+#include "trace.h"
+#include "metrics.h"
 
 // ============================================================================
 // Types and State
 // ============================================================================
 
-enum FeatureType {
-  Baseline, RGChromHistogram, RGBChromHistogram, MultiHistogram,
-  TextureAndColor, DNNEmbedding, CustomDesign, FeatureTypeCount
-};
-
 const char* featureTypeNames[] = {
   "Baseline (7x7 center block)", "RG Chromaticity Histogram",
   "RGB Chromaticity Histogram", "Multi-Histogram",
-  "Texture + Color", "DNN Embedding", "Custom Design"
+  "Texture + Color", "DNN Embedding", "Custom Design",
+  "Oriented Gradient Histogram"
 };
+static_assert(sizeof(featureTypeNames) / sizeof(featureTypeNames[0]) == FeatureTypeCount);
 
 struct SearchResult {
   std::string filepath, filename;
   float distance;
+};
+
+// Thumbnails: longest side on disk and on the GPU, disk and GPU memory budgets, uploads per frame
+static const int kThumbnailSize = 512;
+static const uintmax_t kThumbnailDiskBudgetBytes = 512ULL * 1024 * 1024;
+static const size_t kTextureBudgetBytes = 64 * 1024 * 1024;
+static const size_t kUploadBytesPerFrame = 2 * 1024 * 1024;
+static const int kThumbnailThreads = 2;
+
+// How often a running scan publishes its best matches so far
+static const std::chrono::milliseconds kStreamInterval(100);
+
+// Feature matrices kept for the session, one per (database, feature type)
+static const size_t kFeatureCacheEntries = 8;
+
+struct Thumbnail {
   GLuint textureId = 0;
   int width = 0, height = 0;
 };
 
+// Embeddings read from a CSV file, shared read-only with the search worker
+struct EmbeddingTable {
+  std::string csvPath;
+  std::vector<std::vector<float>> embeddings;
+  std::unordered_map<std::string, int> lookup;  // filename -> row
+};
+
+// Progress of one search, written by the worker and read by the render thread every frame
+struct SearchProgress {
+  std::atomic<int> scanned{0};
+  std::atomic<int> total{0};            // 0 until the directory has been listed
+  std::atomic<bool> cancelled{false};   // set by Cancel or by a newer search
+  std::atomic<bool> finished{false};    // set when a background precompute is done
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+};
+
+// Everything a search needs, copied so the worker never reads AppState
+struct SearchJob {
+  uint64_t id = 0;
+  FeatureType type = Baseline;
+  std::string queryPath, queryFilename, databaseDir, csvPath;
+  int k = 4;
+  std::shared_ptr<const EmbeddingTable> embeddings;  // may be missing or for another CSV
+  ResultCache* resultCache = nullptr;
+  std::shared_ptr<SearchProgress> progress;
+  std::shared_ptr<StreamingTopK> stream;  // best matches so far, k + 1 for the self-match
+};
+
+// Finished search handed back to the render thread
+struct SearchOutcome {
+  uint64_t id = 0;
+  bool ok = false, cached = false;
+  std::string message;
+  CachedResults matches;                             // best first, self-match removed
+  std::shared_ptr<const EmbeddingTable> embeddings;  // table the search used (loaded if it was missing)
+};
+
 struct AppState {
   char queryImagePath[512] = "";
   char imageDatabaseDir[512] = "data/olympus";
   char csvFilePath[512] = "data/ResNet18_olym.csv";
   int selectedFeatureType = 0;
 
-  cv::Mat queryImage;
-  GLuint queryTextureId = 0;
-  int queryWidth = 0, queryHeight = 0;
-
   bool isSearching = false, hasResults = false;
   std::vector<SearchResult> results;
   int numResultsToShow = 4;
 
-  std::vector<char*> csvFilenames;
-  std::vector<std::vector<float>> csvEmbeddings;
-  std::unordered_map<std::string, int> csvLookupIndex;
-  bool embeddingsLoaded = false;
+  uint64_t searchId = 0;                         // id of the latest search, older outcomes are dropped
+  std::shared_ptr<SearchProgress> activeSearch;  // progress of the running search
+  std::shared_ptr<StreamingTopK> activeStream;   // its best matches so far
+  uint64_t streamVersion = 0;                    // snapshot the results were built from
+  int searchK = 4;                               // result count of the running search
+  bool resultsComplete = false;                  // results are final (not a partial scan)
+
+  std::shared_ptr<const EmbeddingTable> embeddings;
+
+  std::shared_ptr<SearchProgress> precompute;  // features of the selected type being prepared in the background
+  FeatureType precomputeType = Baseline;
+
+  ResultCache resultCache;  // repeated searches of the same query skip the directory scan
 
   std::string statusMessage = "Ready. Drag & drop an image or click Browse.";
   float dpiScale = 1.0f;
@@ -116,17 +192,10 @@ std::string truncatePathMiddle(const std::string& fullPath, float maxWidth) {
   return prefix + ellipsis + filename;
 }
 
-bool isImageFile(const std::filesystem::path& path) {
-  std::string ext = path.extension().string();
-  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-  return ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".ppm" || ext == ".tif" || ext == ".bmp";
-}
-
-GLuint matToTexture(const cv::Mat& mat, int& outWidth, int& outHeight) {
-  if (mat.empty()) return 0;
-
-  cv::Mat rgb;
-  cv::cvtColor(mat, rgb, cv::COLOR_BGR2RGB);
+// Upload an RGB image (rows of any width) as a texture
+GLuint matToTexture(const cv::Mat& rgb, int& outWidth, int& outHeight) {
+  if (rgb.empty()) return 0;
+  CBIR_TRACE_SCOPE("texture upload");
 
   GLuint textureId;
   glGenTextures(1, &textureId);
@@ -135,6 +204,7 @@ GLuint matToTexture(const cv::Mat& mat, int& outWidth, int& outHeight) {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // RGB rows are not padded to 4 bytes
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, rgb.cols, rgb.rows, 0, GL_RGB, GL_UNSIGNED_BYTE, rgb.data);
 
   outWidth = rgb.cols;
@@ -146,50 +216,53 @@ void freeTexture(GLuint& textureId) {
   if (textureId != 0) { glDeleteTextures(1, &textureId); textureId = 0; }
 }
 
-std::vector<float> getEmbedding(const std::string& filename) {
-  auto it = g_app.csvLookupIndex.find(filename);
-  return (it != g_app.csvLookupIndex.end()) ? g_app.csvEmbeddings[it->second] : std::vector<float>{};
+std::vector<float> getEmbedding(const EmbeddingTable* table, const std::string& filename) {
+  if (!table) return {};
+  auto it = table->lookup.find(filename);
+  return (it != table->lookup.end()) ? table->embeddings[it->second] : std::vector<float>{};
 }
 
-// Load a query image from path, updating texture and state
+// Set the query image, its preview comes from the thumbnail cache and the search decodes it
 void loadQueryImage(const std::string& path) {
   strncpy(g_app.queryImagePath, path.c_str(), sizeof(g_app.queryImagePath) - 1);
-  freeTexture(g_app.queryTextureId);
-  g_app.queryImage = cv::imread(path);
-  if (!g_app.queryImage.empty())
-    g_app.queryTextureId = matToTexture(g_app.queryImage, g_app.queryWidth, g_app.queryHeight);
 }
 
-// Extract features for any feature type (returns 0 on success)
-int extractFeatures(FeatureType type, const cv::Mat& image, std::vector<float>& features,
-                    const std::string& filename = "") {
-  switch (type) {
-    case RGChromHistogram:  return extractRGChromHistogram(image, features, 16);
-    case RGBChromHistogram: return extractRGBChromHistogram(image, features, 8);
-    case MultiHistogram:    return extractMultiHistogram(image, features);
-    case TextureAndColor:   return extractTextureAndColor(image, features);
-    case DNNEmbedding:
-      features = getEmbedding(filename);
-      return features.empty() ? -1 : 0;
-    case CustomDesign: {
-      auto emb = getEmbedding(filename);
-      return emb.empty() ? -1 : extractCustomFeaturesWithEmbedding(image, emb, features);
-    }
-    default: return extractBaselineFeatures(image, features);
-  }
+// Extract features for an image file, looking up its embedding by filename when needed (returns 0 on success)
+int extractImageFeatures(FeatureType type, const cv::Mat& image, std::vector<float>& features,
+                         const EmbeddingTable* embeddings = nullptr, const std::string& filename = "") {
+  std::vector<float> embedding;
+  if (featureTypeNeedsEmbedding(type)) embedding = getEmbedding(embeddings, filename);
+  return extractFeatures(type, image, embedding, features);
 }
 
-// Compute distance between two feature vectors
-float computeDistance(FeatureType type, const std::vector<float>& a, const std::vector<float>& b) {
-  switch (type) {
-    case RGChromHistogram:
-    case RGBChromHistogram: return histogramIntersectionDistance(a, b);
-    case MultiHistogram:    return multiHistogramDistance(a, b);
-    case TextureAndColor:   return textureAndColorDistance(a, b);
-    case DNNEmbedding:      return cosineDistance(a, b);
-    case CustomDesign:      return customDistance(a, b);
-    default:                return sumOfSquaredDifference(a, b);
+// Version of the database a search runs against: a hash of every image's path, size and mtime
+// (from the enumerator, so a rewritten file deep in a subdirectory counts too), of the
+// .cbix or .cbpk file itself for an index or a pack, and of the embedding CSV when the type uses one
+uint64_t databaseVersion(FeatureType type, const std::string& databaseDir, const std::string& csvPath) {
+  uint64_t version = 14695981039346656037ULL;  // FNV-1a over the fields
+  auto mix = [&version](uint64_t value) { version = (version ^ value) * 1099511628211ULL; };
+  auto mixFile = [&mix](const std::string& path) {
+    std::error_code ec;
+    auto time = std::filesystem::last_write_time(path, ec);
+    uint64_t size = std::filesystem::file_size(path, ec);
+    mix(std::hash<std::string>{}(path));
+    mix(ec ? 0 : size);
+    mix(ec ? 0 : static_cast<uint64_t>(time.time_since_epoch().count()));
+  };
+
+  std::vector<ImageRecord> images;
+  if (isFeatureIndexFile(databaseDir) || isImagePackFile(databaseDir)) {
+    mixFile(databaseDir);  // an append rewrites the pack, its size and mtime change
+  } else if (enumerateImages(databaseDir, images) == 0) {
+    mix(std::hash<std::string>{}(databaseDir));
+    for (const ImageRecord& image : images) {
+      mix(std::hash<std::string>{}(image.path));
+      mix(image.size);
+      mix(static_cast<uint64_t>(image.mtime));
+    }
   }
+  if (featureTypeNeedsEmbedding(type)) mixFile(csvPath);
+  return version;
 }
 
 // Render two lines of centered gray text in the available region
@@ -204,6 +277,212 @@ void renderCenteredText(const char* line1, const char* line2) {
   ImGui::TextColored(gray, "%s", line2);
 }
 
+// ============================================================================
+// Thumbnail Cache
+// ============================================================================
+
+/*
+  Downscaled textures for the query preview and the result grid
+
+  Images are decoded and resized on worker threads, and the downscaled JPEG
+  is kept on disk (keyed by path, mtime and size) so the next session skips
+  the full decode. A disk hit touches the file's mtime, and at startup the
+  least recently used files are deleted down to kThumbnailDiskBudgetBytes
+  (stale keys of edited images age out the same way). The render thread uploads at most kUploadBytesPerFrame
+  of textures per frame and keeps them in an LRU under kTextureBudgetBytes;
+  textures drawn in the last frame are never evicted.
+*/
+class ThumbnailCache {
+public:
+  explicit ThumbnailCache(const std::filesystem::path& diskDir) : diskDir_(diskDir), pool_(kThumbnailThreads) {
+    std::error_code ec;
+    std::filesystem::create_directories(diskDir_, ec);
+    pool_.submit([this] { pruneDisk(); });  // off the render thread, the directory can be large
+  }
+
+  ~ThumbnailCache() { stopping_ = true; }  // queued decodes return early, the pool joins first
+
+  // Texture for an image if it is uploaded, otherwise queue its decode and return nullptr (render thread)
+  const Thumbnail* get(const std::string& path) {
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+      it->second.lastFrame = frame_;
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      return &it->second.thumb;
+    }
+    if (!path.empty() && !failed_.count(path) && pending_.insert(path).second) {
+      pool_.submit([this, path] { decode(path); });
+    }
+    return nullptr;
+  }
+
+  bool hasFailed(const std::string& path) const { return failed_.count(path) > 0; }
+
+  // Upload decoded thumbnails within the frame budget, then trim to the memory budget (render thread)
+  void update() {
+    frame_++;
+    std::vector<Decoded> batch;
+    {
+      std::lock_guard<std::mutex> lock(readyMutex_);
+      size_t bytes = 0;
+      while (!ready_.empty() && (batch.empty() || bytes < kUploadBytesPerFrame)) {
+        bytes += ready_.front().rgb.total() * ready_.front().rgb.elemSize();
+        batch.push_back(std::move(ready_.front()));
+        ready_.pop_front();
+      }
+    }
+
+    for (auto& decoded : batch) {
+      pending_.erase(decoded.path);
+      if (decoded.rgb.empty()) { failed_.insert(decoded.path); continue; }
+      Entry& entry = entries_[decoded.path];
+      entry.thumb.textureId = matToTexture(decoded.rgb, entry.thumb.width, entry.thumb.height);
+      entry.bytes = decoded.rgb.total() * decoded.rgb.elemSize();
+      entry.lastFrame = frame_;
+      entry.lru = lru_.insert(lru_.begin(), decoded.path);
+      bytes_ += entry.bytes;
+    }
+
+    while (bytes_ > kTextureBudgetBytes && !lru_.empty()) {
+      auto victim = entries_.find(lru_.back());
+      if (victim->second.lastFrame + 1 >= frame_) break;  // everything left is on screen
+      bytes_ -= victim->second.bytes;
+      freeTexture(victim->second.thumb.textureId);
+      entries_.erase(victim);
+      lru_.pop_back();
+    }
+  }
+
+  // Free every texture (render thread, before the GL context goes away)
+  void releaseAll() {
+    for (auto& [path, entry] : entries_) freeTexture(entry.thumb.textureId);
+    entries_.clear();
+    lru_.clear();
+    bytes_ = 0;
+  }
+
+private:
+  struct Entry {
+    Thumbnail thumb;
+    size_t bytes = 0;
+    uint64_t lastFrame = 0;
+    std::list<std::string>::iterator lru;
+  };
+
+  struct Decoded {
+    std::string path;
+    cv::Mat rgb;  // empty if the image could not be read
+  };
+
+  // Disk cache file for the current version of an image (FNV-1a of path, mtime and size,
+  // of the pack file for an image inside a pack)
+  std::filesystem::path diskPath(const std::string& path) const {
+    std::string packFile, entryName, statPath = path;
+    if (splitPackPath(path, packFile, entryName)) statPath = packFile;
+    std::error_code ec;
+    uint64_t mtime = static_cast<uint64_t>(std::filesystem::last_write_time(statPath, ec).time_since_epoch().count());
+    uint64_t size = std::filesystem::file_size(statPath, ec);
+    uint64_t hash = 1469598103934665603ULL;
+    auto mix = [&](const void* data, size_t length) {
+      for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<const unsigned char*>(data)[i];
+        hash *= 1099511628211ULL;
+      }
+    };
+    mix(path.data(), path.size());
+    mix(&mtime, sizeof(mtime));
+    mix(&size, sizeof(size));
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.jpg", static_cast<unsigned long long>(hash));
+    return diskDir_ / name;
+  }
+
+  // Worker thread: delete the least recently used files (by mtime) until the directory fits the budget
+  void pruneDisk() {
+    struct DiskFile {
+      std::filesystem::file_time_type used;
+      uintmax_t size;
+      std::filesystem::path path;
+    };
+    std::vector<DiskFile> files;
+    uintmax_t total = 0;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(diskDir_, ec), end; !ec && it != end; it.increment(ec)) {
+      std::error_code statError;
+      if (!it->is_regular_file(statError)) continue;
+      DiskFile file{it->last_write_time(statError), it->file_size(statError), it->path()};
+      if (statError) continue;
+      total += file.size;
+      files.push_back(std::move(file));
+    }
+    if (total <= kThumbnailDiskBudgetBytes) return;
+
+    std::sort(files.begin(), files.end(), [](const DiskFile& a, const DiskFile& b) { return a.used < b.used; });
+    uintmax_t removed = 0;
+    int count = 0;
+    for (const DiskFile& file : files) {
+      if (total <= kThumbnailDiskBudgetBytes || stopping_) break;
+      std::error_code removeError;
+      if (!std::filesystem::remove(file.path, removeError)) continue;
+      total -= file.size;
+      removed += file.size;
+      count++;
+    }
+    std::println("Thumbnail cache: removed {} files ({:.1f} MB) over the {} MB budget", count,
+                 removed / (1024.0 * 1024.0), kThumbnailDiskBudgetBytes / (1024 * 1024));
+  }
+
+  // Worker thread: disk cache hit, or full decode + resize + write back
+  void decode(const std::string& path) {
+    Decoded decoded;
+    decoded.path = path;
+    if (!stopping_) {
+      std::filesystem::path cached = diskPath(path);
+      cv::Mat thumb = cv::imread(cached.string());
+      if (!thumb.empty()) {
+        std::error_code ec;  // mtime is the last use, for pruneDisk
+        std::filesystem::last_write_time(cached, std::filesystem::file_time_type::clock::now(), ec);
+      } else {
+        cv::Mat image = readImage(path);
+        if (!image.empty()) {
+          double scale = static_cast<double>(kThumbnailSize) / std::max(image.cols, image.rows);
+          if (scale < 1.0) cv::resize(image, thumb, cv::Size(), scale, scale, cv::INTER_AREA);
+          else thumb = image;
+
+          // write then rename, so a half written file is never read back
+          std::filesystem::path partial = cached;
+          partial.replace_extension(".part.jpg");
+          std::error_code ec;
+          if (cv::imwrite(partial.string(), thumb, {cv::IMWRITE_JPEG_QUALITY, 85})) {
+            std::filesystem::rename(partial, cached, ec);
+          }
+        }
+      }
+      if (!thumb.empty()) cv::cvtColor(thumb, decoded.rgb, cv::COLOR_BGR2RGB);
+    }
+    std::lock_guard<std::mutex> lock(readyMutex_);
+    ready_.push_back(std::move(decoded));
+  }
+
+  std::filesystem::path diskDir_;
+
+  // render thread only
+  std::unordered_map<std::string, Entry> entries_;
+  std::list<std::string> lru_;  // most recently drawn first
+  std::unordered_set<std::string> pending_, failed_;
+  uint64_t frame_ = 0;
+  size_t bytes_ = 0;
+
+  // shared with the workers
+  std::mutex readyMutex_;
+  std::deque<Decoded> ready_;
+  std::atomic<bool> stopping_{false};
+
+  ThreadPool pool_;  // declared last: joined before the members its tasks use are destroyed
+};
+
+static std::unique_ptr<ThumbnailCache> g_thumbnails;
+
 // ============================================================================
 // File Dialogs (Windows Native)
 // ============================================================================
@@ -259,68 +538,535 @@ void errorCallback(int error, const char* description) {
 // CBIR Search
 // ============================================================================
 
-void performSearch() {
-  if (g_app.queryImage.empty()) { g_app.statusMessage = "Error: No query image loaded"; return; }
-  if (!std::filesystem::exists(g_app.imageDatabaseDir)) { g_app.statusMessage = "Error: Image database directory not found"; return; }
+// Load the embedding CSV into a table (returns nullptr on failure)
+std::shared_ptr<const EmbeddingTable> loadEmbeddingTable(const std::string& csvPath) {
+  auto table = std::make_shared<EmbeddingTable>();
+  std::vector<char*> filenames;
+  table->csvPath = csvPath;
+  if (read_image_data_csv(const_cast<char*>(csvPath.c_str()), filenames, table->embeddings, 0) != 0) return nullptr;
+  for (size_t i = 0; i < filenames.size(); i++) {
+    table->lookup[filenames[i]] = static_cast<int>(i);
+    delete[] filenames[i];
+  }
+  return table;
+}
 
-  g_app.isSearching = true;
-  g_app.statusMessage = "Searching...";
-  for (auto& r : g_app.results) freeTexture(r.textureId);
-  g_app.results.clear();
+// Best k of a sorted list, skipping the self-match (query image with distance ~0)
+CachedResults topMatches(const std::vector<std::pair<float, std::string>>& sorted, int k) {
+  int startIdx = (!sorted.empty() && sorted[0].first < 1e-4f) ? 1 : 0;
+  int n = std::max(0, std::min(k, static_cast<int>(sorted.size()) - startIdx));
+  return CachedResults(sorted.begin() + startIdx, sorted.begin() + startIdx + n);
+}
+
+/*
+  Session feature cache
+
+  Features of every database image, per (database, feature type), kept
+  after the first scan so later searches only extract the query features.
+  Each entry remembers the databaseVersion it was built for and is dropped
+  once any image in the directory (or the CSV) changes. Used by the worker threads only.
+*/
+class SessionFeatureCache {
+public:
+  // Matrix for the database and type if it is still current, nullptr otherwise
+  std::shared_ptr<const FeatureIndex> find(const std::string& database, FeatureType type, uint64_t version) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (it->database != database || it->type != type) continue;
+      if (it->version != version) {
+        entries_.erase(it);
+        return nullptr;
+      }
+      entries_.splice(entries_.begin(), entries_, it);  // most recently used first
+      return it->matrix;
+    }
+    return nullptr;
+  }
+
+  void insert(const std::string& database, FeatureType type, uint64_t version,
+              std::shared_ptr<const FeatureIndex> matrix) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.remove_if([&](const Entry& e) { return e.database == database && e.type == type; });
+    entries_.push_front({database, type, version, std::move(matrix)});
+    if (entries_.size() > kFeatureCacheEntries) entries_.pop_back();
+
+    // memory of every cached matrix of each type, after the eviction
+    int64_t bytes[FeatureTypeCount] = {};
+    for (const Entry& e : entries_) bytes[e.type] += static_cast<int64_t>(featureIndexMemoryBytes(*e.matrix));
+    for (int t = 0; t < FeatureTypeCount; t++) indexMemoryMetric(static_cast<FeatureType>(t)).set(bytes[t]);
+  }
+
+private:
+  struct Entry {
+    std::string database;
+    FeatureType type;
+    uint64_t version;
+    std::shared_ptr<const FeatureIndex> matrix;
+  };
+
+  std::mutex mutex_;
+  std::list<Entry> entries_;
+};
+
+static SessionFeatureCache g_featureCache;
+
+// Features of a .cbix database, loaded once from disk (nullptr and a message on failure)
+std::shared_ptr<const FeatureIndex> loadDatabaseIndex(FeatureType type, const std::string& indexFile,
+                                                      std::string& message) {
+  auto index = std::make_shared<FeatureIndex>();
+  if (loadFeatureIndex(indexFile, *index) != 0) {
+    message = "Error: Failed to load the feature index";
+    return nullptr;
+  }
+  if (index->type != type) {
+    message = std::string("Error: The index holds ") + featureTypeNames[index->type] + " features";
+    return nullptr;
+  }
+  return index;
+}
+
+/*
+  Extract the features of every image in a database directory
+
+  Lists the directory first so progress has a total (an image pack has
+  its table), then decodes and extracts one image at a time in path order
+  while the next files are read ahead, stopping as soon as
+  progress.cancelled is set. onRow sees every row as soon as it is extracted, so a search can
+  score the database while its matrix is being built.
+
+  Input:
+    type - feature type
+    databaseDir - image database directory or image pack
+    embeddings - DNN embeddings (only for the types that need them)
+    progress - scanned/total are updated, cancelled is checked
+    onRow - called with the path and features of each row (may be empty)
+  Output:
+    matrix - rows sorted by path, same order as sorting {distance, path} pairs
+    int - 0 on success, -1 if cancelled or the directory could not be read
+*/
+int scanDatabaseFeatures(FeatureType type, const std::string& databaseDir, const EmbeddingTable* embeddings,
+                         SearchProgress& progress, FeatureIndex& matrix,
+                         const std::function<void(const std::string&, const std::vector<float>&)>& onRow) {
+  // an image pack is read from its mapping, a directory is listed first
+  std::unique_ptr<ImageReader> reader;
+  if (isImagePackFile(databaseDir)) {
+    std::shared_ptr<const ImagePack> pack = openImagePack(databaseDir);
+    if (!pack) return -1;
+    progress.total = pack->size();
+    reader = std::make_unique<ImageReader>(pack);
+  } else {
+    std::vector<std::string> files;  // nested directories too, validated against the manifest of the last scan
+    if (enumerateImages(databaseDir, files) != 0 || progress.cancelled) return -1;
+    progress.total = static_cast<int>(files.size());
+    reader = std::make_unique<ImageReader>(std::move(files));
+  }
+
+  std::vector<std::pair<std::string, std::vector<float>>> rows;
+  ImageFile file;
+  while (reader->next(file)) {
+    if (progress.cancelled) return -1;
+    cv::Mat image = decodeImageFile(file);
+    progress.scanned++;
+    if (image.empty()) continue;
+
+    std::vector<float> features;
+    std::string filename = std::filesystem::path(file.path).filename().string();
+    if (extractImageFeatures(type, image, features, embeddings, filename) != 0) continue;
+    if (onRow) onRow(file.path, features);
+    rows.emplace_back(file.path, std::move(features));
+  }
 
-  auto type = static_cast<FeatureType>(g_app.selectedFeatureType);
+  matrix = FeatureIndex();  // rows arrived in path order
+  matrix.type = type;
+  for (auto& row : rows) {
+    matrix.dim = static_cast<int>(row.second.size());
+    matrix.paths.push_back(std::move(row.first));
+    matrix.features.push_back(std::move(row.second));
+  }
+  finalizeFeatureIndex(matrix);  // pyramid / VP-tree so cached searches skip most rows
+  return 0;
+}
+
+/*
+  Run one search on the worker thread
+
+  Same steps the render thread used to run: embeddings, query features,
+  result cache, then the database. Once the database features are in the
+  session cache only the query is extracted; otherwise the directory scan
+  keeps the best k + 1 matches, publishes them to job.stream every
+  kStreamInterval, stops as soon as the search is cancelled or preempted,
+  and leaves the extracted rows in the cache.
+
+  Output:
+    bool - false if the search was cancelled (nothing to hand back)
+*/
+bool runSearch(const SearchJob& job, SearchOutcome& outcome) {
+  auto started = std::chrono::steady_clock::now();
+  SearchProgress& progress = *job.progress;
+  outcome.id = job.id;
 
   // Load DNN embeddings if needed
-  if ((type == DNNEmbedding || type == CustomDesign) && !g_app.embeddingsLoaded) {
-    const char* csv = (type == DNNEmbedding) ? g_app.csvFilePath : "data/ResNet18_olym.csv";
-    if (read_image_data_csv(const_cast<char*>(csv), g_app.csvFilenames, g_app.csvEmbeddings, 0) != 0) {
-      g_app.statusMessage = "Error: Failed to load CSV embeddings";
-      g_app.isSearching = false;
-      return;
+  outcome.embeddings = job.embeddings;
+  if (featureTypeNeedsEmbedding(job.type) && (!outcome.embeddings || outcome.embeddings->csvPath != job.csvPath)) {
+    outcome.embeddings = loadEmbeddingTable(job.csvPath);
+    if (!outcome.embeddings) {
+      outcome.message = "Error: Failed to load CSV embeddings";
+      return true;
     }
-    for (size_t i = 0; i < g_app.csvFilenames.size(); i++)
-      g_app.csvLookupIndex[g_app.csvFilenames[i]] = static_cast<int>(i);
-    g_app.embeddingsLoaded = true;
   }
+  const EmbeddingTable* embeddings = outcome.embeddings.get();
 
   // Extract query features
   std::vector<float> queryFeatures;
-  std::string queryFilename = std::filesystem::path(g_app.queryImagePath).filename().string();
-  if (extractFeatures(type, g_app.queryImage, queryFeatures, queryFilename) != 0) {
-    g_app.statusMessage = "Error: Failed to extract query features";
-    g_app.isSearching = false;
-    return;
-  }
-
-  // Scan database and compute distances
-  std::vector<std::pair<float, std::string>> distances;
-  for (const auto& entry : std::filesystem::directory_iterator(g_app.imageDatabaseDir)) {
-    if (!entry.is_regular_file() || !isImageFile(entry.path())) continue;
-    cv::Mat image = cv::imread(entry.path().string());
-    if (image.empty()) continue;
+  cv::Mat queryImage = readImage(job.queryPath);
+  if (queryImage.empty()) {
+    outcome.message = "Error: Failed to load query image";
+    return true;
+  }
+  if (extractImageFeatures(job.type, queryImage, queryFeatures, embeddings, job.queryFilename) != 0) {
+    outcome.message = "Error: Failed to extract query features";
+    return true;
+  }
 
-    std::vector<float> features;
-    if (extractFeatures(type, image, features, entry.path().filename().string()) != 0) continue;
-    distances.push_back({computeDistance(type, queryFeatures, features), entry.path().string()});
+  // Same query, feature type, result count and database: reuse the last results
+  uint64_t version = databaseVersion(job.type, job.databaseDir, job.csvPath);
+  ResultCacheKey cacheKey;
+  cacheKey.featureHash = hashQueryFeatures(queryFeatures);
+  cacheKey.type = job.type;
+  cacheKey.k = job.k;
+  cacheKey.indexVersion = version;
+  job.resultCache->setIndexVersion(job.type, cacheKey.indexVersion);  // drops results of an older directory state
+
+  if (job.resultCache->lookup(cacheKey, queryFeatures, outcome.matches)) {
+    ResultCacheStats cacheStats = job.resultCache->stats();
+    outcome.ok = outcome.cached = true;
+    outcome.message = "Cached: showing top " + std::to_string(outcome.matches.size()) + " (" +
+      std::to_string(cacheStats.hits) + " hits, " + std::to_string(cacheStats.misses) + " misses).";
+    queryDurationMetric(job.type).observe(std::chrono::steady_clock::now() - started);
+    return true;
+  }
+
+  // Database features from this session (or a .cbix index): only the query was extracted
+  StreamingTopK& best = *job.stream;
+  std::shared_ptr<const FeatureIndex> matrix = g_featureCache.find(job.databaseDir, job.type, version);
+  if (!matrix && isFeatureIndexFile(job.databaseDir)) {
+    matrix = loadDatabaseIndex(job.type, job.databaseDir, outcome.message);
+    if (!matrix) return true;
+    g_featureCache.insert(job.databaseDir, job.type, version, matrix);
+  }
+
+  int scored = 0;
+  if (matrix) {
+    progress.total = progress.scanned = matrix->size();
+    std::vector<IndexMatch> matches;
+    if (matrix->size() > 0 && searchIndex(*matrix, queryFeatures, job.k + 1, SearchOptions(), matches) != 0) {
+      outcome.message = "Error: Query features do not match the database features";
+      return true;
+    }
+    for (const auto& match : matches) best.offer(match.distance, matrix->paths[match.row]);
+    scored = matrix->size();
+  } else {
+    // First search of this database and type: score every image as it is extracted, the
+    // render thread sees the best matches as they improve, and keep the rows for next time
+    auto built = std::make_shared<FeatureIndex>();
+    auto scoreRow = [&](const std::string& path, const std::vector<float>& features) {
+      CBIR_TRACE_SCOPE("distance");
+      best.offer(computeDistance(job.type, queryFeatures, features), path);
+      best.publishEvery(kStreamInterval, progress.scanned, progress.total);
+    };
+    if (scanDatabaseFeatures(job.type, job.databaseDir, embeddings, progress, *built, scoreRow) != 0) {
+      if (progress.cancelled) return false;
+      outcome.message = "Error: Failed to read the image database directory";
+      return true;
+    }
+    scored = built->size();
+    built->version = version;
+    g_featureCache.insert(job.databaseDir, job.type, version, std::move(built));
+  }
+  best.publish(progress.scanned, progress.total, true);
+
+  // Keep the top k, skipping the self-match
+  std::shared_ptr<const TopKSnapshot> finalTopK = best.snapshot();
+  outcome.matches = topMatches(finalTopK->entries, job.k);
+  job.resultCache->insert(cacheKey, queryFeatures, outcome.matches);
+
+  bool selfMatch = !finalTopK->entries.empty() && finalTopK->entries[0].first < 1e-4f;
+  int found = scored - (selfMatch ? 1 : 0);
+  outcome.ok = true;
+  queryDurationMetric(job.type).observe(std::chrono::steady_clock::now() - started);
+  outcome.message = "Found " + std::to_string(found) + " images. Showing top " + std::to_string(outcome.matches.size()) + ".";
+  return true;
+}
+
+/*
+  Search worker thread
+
+  Jobs come in through a one-slot mailbox: submitting a search cancels the
+  running one and replaces any that has not started yet. Finished searches
+  go back through a single atomic pointer the render thread swaps out once
+  per frame, so neither side ever waits on the other.
+*/
+class SearchWorker {
+public:
+  ~SearchWorker() { stop(); }
+
+  void submit(SearchJob job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) running_->cancelled = true;
+    if (pending_) pending_->progress->cancelled = true;
+    pending_ = std::move(job);
+    if (!thread_.joinable()) thread_ = std::thread(&SearchWorker::run, this);
+    wake_.notify_one();
   }
 
-  // Sort and build results, skipping the self-match (query image with distance ~0)
-  std::sort(distances.begin(), distances.end());
-  int startIdx = (!distances.empty() && distances[0].first < 1e-4f) ? 1 : 0;
-  int n = std::min(g_app.numResultsToShow, static_cast<int>(distances.size()) - startIdx);
-  for (int i = 0; i < n; i++) {
+  // Latest finished search or nullptr, the caller owns it
+  std::unique_ptr<SearchOutcome> takeOutcome() {
+    return std::unique_ptr<SearchOutcome>(outcome_.exchange(nullptr, std::memory_order_acquire));
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+      if (running_) running_->cancelled = true;
+      wake_.notify_one();
+    }
+    if (thread_.joinable()) thread_.join();
+    delete outcome_.exchange(nullptr);
+  }
+
+private:
+  void run() {
+    for (;;) {
+      SearchJob job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [&] { return stopping_ || pending_.has_value(); });
+        if (stopping_) return;
+        job = std::move(*pending_);
+        pending_.reset();
+        running_ = job.progress;
+      }
+
+      auto outcome = std::make_unique<SearchOutcome>();
+      if (runSearch(job, *outcome)) {
+        delete outcome_.exchange(outcome.release(), std::memory_order_release);  // an unclaimed older outcome is stale
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_.reset();
+    }
+  }
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::optional<SearchJob> pending_;
+  std::shared_ptr<SearchProgress> running_;
+  bool stopping_ = false;
+  std::atomic<SearchOutcome*> outcome_{nullptr};
+};
+
+static SearchWorker g_searchWorker;
+
+// Features of one database and type to prepare before they are searched
+struct PrecomputeJob {
+  FeatureType type = Baseline;
+  std::string databaseDir, csvPath;
+  std::shared_ptr<const EmbeddingTable> embeddings;  // may be missing or for another CSV
+  std::shared_ptr<SearchProgress> progress;
+};
+
+/*
+  Feature precompute thread
+
+  Fills the session feature cache for the feature type the user just
+  picked, so the first search of that type only extracts the query.
+  Same one-slot mailbox as the search worker: a newer request replaces
+  the pending one and cancels the running one.
+*/
+class FeaturePrecomputer {
+public:
+  ~FeaturePrecomputer() { stop(); }
+
+  void submit(PrecomputeJob job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) running_->progress->cancelled = true;
+    if (pending_) pending_->progress->cancelled = true;
+    pending_ = std::move(job);
+    if (!thread_.joinable()) thread_ = std::thread(&FeaturePrecomputer::run, this);
+    wake_.notify_one();
+  }
+
+  // Stop preparing this database and type (a search is about to scan it anyway)
+  void cancel(const std::string& databaseDir, FeatureType type) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const std::optional<PrecomputeJob>* job : {&running_, &pending_}) {
+      if (*job && (*job)->databaseDir == databaseDir && (*job)->type == type) (*job)->progress->cancelled = true;
+    }
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+      if (running_) running_->progress->cancelled = true;
+      wake_.notify_one();
+    }
+    if (thread_.joinable()) thread_.join();
+  }
+
+private:
+  void run() {
+    for (;;) {
+      PrecomputeJob job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [&] { return stopping_ || pending_.has_value(); });
+        if (stopping_) return;
+        job = std::move(*pending_);
+        pending_.reset();
+        running_ = job;
+      }
+
+      precompute(job);
+      job.progress->finished = true;
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_.reset();
+    }
+  }
+
+  static void precompute(const PrecomputeJob& job) {
+    uint64_t version = databaseVersion(job.type, job.databaseDir, job.csvPath);
+    if (g_featureCache.find(job.databaseDir, job.type, version)) return;
+
+    std::string message;
+    if (isFeatureIndexFile(job.databaseDir)) {
+      std::shared_ptr<const FeatureIndex> index = loadDatabaseIndex(job.type, job.databaseDir, message);
+      if (index) g_featureCache.insert(job.databaseDir, job.type, version, std::move(index));
+      return;  // a bad index is reported by the search
+    }
+
+    std::shared_ptr<const EmbeddingTable> embeddings = job.embeddings;
+    if (featureTypeNeedsEmbedding(job.type) && (!embeddings || embeddings->csvPath != job.csvPath)) {
+      embeddings = loadEmbeddingTable(job.csvPath);
+      if (!embeddings) return;
+    }
+    auto matrix = std::make_shared<FeatureIndex>();
+    if (scanDatabaseFeatures(job.type, job.databaseDir, embeddings.get(), *job.progress, *matrix, nullptr) != 0) return;
+    matrix->version = version;
+    g_featureCache.insert(job.databaseDir, job.type, version, std::move(matrix));
+  }
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::optional<PrecomputeJob> pending_, running_;
+  bool stopping_ = false;
+};
+
+static FeaturePrecomputer g_precomputer;
+
+// Start a search in the background, preempting the one that is running
+void performSearch() {
+  if (g_app.queryImagePath[0] == '\0') { g_app.statusMessage = "Error: No query image loaded"; return; }
+  if (!std::filesystem::exists(g_app.imageDatabaseDir)) { g_app.statusMessage = "Error: Image database directory not found"; return; }
+
+  g_app.isSearching = true;
+  g_app.statusMessage = "Searching...";
+  g_app.results.clear();
+  g_app.hasResults = false;
+  g_app.resultsComplete = false;
+
+  SearchJob job;
+  job.id = ++g_app.searchId;
+  job.type = static_cast<FeatureType>(g_app.selectedFeatureType);
+  job.queryPath = g_app.queryImagePath;
+  job.queryFilename = std::filesystem::path(g_app.queryImagePath).filename().string();
+  job.databaseDir = g_app.imageDatabaseDir;
+  job.csvPath = (job.type == DNNEmbedding) ? g_app.csvFilePath : "data/ResNet18_olym.csv";
+  job.k = g_app.numResultsToShow;
+  g_precomputer.cancel(job.databaseDir, job.type);  // the search extracts (and caches) the same features
+  job.embeddings = g_app.embeddings;
+  job.resultCache = &g_app.resultCache;
+  job.progress = std::make_shared<SearchProgress>();
+  job.stream = std::make_shared<StreamingTopK>(job.k + 1);
+  g_app.activeSearch = job.progress;
+  g_app.activeStream = job.stream;
+  g_app.streamVersion = 0;
+  g_app.searchK = job.k;
+  g_searchWorker.submit(std::move(job));
+}
+
+// Prepare the features of the selected type in the background (after the type or database changed)
+void startPrecompute() {
+  if (!std::filesystem::exists(g_app.imageDatabaseDir)) return;
+  PrecomputeJob job;
+  job.type = static_cast<FeatureType>(g_app.selectedFeatureType);
+  job.databaseDir = g_app.imageDatabaseDir;
+  job.csvPath = (job.type == DNNEmbedding) ? g_app.csvFilePath : "data/ResNet18_olym.csv";
+  job.embeddings = g_app.embeddings;
+  job.progress = std::make_shared<SearchProgress>();
+  g_app.precompute = job.progress;
+  g_app.precomputeType = job.type;
+  g_precomputer.submit(std::move(job));
+}
+
+void cancelSearch() {
+  if (!g_app.activeSearch) return;
+  g_app.activeSearch->cancelled = true;
+  g_app.activeSearch.reset();
+  g_app.activeStream.reset();  // the partial results stay on screen
+  g_app.searchId++;  // anything still on its way back is stale
+  g_app.isSearching = false;
+  g_app.statusMessage = "Search cancelled.";
+}
+
+// Replace the shown results (k entries, their thumbnails stay in the cache)
+void showMatches(const CachedResults& matches) {
+  g_app.results.clear();
+  for (const auto& match : matches) {
     SearchResult r;
-    r.filepath = distances[startIdx + i].second;
+    r.filepath = match.second;
     r.filename = std::filesystem::path(r.filepath).filename().string();
-    r.distance = distances[startIdx + i].first;
-    cv::Mat img = cv::imread(r.filepath);
-    if (!img.empty()) r.textureId = matToTexture(img, r.width, r.height);
+    r.distance = match.first;
     g_app.results.push_back(r);
   }
+}
+
+// Pick up the scan's progress and a finished search (once per frame),
+// thumbnails are requested when the grid draws them
+void pollSearch() {
+  std::unique_ptr<SearchOutcome> outcome = g_searchWorker.takeOutcome();
+  if (outcome && outcome->id != g_app.searchId) outcome.reset();
+  if (g_app.precompute && g_app.precompute->finished) g_app.precompute.reset();
+
+  // best matches so far, only copied when the scan has published something new
+  if (g_app.activeStream && g_app.activeStream->version() != g_app.streamVersion) {
+    std::shared_ptr<const TopKSnapshot> snapshot = g_app.activeStream->snapshot();
+    g_app.streamVersion = snapshot->version;
+    showMatches(topMatches(snapshot->entries, g_app.searchK));
+    g_app.hasResults = !g_app.results.empty();
+  }
+  if (!outcome) return;
 
-  g_app.hasResults = true;
+  if (outcome->embeddings) g_app.embeddings = outcome->embeddings;
+  if (outcome->ok) showMatches(outcome->matches);  // also covers result cache hits
+  g_app.hasResults = outcome->ok;
+  g_app.resultsComplete = outcome->ok;
   g_app.isSearching = false;
-  g_app.statusMessage = "Found " + std::to_string(distances.size() - startIdx) + " images. Showing top " + std::to_string(n) + ".";
+  g_app.activeSearch.reset();
+  g_app.activeStream.reset();
+  g_app.statusMessage = outcome->message;
+}
+
+// "1234 / 5000  (850 img/s)" for the progress bar
+std::string searchProgressText(const SearchProgress& progress) {
+  int total = progress.total, scanned = progress.scanned;
+  if (total == 0) return "Listing files...";
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - progress.started).count();
+  char text[64];
+  snprintf(text, sizeof(text), "%d / %d  (%.0f img/s)", scanned, total, seconds > 0.0 ? scanned / seconds : 0.0);
+  return text;
 }
 
 // ============================================================================
@@ -336,9 +1082,10 @@ void renderLeftPanel(float totalHeight) {
     controlsHeight += 40.0f * g_app.dpiScale;
 
   // Query image or placeholder
-  if (g_app.queryTextureId != 0) {
+  const Thumbnail* queryThumb = g_thumbnails->get(g_app.queryImagePath);
+  if (queryThumb) {
     float availWidth = ImGui::GetContentRegionAvail().x;
-    float aspectRatio = static_cast<float>(g_app.queryWidth) / g_app.queryHeight;
+    float aspectRatio = static_cast<float>(queryThumb->width) / queryThumb->height;
     float displayWidth = availWidth;
     float displayHeight = displayWidth / aspectRatio;
     float maxHeight = totalHeight - controlsHeight - ImGui::GetCursorPosY();
@@ -346,14 +1093,19 @@ void renderLeftPanel(float totalHeight) {
       displayHeight = maxHeight;
       displayWidth = displayHeight * aspectRatio;
     }
-    ImGui::Image((ImTextureID)(intptr_t)g_app.queryTextureId, ImVec2(displayWidth, displayHeight));
+    ImGui::Image((ImTextureID)(intptr_t)queryThumb->textureId, ImVec2(displayWidth, displayHeight));
     ImGui::TextColored(ImVec4(0.5f, 0.7f, 1.0f, 1.0f), "%s",
       std::filesystem::path(g_app.queryImagePath).filename().string().c_str());
   } else {
     float placeholderHeight = totalHeight - controlsHeight - ImGui::GetCursorPosY();
     if (placeholderHeight > 100.0f) {
       ImGui::BeginChild("ImagePlaceholder", ImVec2(-1, placeholderHeight), true);
-      renderCenteredText("Drag & drop an image here", "or use Browse button below");
+      if (g_app.queryImagePath[0] == '\0')
+        renderCenteredText("Drag & drop an image here", "or use Browse button below");
+      else if (g_thumbnails->hasFailed(g_app.queryImagePath))
+        renderCenteredText("Could not read this image", "drop or browse another one");
+      else
+        renderCenteredText("Loading preview...", std::filesystem::path(g_app.queryImagePath).filename().string().c_str());
       ImGui::EndChild();
     }
   }
@@ -400,8 +1152,10 @@ void renderLeftPanel(float totalHeight) {
   ImGui::SameLine();
   if (ImGui::Button("Set Directory##db", ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
     std::string path = openFolderDialog();
-    if (!path.empty())
+    if (!path.empty()) {
       strncpy(g_app.imageDatabaseDir, path.c_str(), sizeof(g_app.imageDatabaseDir) - 1);
+      startPrecompute();
+    }
   }
 
   // CSV file for DNN embedding
@@ -416,7 +1170,7 @@ void renderLeftPanel(float totalHeight) {
   ImGui::Text("Feature Type:");
   ImGui::SetNextItemWidth(-1);
   if (ImGui::Combo("##featuretype", &g_app.selectedFeatureType, featureTypeNames, FeatureTypeCount))
-    g_app.embeddingsLoaded = false;
+    startPrecompute();
 
   // Results slider
   ImGui::Spacing();
@@ -431,8 +1185,25 @@ void renderLeftPanel(float totalHeight) {
   if (remaining > 0) ImGui::Dummy(ImVec2(0, remaining));
 
   float rowY = ImGui::GetCursorPosY();
-  ImGui::SetCursorPosY(rowY + buttonHeight - ImGui::GetTextLineHeight());
-  ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "%s", g_app.statusMessage.c_str());
+  if (g_app.isSearching && g_app.activeSearch) {
+    // Live progress and Cancel while the worker scans, Search stays available to preempt it
+    const SearchProgress& progress = *g_app.activeSearch;
+    int total = progress.total;
+    float fraction = total > 0 ? static_cast<float>(progress.scanned) / total : 0.0f;
+    float barWidth = ImGui::GetContentRegionMax().x - ImGui::GetCursorPosX() - buttonWidth * 2 - ImGui::GetStyle().ItemSpacing.x * 2;
+    ImGui::ProgressBar(fraction, ImVec2(barWidth, buttonHeight), searchProgressText(progress).c_str());
+    ImGui::SameLine();
+    if (ImGui::Button("Cancel", ImVec2(buttonWidth, buttonHeight)))
+      cancelSearch();
+  } else if (g_app.precompute && g_app.precompute->total > 0) {
+    // Features of the newly selected type being extracted in the background
+    ImGui::SetCursorPosY(rowY + buttonHeight - ImGui::GetTextLineHeight());
+    ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "Preparing %s features: %d / %d",
+      featureTypeNames[g_app.precomputeType], g_app.precompute->scanned.load(), g_app.precompute->total.load());
+  } else {
+    ImGui::SetCursorPosY(rowY + buttonHeight - ImGui::GetTextLineHeight());
+    ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "%s", g_app.statusMessage.c_str());
+  }
   ImGui::SetCursorPos(ImVec2(ImGui::GetContentRegionMax().x - buttonWidth, rowY));
   if (ImGui::Button("Search", ImVec2(buttonWidth, buttonHeight)))
     performSearch();
@@ -446,19 +1217,32 @@ void renderResultsGrid() {
   float thumbSize = (panelWidth - minPadding * (columns - 1)) / columns;
   float gap = (columns > 1) ? (panelWidth - thumbSize * columns) / (columns - 1) : 0.0f;
 
+  // Partial results update in place while the scan runs
+  if (g_app.resultsComplete) {
+    ImGui::TextColored(ImVec4(0.4f, 0.9f, 0.4f, 1.0f), "Complete");
+  } else if (g_app.isSearching && g_app.activeSearch) {
+    ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.0f, 1.0f), "Best so far: %s", searchProgressText(*g_app.activeSearch).c_str());
+  } else {
+    ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "Partial results (search cancelled)");
+  }
+  ImGui::Spacing();
+
   int col = 0;
   for (size_t i = 0; i < g_app.results.size(); i++) {
     const auto& result = g_app.results[i];
     ImGui::BeginGroup();
 
-    if (result.textureId != 0) {
-      float aspectRatio = static_cast<float>(result.width) / result.height;
+    const Thumbnail* thumb = g_thumbnails->get(result.filepath);
+    if (thumb) {
+      float aspectRatio = static_cast<float>(thumb->width) / thumb->height;
       float displayWidth = thumbSize, displayHeight = displayWidth / aspectRatio;
       if (displayHeight > thumbSize) {
         displayHeight = thumbSize;
         displayWidth = displayHeight * aspectRatio;
       }
-      ImGui::Image((ImTextureID)(intptr_t)result.textureId, ImVec2(displayWidth, displayHeight));
+      ImGui::Image((ImTextureID)(intptr_t)thumb->textureId, ImVec2(displayWidth, displayHeight));
+    } else {
+      ImGui::Dummy(ImVec2(thumbSize, thumbSize * 0.75f));  // keeps the grid in place until it is uploaded
     }
 
     float imageRightAbs = ImGui::GetItemRectMax().x;
@@ -498,6 +1282,8 @@ void renderRightPanel() {
 
   if (g_app.hasResults && !g_app.results.empty()) {
     renderResultsGrid();
+  } else if (g_app.isSearching && g_app.activeSearch) {
+    renderCenteredText("Searching...", searchProgressText(*g_app.activeSearch).c_str());
   } else if (!g_app.isSearching) {
     renderCenteredText("No results yet.", "Select a query image and click Search.");
   }
@@ -521,6 +1307,8 @@ void renderUI() {
   if (!io.WantTextInput) {
     if (ImGui::IsKeyPressed(ImGuiKey_Enter) || ImGui::IsKeyPressed(ImGuiKey_KeypadEnter))
       performSearch();
+    if (ImGui::IsKeyPressed(ImGuiKey_Escape) && g_app.isSearching)
+      cancelSearch();
     if (ImGui::IsKeyPressed(ImGuiKey_Q))
       glfwSetWindowShouldClose(glfwGetCurrentContext(), GLFW_TRUE);
   }
@@ -570,6 +1358,7 @@ void renderUI() {
 // ============================================================================
 
 int main(int argc, char* argv[]) {
+  startMetricsFromEnvironment();  // CBIR_METRICS_PORT / CBIR_METRICS_FILE
   glfwSetErrorCallback(errorCallback);
   if (!glfwInit()) { std::println(stderr, "Failed to initialize GLFW"); return 1; }
 
@@ -659,6 +1448,11 @@ int main(int argc, char* argv[]) {
   ImGui_ImplGlfw_InitForOpenGL(window, true);
   ImGui_ImplOpenGL2_Init();
 
+  // Downscaled copies of viewed images live in the temp directory between sessions
+  std::error_code tempError;
+  std::filesystem::path tempDir = std::filesystem::temp_directory_path(tempError);
+  g_thumbnails = std::make_unique<ThumbnailCache>((tempError ? std::filesystem::path(".") : tempDir) / "cbir_thumbnails");
+
   // Main loop
   while (!glfwWindowShouldClose(window)) {
     glfwPollEvents();
@@ -666,6 +1460,8 @@ int main(int argc, char* argv[]) {
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
+    pollSearch();
+    g_thumbnails->update();
     renderUI();
 
     ImGui::Render();
@@ -679,8 +1475,10 @@ int main(int argc, char* argv[]) {
   }
 
   // Cleanup
-  freeTexture(g_app.queryTextureId);
-  for (auto& r : g_app.results) freeTexture(r.textureId);
+  g_searchWorker.stop();
+  g_precomputer.stop();
+  g_thumbnails->releaseAll();
+  g_thumbnails.reset();
   ImGui_ImplOpenGL2_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
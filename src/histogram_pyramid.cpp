@@ -0,0 +1,117 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the coarse histogram pyramid used for exact pruning.
+*/
+
+#include "histogram_pyramid.h"
+#include <algorithm>
+
+// float rounding in the coarse sums can push a bound a few ulps above the
+// exact distance, subtract a small slack so the bound is always safe
+static const float kBoundSlack = 1e-4f;
+
+// bins of one segment on a level (2x2x2 = 8, 4x4x4 = 64)
+static int segmentLevelSize(const HistogramSegment& seg, int level) {
+  if (!seg.rgbCube) return seg.size;
+  return level == 0 ? 8 : 64;
+}
+
+// coarse bin of fine bin i = r*64 + g*8 + b on a level
+static int coarseBin(int i, int level) {
+  int r = i / 64, g = (i / 8) % 8, b = i % 8;
+  if (level == 0) return (r >> 2) * 4 + (g >> 2) * 2 + (b >> 2);
+  return (r >> 1) * 16 + (g >> 1) * 4 + (b >> 1);
+}
+
+/*
+  Collapse one feature vector into a coarse level
+
+  Every segment is normalized to sum 1 (same as the intersection distances),
+  segments with an empty histogram become all zeros.
+
+  Input:
+    segments - segment layout of the feature vector
+    features - fine feature vector
+    level - pyramid level (0 = 2x2x2, 1 = 4x4x4)
+    out - output, levelDim floats
+*/
+static void collapseLevel(const std::vector<HistogramSegment>& segments, const float* features,
+                          int level, float* out) {
+  for (const auto& seg : segments) {
+    int outSize = segmentLevelSize(seg, level);
+    std::fill(out, out + outSize, 0.0f);
+
+    double sum = 0.0;
+    for (int i = 0; i < seg.size; i++) sum += features[seg.offset + i];
+
+    if (sum >= 1.0) {
+      for (int i = 0; i < seg.size; i++) {
+        int bin = seg.rgbCube ? coarseBin(i, level) : i;
+        out[bin] += static_cast<float>(features[seg.offset + i] / sum);
+      }
+    }
+    out += outSize;
+  }
+}
+
+int pyramidLevelDim(const std::vector<HistogramSegment>& segments, int level) {
+  int levelDim = 0;
+  for (const auto& seg : segments) levelDim += segmentLevelSize(seg, level);
+  return levelDim;
+}
+
+/*
+  Build the normalized coarse levels for every row of the index
+
+  Input:
+    rows - fine feature vectors
+    segments - segment layout shared by all rows
+    pyramid - output
+*/
+void buildHistogramPyramid(const std::vector<std::vector<float>>& rows,
+                           const std::vector<HistogramSegment>& segments, HistogramPyramid& pyramid) {
+  pyramid.segments = segments;
+  for (int level = 0; level < kPyramidLevels; level++) {
+    int levelDim = pyramidLevelDim(segments, level);
+    pyramid.levelDim[level] = levelDim;
+    pyramid.levels[level].assign(rows.size() * levelDim, 0.0f);
+
+    for (size_t r = 0; r < rows.size(); r++) {
+      collapseLevel(segments, rows[r].data(), level, &pyramid.levels[level][r * levelDim]);
+    }
+  }
+}
+
+
+// Compute the coarse levels of a single (query) feature vector
+void computePyramidLevels(const HistogramPyramid& pyramid, const std::vector<float>& features,
+                          std::vector<float> queryLevels[kPyramidLevels]) {
+  for (int level = 0; level < kPyramidLevels; level++) {
+    queryLevels[level].assign(pyramid.levelDim[level], 0.0f);
+    collapseLevel(pyramid.segments, features.data(), level, queryLevels[level].data());
+  }
+}
+
+
+/*
+  Lower bound on the fine distance using one coarse level
+
+  distance = 1 - average intersection over segments, and the coarse
+  intersection of every segment is >= its fine intersection.
+*/
+float pyramidLowerBound(const HistogramPyramid& pyramid, int level, const float* queryLevel, int row) {
+  int levelDim = pyramid.levelDim[level];
+  const float* rowLevel = &pyramid.levels[level][static_cast<size_t>(row) * levelDim];
+
+  float intersection = 0.0f;
+  for (int i = 0; i < levelDim; i++) {
+    intersection += std::min(queryLevel[i], rowLevel[i]);
+  }
+
+  float bound = 1.0f - intersection / pyramid.segments.size();
+  return bound - kBoundSlack;
+}
@@ -0,0 +1,425 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the minimal HTTP helpers used by the query server.
+*/
+
+#include "http_util.h"
+#include <print>  // for modern C++ printing (C++23)
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using socklen_t = int;
+#else
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+// Requests bigger than this are rejected (a query image is a few MB at most)
+static const size_t kMaxHeaderBytes = 16 * 1024;
+static const size_t kMaxBodyBytes = 64 * 1024 * 1024;
+
+bool netInit() {
+#ifdef _WIN32
+  static bool started = false;
+  if (!started) {
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) return false;
+    started = true;
+  }
+#endif
+  return true;
+}
+
+void httpClose(SocketHandle conn) {
+  if (conn == kInvalidSocket) return;
+#ifdef _WIN32
+  closesocket(static_cast<SOCKET>(conn));
+#else
+  close(static_cast<int>(conn));
+#endif
+}
+
+void httpSetTimeout(SocketHandle conn, int timeoutMs) {
+#ifdef _WIN32
+  DWORD value = timeoutMs;
+  setsockopt(static_cast<SOCKET>(conn), SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&value), sizeof(value));
+  setsockopt(static_cast<SOCKET>(conn), SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&value), sizeof(value));
+#else
+  timeval value;
+  value.tv_sec = timeoutMs / 1000;
+  value.tv_usec = (timeoutMs % 1000) * 1000;
+  setsockopt(static_cast<int>(conn), SOL_SOCKET, SO_RCVTIMEO, &value, sizeof(value));
+  setsockopt(static_cast<int>(conn), SOL_SOCKET, SO_SNDTIMEO, &value, sizeof(value));
+#endif
+}
+
+static long sendSome(SocketHandle conn, const char* data, size_t size) {
+#ifdef _WIN32
+  return send(static_cast<SOCKET>(conn), data, static_cast<int>(size), 0);
+#elif defined(MSG_NOSIGNAL)
+  return send(static_cast<int>(conn), data, size, MSG_NOSIGNAL);  // no SIGPIPE if the client left
+#else
+  return send(static_cast<int>(conn), data, size, 0);
+#endif
+}
+
+static long recvSome(SocketHandle conn, char* data, size_t size) {
+#ifdef _WIN32
+  return recv(static_cast<SOCKET>(conn), data, static_cast<int>(size), 0);
+#else
+  return recv(static_cast<int>(conn), data, size, 0);
+#endif
+}
+
+static bool sendAll(SocketHandle conn, const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    long n = sendSome(conn, data.data() + sent, data.size() - sent);
+    if (n <= 0) return false;
+    sent += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+SocketHandle httpListen(const std::string& host, int port, int backlog) {
+  if (!netInit()) return kInvalidSocket;
+
+  SocketHandle listener = static_cast<SocketHandle>(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+  if (listener == kInvalidSocket) return kInvalidSocket;
+
+  int reuse = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<unsigned short>(port));
+  if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+      bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(listener, backlog) != 0) {
+    httpClose(listener);
+    return kInvalidSocket;
+  }
+  return listener;
+}
+
+SocketHandle httpAccept(SocketHandle listener) {
+  SocketHandle conn = static_cast<SocketHandle>(accept(listener, nullptr, nullptr));
+  if (conn == kInvalidSocket) return kInvalidSocket;
+  int noDelay = 1;  // small JSON replies, don't wait for Nagle
+  setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+  return conn;
+}
+
+/*
+  Accept with back-off
+
+  accept() fails right away, again and again, while the process is out of
+  descriptors or memory, so a loop that just tries again spins a core and
+  floods the log. Those failures (and aborted handshakes) are retried after
+  a pause that doubles from 10 ms up to 1 s; a listener that is closed or
+  not a listening socket any more can never succeed, and ends the loop.
+*/
+SocketHandle httpAcceptRetry(SocketHandle listener) {
+  int pauseMs = 0;
+  for (;;) {
+    SocketHandle conn = httpAccept(listener);
+    if (conn != kInvalidSocket) return conn;
+#ifdef _WIN32
+    int code = WSAGetLastError();
+    bool fatal = code == WSAENOTSOCK || code == WSAEINVAL || code == WSANOTINITIALISED;
+#else
+    int code = errno;
+    bool fatal = code == EBADF || code == ENOTSOCK || code == EINVAL || code == EOPNOTSUPP;
+#endif
+    std::string reason = std::system_category().message(code);
+    if (fatal) {
+      std::println(stderr, "Error: accept failed ({}), no longer accepting connections", reason);
+      return kInvalidSocket;
+    }
+    if (code == EINTR) continue;
+    pauseMs = std::clamp(pauseMs * 2, 10, 1000);
+    std::println(stderr, "Warning: accept failed ({}), retrying in {} ms", reason, pauseMs);
+    std::this_thread::sleep_for(std::chrono::milliseconds(pauseMs));
+  }
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+std::string urlDecode(const std::string& value) {
+  std::string out;
+  out.reserve(value.size());
+  for (size_t i = 0; i < value.size(); i++) {
+    if (value[i] == '+') {
+      out += ' ';
+    } else if (value[i] == '%' && i + 2 < value.size() && hexValue(value[i + 1]) >= 0 && hexValue(value[i + 2]) >= 0) {
+      out += static_cast<char>(hexValue(value[i + 1]) * 16 + hexValue(value[i + 2]));
+      i += 2;
+    } else {
+      out += value[i];
+    }
+  }
+  return out;
+}
+
+std::string urlEncode(const std::string& value) {
+  static const char* digits = "0123456789ABCDEF";
+  std::string out;
+  for (unsigned char c : value) {
+    if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~' || c == '/') {
+      out += static_cast<char>(c);
+    } else {
+      out += '%';
+      out += digits[c >> 4];
+      out += digits[c & 15];
+    }
+  }
+  return out;
+}
+
+std::string encodeQueryString(const std::unordered_map<std::string, std::string>& query) {
+  std::string out;
+  for (const auto& [key, value] : query) {
+    if (!out.empty()) out += '&';
+    out += urlEncode(key) + "=" + urlEncode(value);
+  }
+  return out;
+}
+
+std::string jsonEscape(const std::string& value) {
+  std::string out;
+  out.reserve(value.size());
+  for (unsigned char c : value) {
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if (c < 0x20) {
+          char buffer[8];
+          std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+          out += buffer;
+        } else {
+          out += static_cast<char>(c);
+        }
+    }
+  }
+  return out;
+}
+
+// Split "a=1&b=2" into the query map
+static void parseQueryString(const std::string& text, std::unordered_map<std::string, std::string>& query) {
+  size_t start = 0;
+  while (start <= text.size()) {
+    size_t end = text.find('&', start);
+    if (end == std::string::npos) end = text.size();
+    std::string pair = text.substr(start, end - start);
+    if (!pair.empty()) {
+      size_t eq = pair.find('=');
+      if (eq == std::string::npos) {
+        query[urlDecode(pair)] = "";
+      } else {
+        query[urlDecode(pair.substr(0, eq))] = urlDecode(pair.substr(eq + 1));
+      }
+    }
+    start = end + 1;
+  }
+}
+
+// Case-insensitive header lookup in the raw header block, empty if absent
+static std::string headerValue(const std::string& headers, const std::string& name) {
+  size_t pos = 0;
+  while (pos < headers.size()) {
+    size_t end = headers.find("\r\n", pos);
+    if (end == std::string::npos) end = headers.size();
+    size_t colon = headers.find(':', pos);
+    if (colon != std::string::npos && colon < end && colon - pos == name.size()) {
+      bool same = true;
+      for (size_t i = 0; i < name.size(); i++) {
+        if (std::tolower(static_cast<unsigned char>(headers[pos + i])) != std::tolower(static_cast<unsigned char>(name[i]))) {
+          same = false;
+          break;
+        }
+      }
+      if (same) {
+        size_t valueStart = colon + 1;
+        while (valueStart < end && headers[valueStart] == ' ') valueStart++;
+        return headers.substr(valueStart, end - valueStart);
+      }
+    }
+    pos = end + 2;
+  }
+  return "";
+}
+
+/*
+  Read the header block and the Content-Length body of one message
+
+  Input:
+    conn - connected socket
+    headers - output header block (without the final blank line)
+    body - output body
+  Output:
+    bool - false if the connection closed early or a limit was exceeded
+*/
+static bool readMessage(SocketHandle conn, std::string& headers, std::string& body) {
+  std::string data;
+  char buffer[8192];
+  size_t headerEnd;
+  while ((headerEnd = data.find("\r\n\r\n")) == std::string::npos) {
+    if (data.size() > kMaxHeaderBytes) return false;
+    long n = recvSome(conn, buffer, sizeof(buffer));
+    if (n <= 0) return false;
+    data.append(buffer, static_cast<size_t>(n));
+  }
+  headers = data.substr(0, headerEnd);
+  body = data.substr(headerEnd + 4);
+
+  std::string lengthText = headerValue(headers, "Content-Length");
+  size_t length = 0;
+  if (!lengthText.empty()) {
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(lengthText.c_str(), &end, 10);
+    if (end == lengthText.c_str() || parsed > kMaxBodyBytes) return false;
+    length = static_cast<size_t>(parsed);
+  }
+  while (body.size() < length) {
+    long n = recvSome(conn, buffer, sizeof(buffer));
+    if (n <= 0) return false;
+    body.append(buffer, static_cast<size_t>(n));
+  }
+  body.resize(length);
+  return true;
+}
+
+bool httpReadRequest(SocketHandle conn, HttpRequest& request) {
+  std::string headers;
+  if (!readMessage(conn, headers, request.body)) return false;
+
+  // request line: METHOD target HTTP/1.1
+  size_t lineEnd = headers.find("\r\n");
+  std::string requestLine = headers.substr(0, lineEnd);
+  size_t space1 = requestLine.find(' ');
+  size_t space2 = requestLine.find(' ', space1 + 1);
+  if (space1 == std::string::npos || space2 == std::string::npos) return false;
+
+  request.method = requestLine.substr(0, space1);
+  std::string target = requestLine.substr(space1 + 1, space2 - space1 - 1);
+  size_t question = target.find('?');
+  request.path = urlDecode(target.substr(0, question));
+  request.query.clear();
+  if (question != std::string::npos) {
+    parseQueryString(target.substr(question + 1), request.query);
+  }
+  return true;
+}
+
+static const char* statusText(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 202: return "Accepted";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    case 504: return "Gateway Timeout";
+    default: return "Unknown";
+  }
+}
+
+bool httpWriteResponse(SocketHandle conn, const HttpResponse& response) {
+  std::string message = "HTTP/1.1 " + std::to_string(response.status) + " " + statusText(response.status) + "\r\n";
+  message += "Content-Type: " + response.contentType + "\r\n";
+  message += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+  message += "Connection: close\r\n\r\n";
+  message += response.body;
+  return sendAll(conn, message);
+}
+
+int httpFetch(const std::string& host, int port, const std::string& method, const std::string& target,
+              const std::string& body, HttpResponse& response, int timeoutMs) {
+  if (!netInit()) return -1;
+
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* found = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0 || !found) {
+    return -1;
+  }
+
+  SocketHandle conn = static_cast<SocketHandle>(socket(found->ai_family, found->ai_socktype, found->ai_protocol));
+  if (conn == kInvalidSocket) {
+    freeaddrinfo(found);
+    return -1;
+  }
+  if (timeoutMs > 0) httpSetTimeout(conn, timeoutMs);
+  int connected = connect(conn, found->ai_addr, static_cast<socklen_t>(found->ai_addrlen));
+  freeaddrinfo(found);
+  if (connected != 0) {
+    httpClose(conn);
+    return -1;
+  }
+
+  std::string message = method + " " + target + " HTTP/1.1\r\n";
+  message += "Host: " + host + ":" + std::to_string(port) + "\r\n";
+  message += "Content-Type: application/octet-stream\r\n";
+  message += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+  message += "Connection: close\r\n\r\n";
+  message += body;
+
+  std::string headers;
+  bool ok = sendAll(conn, message) && readMessage(conn, headers, response.body);
+  httpClose(conn);
+  if (!ok) return -1;
+
+  // status line: HTTP/1.1 200 OK
+  size_t space = headers.find(' ');
+  if (space == std::string::npos) return -1;
+  response.status = std::atoi(headers.c_str() + space + 1);
+  std::string contentType = headerValue(headers, "Content-Type");
+  if (!contentType.empty()) response.contentType = contentType;
+  return 0;
+}
+
+bool parseHostPort(const std::string& address, std::string& host, int& port) {
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos || colon + 1 >= address.size()) return false;
+  host = address.substr(0, colon);
+  if (host.empty()) host = "127.0.0.1";
+  char* end = nullptr;
+  long value = std::strtol(address.c_str() + colon + 1, &end, 10);
+  if (*end != '\0' || value <= 0 || value > 65535) return false;
+  port = static_cast<int>(value);
+  return true;
+}
@@ -0,0 +1,429 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the parallel directory walk and the listing manifest.
+*/
+
+#include "image_enumerator.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <mutex>
+#include <print>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+static const char* kManifestMagic = "CBIR-MANIFEST";
+static const int kManifestFormatVersion = 1;
+
+bool isImageFile(const std::filesystem::path& path) {
+  std::string ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".ppm" || ext == ".tif" || ext == ".tiff" ||
+         ext == ".bmp";
+}
+
+// Size and mtime with one stat (false if the path is gone)
+static bool statPath(const std::string& path, uint64_t& size, int64_t& mtime) {
+#ifdef _WIN32
+  std::error_code ec;
+  auto time = std::filesystem::last_write_time(path, ec);
+  if (ec) return false;
+  size = std::filesystem::is_directory(path, ec) ? 0 : std::filesystem::file_size(path, ec);
+  if (ec) return false;
+  mtime = static_cast<int64_t>(time.time_since_epoch().count());
+#else
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) return false;
+  size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+  mtime = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+  mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+  return true;
+}
+
+static int walkThreads(const EnumerateOptions& options) {
+  if (options.threads > 0) return options.threads;
+  return std::max(8, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+// Run fn(i) for i in [0, count) on up to `threads` threads
+template <typename Fn>
+static void parallelFor(size_t count, int threads, Fn fn) {
+  std::atomic<size_t> next{0};
+  auto work = [&]() {
+    for (size_t i = next++; i < count; i = next++) fn(i);
+  };
+  int extra = static_cast<int>(std::min<size_t>(count, static_cast<size_t>(threads))) - 1;
+  std::vector<std::thread> pool;
+  for (int t = 0; t < extra; t++) pool.emplace_back(work);
+  work();
+  for (auto& thread : pool) thread.join();
+}
+
+struct DirectoryRecord {
+  std::string path;
+  int64_t mtime = 0;
+};
+
+/*
+  Parallel walk
+
+  Workers take directories from a shared queue, list them and queue their
+  subdirectories, so wide and deep trees both keep every thread busy.
+  Directories in `known` are not queued when they are found: they are
+  already accounted for by a manifest record. Symbolic links to
+  directories are not followed, a tree with a link cycle still finishes.
+*/
+class DirectoryWalker {
+public:
+  DirectoryWalker(bool recursive, const std::unordered_set<std::string>* known)
+      : recursive_(recursive), known_(known) {}
+
+  void run(std::vector<std::string> start, int threads) {
+    for (auto& dir : start) queue_.push_back(std::move(dir));
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) pool.emplace_back(&DirectoryWalker::workerLoop, this);
+    workerLoop();
+    for (auto& thread : pool) thread.join();
+  }
+
+  std::vector<DirectoryRecord> directories;
+  std::vector<ImageRecord> files;
+  std::vector<std::string> failed;  // directories that could not be listed
+  int listed = 0;
+
+private:
+  void workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      available_.wait(lock, [&] { return !queue_.empty() || active_ == 0; });
+      if (queue_.empty()) {
+        available_.notify_all();  // everyone else is waiting for the same thing
+        return;
+      }
+      std::string dir = std::move(queue_.back());
+      queue_.pop_back();
+      active_++;
+      lock.unlock();
+
+      DirectoryRecord record{dir, 0};
+      std::vector<ImageRecord> dirFiles;
+      std::vector<std::string> subdirs;
+      bool ok = listDirectory(dir, record, dirFiles, subdirs);
+
+      lock.lock();
+      active_--;
+      listed++;
+      if (ok) {
+        directories.push_back(std::move(record));
+        files.insert(files.end(), std::make_move_iterator(dirFiles.begin()), std::make_move_iterator(dirFiles.end()));
+        for (auto& subdir : subdirs) queue_.push_back(std::move(subdir));
+      } else {
+        failed.push_back(std::move(dir));
+      }
+      available_.notify_all();
+    }
+  }
+
+  bool listDirectory(const std::string& dir, DirectoryRecord& record, std::vector<ImageRecord>& dirFiles,
+                     std::vector<std::string>& subdirs) {
+    uint64_t size = 0;
+    if (!statPath(dir, size, record.mtime)) return false;  // before listing, a change during the walk shows next run
+
+    std::error_code ec;  // no exceptions on the worker threads
+    for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+      std::error_code typeError;
+      if (it->is_directory(typeError) && !it->is_symlink(typeError)) {
+        if (!recursive_) continue;
+        std::string subdir = it->path().string();
+        if (!known_ || !known_->count(subdir)) subdirs.push_back(std::move(subdir));
+      } else if (it->is_regular_file(typeError) && isImageFile(it->path())) {
+        ImageRecord image;
+        image.path = it->path().string();
+        if (statPath(image.path, image.size, image.mtime)) dirFiles.push_back(std::move(image));
+      }
+    }
+    return !ec;
+  }
+
+  bool recursive_;
+  const std::unordered_set<std::string>* known_;
+  std::vector<std::string> queue_;
+  int active_ = 0;
+  std::mutex mutex_;
+  std::condition_variable available_;
+};
+
+/*
+  Manifest file
+
+  Text, one record per line:
+    CBIR-MANIFEST <version> <recursive>
+    R <database directory>
+    D <mtime> <directory>
+    F <size> <mtime> <image>
+  Paths are the last field and run to the end of the line.
+*/
+struct Manifest {
+  std::string root;
+  bool recursive = true;
+  std::vector<DirectoryRecord> directories;
+  std::vector<ImageRecord> files;
+};
+
+static std::string defaultManifestFile(const std::string& imageDir) {
+  std::error_code ec;
+  std::filesystem::path absolute = std::filesystem::absolute(imageDir, ec).lexically_normal();
+  std::filesystem::path tempDir = std::filesystem::temp_directory_path(ec);
+  if (ec) tempDir = ".";
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.txt",
+                static_cast<unsigned long long>(std::hash<std::string>{}(absolute.generic_string())));
+  return (tempDir / "cbir_manifests" / name).string();
+}
+
+static bool loadManifest(const std::string& manifestFile, Manifest& manifest) {
+  std::ifstream in(manifestFile);
+  if (!in) return false;
+  std::string magic;
+  int version = 0, recursive = 1;
+  in >> magic >> version >> recursive;
+  if (magic != kManifestMagic || version != kManifestFormatVersion) return false;
+  manifest.recursive = recursive != 0;
+
+  std::string line;
+  std::getline(in, line);  // rest of the header
+  while (std::getline(in, line)) {
+    if (line.size() < 2) continue;
+    std::istringstream fields(line.substr(2));
+    if (line[0] == 'R') {
+      manifest.root = line.substr(2);
+    } else if (line[0] == 'D') {
+      DirectoryRecord dir;
+      if (!(fields >> dir.mtime) || fields.get() != ' ' || !std::getline(fields, dir.path)) return false;
+      manifest.directories.push_back(std::move(dir));
+    } else if (line[0] == 'F') {
+      ImageRecord image;
+      if (!(fields >> image.size >> image.mtime) || fields.get() != ' ' || !std::getline(fields, image.path)) {
+        return false;
+      }
+      manifest.files.push_back(std::move(image));
+    } else {
+      return false;
+    }
+  }
+  return !manifest.root.empty();
+}
+
+// Written next to the target and renamed, a reader never sees half a manifest
+static void saveManifest(const std::string& manifestFile, const Manifest& manifest) {
+  std::error_code ec;
+  std::filesystem::path parent = std::filesystem::path(manifestFile).parent_path();
+  if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+
+  // one partial file per thread, two scans of the same directory may finish together
+  std::string partial = manifestFile + ".part" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  {
+    std::ofstream out(partial, std::ios::trunc);
+    if (!out) return;  // only a cache, the listing itself is still good
+    out << std::format("{} {} {}\nR {}\n", kManifestMagic, kManifestFormatVersion, manifest.recursive ? 1 : 0,
+                       manifest.root);
+    for (const auto& dir : manifest.directories) out << std::format("D {} {}\n", dir.mtime, dir.path);
+    for (const auto& image : manifest.files) out << std::format("F {} {} {}\n", image.size, image.mtime, image.path);
+    if (!out) {
+      out.close();
+      std::filesystem::remove(partial, ec);
+      return;
+    }
+  }
+  std::filesystem::rename(partial, manifestFile, ec);
+  if (ec) std::filesystem::remove(partial, ec);
+}
+
+/*
+  Bring a manifest up to date with a stat of everything it names
+
+  Unchanged directories keep their images (with refreshed size/mtime),
+  changed directories are listed again and any directory found that the
+  manifest does not know is walked. Directories that are gone take their
+  images with them.
+
+  Output:
+    bool - true if anything differed from the manifest
+*/
+static bool refreshManifest(Manifest& manifest, int threads, EnumerateStats& stats) {
+  enum DirState : char { Unchanged, Changed, Missing };
+  std::vector<char> dirState(manifest.directories.size());
+  parallelFor(manifest.directories.size(), threads, [&](size_t i) {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (!statPath(manifest.directories[i].path, size, mtime)) dirState[i] = Missing;
+    else dirState[i] = mtime == manifest.directories[i].mtime ? Unchanged : Changed;
+  });
+  stats.directoriesStatted = static_cast<int>(manifest.directories.size());
+
+  std::unordered_map<std::string, char> stateOf;
+  std::unordered_set<std::string> known;
+  std::vector<std::string> relist;
+  std::vector<DirectoryRecord> directories;
+  for (size_t i = 0; i < manifest.directories.size(); i++) {
+    const auto& dir = manifest.directories[i];
+    stateOf.emplace(dir.path, dirState[i]);
+    if (dirState[i] == Missing) continue;
+    known.insert(dir.path);
+    if (dirState[i] == Unchanged) directories.push_back(dir);
+    else relist.push_back(dir.path);
+  }
+  bool changed = !relist.empty() || directories.size() + relist.size() != manifest.directories.size();
+
+  // images of unchanged directories are only stat'ed
+  std::vector<ImageRecord> kept;
+  for (auto& image : manifest.files) {
+    auto state = stateOf.find(std::filesystem::path(image.path).parent_path().string());
+    if (state != stateOf.end() && state->second == Unchanged) kept.push_back(std::move(image));
+    else changed = true;
+  }
+  std::vector<char> present(kept.size());
+  std::atomic<bool> filesChanged{false};
+  parallelFor(kept.size(), threads, [&](size_t i) {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    present[i] = statPath(kept[i].path, size, mtime);
+    if (present[i] && (size != kept[i].size || mtime != kept[i].mtime)) {
+      kept[i].size = size;
+      kept[i].mtime = mtime;
+      filesChanged = true;
+    }
+  });
+  stats.filesStatted = static_cast<int>(kept.size());
+
+  std::vector<ImageRecord> files;
+  files.reserve(kept.size());
+  for (size_t i = 0; i < kept.size(); i++) {
+    if (present[i]) files.push_back(std::move(kept[i]));
+    else changed = true;
+  }
+
+  if (!relist.empty()) {
+    DirectoryWalker walker(manifest.recursive, &known);
+    walker.run(std::move(relist), threads);
+    stats.directoriesListed = walker.listed;
+    directories.insert(directories.end(), walker.directories.begin(), walker.directories.end());
+    files.insert(files.end(), std::make_move_iterator(walker.files.begin()), std::make_move_iterator(walker.files.end()));
+  }
+
+  manifest.directories = std::move(directories);
+  manifest.files = std::move(files);
+  return changed || filesChanged;
+}
+
+/*
+  List every image under a directory
+
+  Input:
+    imageDir - database directory
+    images - output, sorted by path
+    options - recursion, threads and the manifest to use
+    stats - optional, how the listing was produced
+
+  Output:
+    int - 0 on success, -1 if imageDir cannot be listed
+*/
+int enumerateImages(const std::string& imageDir, std::vector<ImageRecord>& images,
+                    const EnumerateOptions& options, EnumerateStats* stats) {
+  EnumerateStats localStats;
+  EnumerateStats& s = stats ? *stats : localStats;
+  s = EnumerateStats();
+  int threads = walkThreads(options);
+
+  // "dir/" and "dir" list the same paths, and the parent of every image must match its directory record
+  std::string root = imageDir;
+  while (root.size() > 1 && (root.back() == '/' || root.back() == '\\')) root.pop_back();
+
+  std::string manifestFile;
+  Manifest manifest;
+  bool changed = true;
+  if (options.useManifest) {
+    manifestFile = options.manifestFile.empty() ? defaultManifestFile(root) : options.manifestFile;
+    if (loadManifest(manifestFile, manifest) && manifest.root == root && manifest.recursive == options.recursive) {
+      changed = refreshManifest(manifest, threads, s);
+      s.fromManifest = !changed;
+    } else {
+      manifest = Manifest();
+    }
+  }
+
+  // the root always has a record once the manifest is valid, no record means nothing usable was loaded
+  bool haveRoot = std::any_of(manifest.directories.begin(), manifest.directories.end(),
+                              [&](const DirectoryRecord& dir) { return dir.path == root; });
+  if (!haveRoot) {
+    DirectoryWalker walker(options.recursive, nullptr);
+    walker.run({root}, threads);
+    s.directoriesListed = walker.listed;
+    if (std::find(walker.failed.begin(), walker.failed.end(), root) != walker.failed.end()) {
+      std::println(stderr, "Error: Unable to list directory {}", root);
+      return -1;
+    }
+    manifest.root = root;
+    manifest.recursive = options.recursive;
+    manifest.directories = std::move(walker.directories);
+    manifest.files = std::move(walker.files);
+    for (const auto& dir : walker.failed) std::println(stderr, "Warning: Unable to list directory {}", dir);
+    changed = true;
+    s.fromManifest = false;
+  }
+
+  std::sort(manifest.files.begin(), manifest.files.end(),
+            [](const ImageRecord& a, const ImageRecord& b) { return a.path < b.path; });
+  if (options.useManifest && changed) {
+    std::sort(manifest.directories.begin(), manifest.directories.end(),
+              [](const DirectoryRecord& a, const DirectoryRecord& b) { return a.path < b.path; });
+    saveManifest(manifestFile, manifest);
+  }
+  images = std::move(manifest.files);
+  return 0;
+}
+
+int enumerateImages(const std::string& imageDir, std::vector<std::string>& paths,
+                    const EnumerateOptions& options, EnumerateStats* stats) {
+  std::vector<ImageRecord> images;
+  if (enumerateImages(imageDir, images, options, stats) != 0) return -1;
+  paths.clear();
+  paths.reserve(images.size());
+  for (auto& image : images) paths.push_back(std::move(image.path));
+  return 0;
+}
+
+bool parseEnumerateOption(int argc, char* argv[], int& i, EnumerateOptions& options) {
+  std::string arg = argv[i];
+  if (arg == "--flat") {
+    options.recursive = false;
+  } else if (arg == "--no-manifest") {
+    options.useManifest = false;
+  } else if (arg == "--enum-threads" && i + 1 < argc) {
+    options.threads = std::max(1, std::atoi(argv[++i]));
+  } else if (arg == "--manifest" && i + 1 < argc) {
+    options.manifestFile = argv[++i];
+  } else {
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,377 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the image pack container (writer, append and the
+  memory-mapped reader).
+*/
+
+#include "image_pack.h"
+#include "image_enumerator.h"
+#include "metrics.h"
+#include "trace.h"
+#include <print>  // for modern C++ printing (C++23)
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+  Layout: "CBPK" and the format version, the encoded image files back to
+  back, then the table (per entry: name length, name, offset, size) and a
+  fixed footer (table offset, entry count, "CBPK"). Appending writes the
+  new images, a new table and a new footer after the old footer, which is
+  never overwritten: the old table stays valid for mappings made before,
+  and a failed append is cut back to the old end of the file.
+*/
+static const char kPackMagic[4] = {'C', 'B', 'P', 'K'};
+static const uint32_t kPackFormatVersion = 1;
+static const uint64_t kPackHeaderBytes = 8;
+static const uint64_t kPackFooterBytes = 16;
+
+// Images under a directory as {file, entry name}, named by their path below it ("sub/pic.jpg") so nested trees keep unique names
+static int listPackInputs(const std::string& imageDir, std::vector<std::pair<std::string, std::string>>& files) {
+  EnumerateOptions options;
+  options.useManifest = false;  // read once, a manifest would never be validated
+  std::vector<std::string> paths;
+  if (enumerateImages(imageDir, paths, options) != 0) return -1;
+  for (auto& path : paths) {
+    std::string name = std::filesystem::path(path).lexically_relative(imageDir).generic_string();
+    files.emplace_back(std::move(path), std::move(name));
+  }
+  return 0;
+}
+
+template <typename T>
+static T readAt(const unsigned char* bytes) {
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+// Parse the footer (last kPackFooterBytes of the file)
+static bool parseFooter(const unsigned char* footer, uint64_t fileLength, uint64_t& tableOffset, uint32_t& count) {
+  tableOffset = readAt<uint64_t>(footer);
+  count = readAt<uint32_t>(footer + 8);
+  return std::memcmp(footer + 12, kPackMagic, 4) == 0 && tableOffset >= kPackHeaderBytes &&
+         tableOffset <= fileLength - kPackFooterBytes;
+}
+
+// Parse the table, every entry has to lie in the data region
+static bool parseTable(const unsigned char* table, size_t tableBytes, uint32_t count, uint64_t tableOffset,
+                       std::vector<ImagePackEntry>& entries) {
+  entries.clear();
+  entries.reserve(count);
+  size_t pos = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (tableBytes - pos < sizeof(uint32_t)) return false;
+    uint32_t nameLength = readAt<uint32_t>(table + pos);
+    pos += sizeof(uint32_t);
+    if (tableBytes - pos < nameLength + 2 * sizeof(uint64_t)) return false;
+    ImagePackEntry entry;
+    entry.name.assign(reinterpret_cast<const char*>(table + pos), nameLength);
+    pos += nameLength;
+    entry.offset = readAt<uint64_t>(table + pos);
+    entry.size = readAt<uint64_t>(table + pos + sizeof(uint64_t));
+    pos += 2 * sizeof(uint64_t);
+    if (entry.offset < kPackHeaderBytes || entry.offset > tableOffset || entry.size > tableOffset - entry.offset) {
+      return false;
+    }
+    entries.push_back(std::move(entry));
+  }
+  return pos == tableBytes;
+}
+
+static void writeTable(std::ostream& out, const std::vector<ImagePackEntry>& entries, uint64_t tableOffset) {
+  for (const auto& entry : entries) {
+    uint32_t nameLength = static_cast<uint32_t>(entry.name.size());
+    out.write(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
+    out.write(entry.name.data(), nameLength);
+    out.write(reinterpret_cast<const char*>(&entry.offset), sizeof(entry.offset));
+    out.write(reinterpret_cast<const char*>(&entry.size), sizeof(entry.size));
+  }
+  uint32_t count = static_cast<uint32_t>(entries.size());
+  out.write(reinterpret_cast<const char*>(&tableOffset), sizeof(tableOffset));
+  out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  out.write(kPackMagic, 4);
+}
+
+// Copy one image file to the end of out, adding its entry (returns false if it cannot be read)
+static bool copyIntoPack(std::ostream& out, const std::string& imageFile, const std::string& name,
+                         std::vector<char>& buffer, std::vector<ImagePackEntry>& entries) {
+  std::ifstream in(imageFile, std::ios::binary | std::ios::ate);
+  if (!in) return false;
+  std::streamoff length = in.tellg();
+  if (length < 0) return false;
+  buffer.resize(static_cast<size_t>(length));
+  in.seekg(0);
+  if (length > 0 && !in.read(buffer.data(), length)) return false;
+
+  ImagePackEntry entry;
+  entry.name = name;
+  entry.offset = static_cast<uint64_t>(out.tellp());
+  entry.size = static_cast<uint64_t>(length);
+  out.write(buffer.data(), length);
+  entries.push_back(std::move(entry));
+  return true;
+}
+
+
+ImagePack::~ImagePack() {
+#ifdef _WIN32
+  if (base_) UnmapViewOfFile(base_);
+  if (mappingHandle_) CloseHandle(mappingHandle_);
+  if (fileHandle_ && fileHandle_ != INVALID_HANDLE_VALUE) CloseHandle(fileHandle_);
+#else
+  if (base_) munmap(const_cast<unsigned char*>(base_), length_);
+#endif
+}
+
+std::shared_ptr<const ImagePack> ImagePack::open(const std::string& filename) {
+  std::shared_ptr<ImagePack> pack(new ImagePack());
+  pack->filename_ = filename;
+
+#ifdef _WIN32
+  pack->fileHandle_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+  LARGE_INTEGER fileSize;
+  if (pack->fileHandle_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(pack->fileHandle_, &fileSize)) {
+    std::println(stderr, "Error: Unable to open image pack {}", filename);
+    return nullptr;
+  }
+  pack->length_ = static_cast<size_t>(fileSize.QuadPart);
+  if (pack->length_ >= kPackHeaderBytes + kPackFooterBytes) {
+    pack->mappingHandle_ = CreateFileMappingA(pack->fileHandle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (pack->mappingHandle_) {
+      pack->base_ = static_cast<const unsigned char*>(MapViewOfFile(pack->mappingHandle_, FILE_MAP_READ, 0, 0, 0));
+    }
+  }
+#else
+  int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat info;
+  if (fd < 0 || ::fstat(fd, &info) != 0) {
+    if (fd >= 0) ::close(fd);
+    std::println(stderr, "Error: Unable to open image pack {}", filename);
+    return nullptr;
+  }
+  pack->length_ = static_cast<size_t>(info.st_size);
+  if (pack->length_ >= kPackHeaderBytes + kPackFooterBytes) {
+    void* mapped = mmap(nullptr, pack->length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) pack->base_ = static_cast<const unsigned char*>(mapped);
+  }
+  ::close(fd);  // the mapping keeps the file open
+#endif
+
+  const unsigned char* base = pack->base_;
+  uint64_t tableOffset = 0;
+  uint32_t count = 0;
+  if (!base || std::memcmp(base, kPackMagic, 4) != 0 || readAt<uint32_t>(base + 4) != kPackFormatVersion ||
+      !parseFooter(base + pack->length_ - kPackFooterBytes, pack->length_, tableOffset, count) ||
+      !parseTable(base + tableOffset, pack->length_ - kPackFooterBytes - tableOffset, count, tableOffset,
+                  pack->entries_)) {
+    std::println(stderr, "Error: {} is not a valid image pack", filename);
+    return nullptr;
+  }
+
+  for (int i = 0; i < pack->size(); i++) pack->lookup_[pack->entries_[i].name] = i;
+  return pack;
+}
+
+int ImagePack::find(const std::string& name) const {
+  auto it = lookup_.find(name);
+  return it == lookup_.end() ? -1 : it->second;
+}
+
+void ImagePack::prefetch(int i) const {
+#ifndef _WIN32
+  static const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  uintptr_t begin = reinterpret_cast<uintptr_t>(data(i)) & ~(pageSize - 1);
+  uintptr_t end = reinterpret_cast<uintptr_t>(data(i) + entries_[i].size);
+  if (end > begin) madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+#else
+  (void)i;
+#endif
+}
+
+
+bool isImagePackFile(const std::string& path) {
+  return std::filesystem::path(path).extension() == ".cbpk" && std::filesystem::is_regular_file(path);
+}
+
+int createImagePack(const std::string& imageDir, const std::string& packFile) {
+  if (!std::filesystem::is_directory(imageDir)) {
+    std::println(stderr, "Error: {} is not a directory", imageDir);
+    return -1;
+  }
+  std::vector<std::pair<std::string, std::string>> imageFiles;
+  if (listPackInputs(imageDir, imageFiles) != 0) return -1;
+
+  // written next to the target and renamed, a failed run never leaves a half pack behind
+  std::string partial = packFile + ".part";
+  std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    std::println(stderr, "Error: Unable to open pack file {} for writing", partial);
+    return -1;
+  }
+  out.write(kPackMagic, 4);
+  out.write(reinterpret_cast<const char*>(&kPackFormatVersion), sizeof(kPackFormatVersion));
+
+  std::vector<ImagePackEntry> entries;
+  std::vector<char> buffer;
+  for (const auto& [imageFile, name] : imageFiles) {
+    if (!copyIntoPack(out, imageFile, name, buffer, entries)) {
+      std::println(stderr, "Error: Failed to read image {}", imageFile);
+    }
+  }
+  writeTable(out, entries, static_cast<uint64_t>(out.tellp()));
+  out.close();
+
+  std::error_code ec;
+  if (out) std::filesystem::rename(partial, packFile, ec);
+  if (!out || ec) {
+    std::println(stderr, "Error: Failed writing pack file {}", packFile);
+    std::filesystem::remove(partial, ec);
+    return -1;
+  }
+  return 0;
+}
+
+int appendImagePack(const std::string& packFile, const std::vector<std::string>& inputs) {
+  std::vector<std::pair<std::string, std::string>> imageFiles;
+  for (const auto& input : inputs) {
+    if (!std::filesystem::is_directory(input)) {
+      imageFiles.emplace_back(input, std::filesystem::path(input).filename().string());
+    } else if (listPackInputs(input, imageFiles) != 0) {
+      return -1;
+    }
+  }
+
+  std::fstream file(packFile, std::ios::binary | std::ios::in | std::ios::out);
+  if (!file) {
+    std::println(stderr, "Error: Unable to open image pack {}", packFile);
+    return -1;
+  }
+
+  // current table, read from the end of the file
+  file.seekg(0, std::ios::end);
+  uint64_t length = static_cast<uint64_t>(file.tellg());
+  unsigned char header[kPackHeaderBytes], footer[kPackFooterBytes];
+  uint64_t tableOffset = 0;
+  uint32_t count = 0;
+  std::vector<unsigned char> table;
+  std::vector<ImagePackEntry> entries;
+  bool valid = length >= kPackHeaderBytes + kPackFooterBytes &&
+               file.seekg(0).read(reinterpret_cast<char*>(header), sizeof(header)) &&
+               std::memcmp(header, kPackMagic, 4) == 0 && readAt<uint32_t>(header + 4) == kPackFormatVersion &&
+               file.seekg(static_cast<std::streamoff>(length - kPackFooterBytes)).read(reinterpret_cast<char*>(footer), sizeof(footer)) &&
+               parseFooter(footer, length, tableOffset, count);
+  if (valid) {
+    table.resize(static_cast<size_t>(length - kPackFooterBytes - tableOffset));
+    valid = file.seekg(static_cast<std::streamoff>(tableOffset)).read(reinterpret_cast<char*>(table.data()), table.size()) &&
+            parseTable(table.data(), table.size(), count, tableOffset, entries);
+  }
+  if (!valid) {
+    std::println(stderr, "Error: {} is not a valid image pack", packFile);
+    return -1;
+  }
+
+  std::unordered_map<std::string, int> names;
+  for (int i = 0; i < static_cast<int>(entries.size()); i++) names[entries[i].name] = i;
+
+  // new images go after the old footer, the new table and footer follow them (the footer last)
+  file.seekp(static_cast<std::streamoff>(length));
+  std::vector<char> buffer;
+  int added = 0;
+  for (const auto& [imageFile, name] : imageFiles) {
+    if (names.count(name)) {
+      std::println(stderr, "Skipping {}: already in the pack", name);
+      continue;
+    }
+    if (!copyIntoPack(file, imageFile, name, buffer, entries)) {
+      std::println(stderr, "Error: Failed to read image {}", imageFile);
+      continue;
+    }
+    names[name] = static_cast<int>(entries.size()) - 1;
+    added++;
+  }
+  if (added == 0) return 0;  // nothing new, the pack is left untouched
+  writeTable(file, entries, static_cast<uint64_t>(file.tellp()));
+  bool written = static_cast<bool>(file.flush());
+  file.close();
+  if (!written) {
+    // e.g. the disk filled up: the old footer is the end of the file again
+    std::error_code ec;
+    std::filesystem::resize_file(packFile, length, ec);
+    std::println(stderr, "Error: Failed writing pack file {}", packFile);
+    return -1;
+  }
+  return added;
+}
+
+std::shared_ptr<const ImagePack> openImagePack(const std::string& packFile) {
+  struct Cached {
+    std::shared_ptr<const ImagePack> pack;
+    std::filesystem::file_time_type mtime;
+    uintmax_t size = 0;
+  };
+  static std::mutex mutex;
+  static std::unordered_map<std::string, Cached> cache;
+
+  std::error_code ec;
+  auto mtime = std::filesystem::last_write_time(packFile, ec);
+  uintmax_t size = ec ? 0 : std::filesystem::file_size(packFile, ec);
+  if (ec) return nullptr;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  Cached& cached = cache[packFile];
+  if (!cached.pack || cached.mtime != mtime || cached.size != size) {
+    cached.pack = ImagePack::open(packFile);  // images appended since: map the new table
+    cached.mtime = mtime;
+    cached.size = size;
+  }
+  return cached.pack;
+}
+
+bool splitPackPath(const std::string& path, std::string& packFile, std::string& name) {
+  for (size_t pos = path.find(".cbpk"); pos != std::string::npos; pos = path.find(".cbpk", pos + 1)) {
+    size_t end = pos + 5;
+    if (end + 1 < path.size() && (path[end] == '/' || path[end] == '\\')) {
+      packFile = path.substr(0, end);
+      name = path.substr(end + 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+cv::Mat readImage(const std::string& path, int flags) {
+  CBIR_TRACE_SCOPE("readImage");
+  cv::Mat image;
+  std::string packFile, name;
+  if (!splitPackPath(path, packFile, name)) {
+    image = cv::imread(path, flags);
+  } else {
+    std::shared_ptr<const ImagePack> pack = openImagePack(packFile);
+    int i = pack ? pack->find(name) : -1;
+    if (i >= 0 && pack->entry(i).size > 0) {  // imdecode throws on an empty buffer
+      cv::Mat bytes(1, static_cast<int>(pack->entry(i).size), CV_8UC1, const_cast<unsigned char*>(pack->data(i)));
+      imageBytesReadMetric().add(pack->entry(i).size);
+      image = cv::imdecode(bytes, flags);
+    }
+  }
+  (image.empty() ? decodeFailuresMetric() : imagesDecodedMetric()).add();
+  return image;
+}
@@ -0,0 +1,476 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the read-ahead image file reader (io_uring or a pread
+  thread pool).
+*/
+
+#include "image_reader.h"
+#include "image_pack.h"
+#include "metrics.h"
+#include "trace.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef CBIR_HAS_LIBURING
+#include <liburing.h>
+#endif
+
+/*
+  File buffers
+
+  Both backends read file i into slot i % slots.size(), and only start a
+  file once the slot's previous file has been handed to the decoder and
+  released. Files are started and released in path order, so the file the
+  decoder waits for always has a slot and the reader cannot deadlock.
+*/
+struct FileSlot {
+  std::vector<unsigned char> buffer;  // grows to the largest file read into it, never shrinks
+  size_t size = 0;                    // bytes of the current file
+  int error = 0;
+  bool done = false;                  // read finished (or failed)
+};
+
+class ReadBackend {
+public:
+  ReadBackend(const std::vector<std::string>& paths, const ImageReaderOptions& options)
+      : paths_(paths), queueDepth_(std::max(1, options.queueDepth)),
+        slots_(std::max(2, options.bufferCount)) {}
+  virtual ~ReadBackend() = default;
+
+  virtual bool next(ImageFile& file) = 0;
+  virtual const char* name() const = 0;
+
+protected:
+  // Hand the read file at head_ to the decoder
+  void take(ImageFile& file) {
+    const FileSlot& slot = slots_[head_ % slots_.size()];
+    file.index = head_;
+    file.path = paths_[head_];
+    file.error = slot.error;
+    file.data = slot.error ? nullptr : slot.buffer.data();
+    file.size = slot.error ? 0 : slot.size;
+    head_++;
+  }
+
+  // Slot that may receive a new file: the one before head_ is still being decoded
+  bool canStart(int index) const {
+    return index < static_cast<int>(paths_.size()) && index < head_ - 1 + static_cast<int>(slots_.size());
+  }
+
+  const std::vector<std::string>& paths_;
+  int queueDepth_;
+  std::vector<FileSlot> slots_;
+  int head_ = 0;       // next file for the decoder
+  int nextStart_ = 0;  // next file to open
+};
+
+// Whole file into slot (grows the buffer if needed)
+static void readWholeFile(const std::string& path, FileSlot& slot) {
+  slot.size = 0;
+  slot.error = 0;
+#ifdef _WIN32
+  FILE* file = std::fopen(path.c_str(), "rb");
+  if (!file) {
+    slot.error = errno ? errno : ENOENT;
+    return;
+  }
+  std::fseek(file, 0, SEEK_END);
+  long length = std::ftell(file);
+  std::fseek(file, 0, SEEK_SET);
+  if (length < 0) {
+    slot.error = EIO;
+    std::fclose(file);
+    return;
+  }
+  if (slot.buffer.size() < static_cast<size_t>(length)) slot.buffer.resize(length);
+  slot.size = std::fread(slot.buffer.data(), 1, length, file);
+  std::fclose(file);
+#else
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    slot.error = errno;
+    return;
+  }
+  struct stat info;
+  if (::fstat(fd, &info) != 0) {
+    slot.error = errno;
+    ::close(fd);
+    return;
+  }
+  size_t length = static_cast<size_t>(info.st_size);
+  if (slot.buffer.size() < length) slot.buffer.resize(length);
+  while (slot.size < length) {
+    ssize_t n = ::pread(fd, slot.buffer.data() + slot.size, length - slot.size, static_cast<off_t>(slot.size));
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      slot.error = errno;
+      break;
+    }
+    if (n == 0) break;  // file shrank while it was read
+    slot.size += static_cast<size_t>(n);
+  }
+  ::close(fd);
+#endif
+}
+
+
+/*
+  Fallback: queueDepth threads, each reading one whole file at a time
+  with blocking open/fstat/pread calls
+*/
+class PreadBackend : public ReadBackend {
+public:
+  PreadBackend(const std::vector<std::string>& paths, const ImageReaderOptions& options)
+      : ReadBackend(paths, options) {
+    int threads = std::min(queueDepth_, static_cast<int>(paths_.size()));
+    for (int i = 0; i < threads; i++) workers_.emplace_back(&PreadBackend::workerLoop, this);
+  }
+
+  ~PreadBackend() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    startable_.notify_all();
+    for (auto& worker : workers_) worker.join();
+  }
+
+  bool next(ImageFile& file) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (head_ >= static_cast<int>(paths_.size())) return false;
+    FileSlot& slot = slots_[head_ % slots_.size()];
+    finished_.wait(lock, [&] { return slot.done; });
+    if (head_ > 0) slots_[(head_ - 1) % slots_.size()].done = false;  // the decoder is done with the previous file
+    take(file);
+    startable_.notify_all();  // its slot can take a new file
+    return true;
+  }
+
+  const char* name() const override { return "pread"; }
+
+private:
+  void workerLoop() {
+    for (;;) {
+      int index;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        startable_.wait(lock, [&] {
+          return stopping_ || nextStart_ >= static_cast<int>(paths_.size()) || canStart(nextStart_);
+        });
+        if (stopping_ || nextStart_ >= static_cast<int>(paths_.size())) return;
+        index = nextStart_++;
+      }
+      FileSlot& slot = slots_[index % slots_.size()];
+      readWholeFile(paths_[index], slot);  // the slot belongs to this thread until done is set
+      std::lock_guard<std::mutex> lock(mutex_);
+      slot.done = true;
+      finished_.notify_one();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable startable_, finished_;
+  bool stopping_ = false;
+};
+
+
+#ifdef CBIR_HAS_LIBURING
+/*
+  io_uring: open, statx and read are all submitted to the kernel, up to
+  queueDepth files at a time, and completions are processed on the
+  decoder's thread while it waits for the next file. No extra threads.
+*/
+class UringBackend : public ReadBackend {
+public:
+  UringBackend(const std::vector<std::string>& paths, const ImageReaderOptions& options)
+      : ReadBackend(paths, options), files_(slots_.size()) {
+    if (io_uring_queue_init(static_cast<unsigned>(queueDepth_ * 2), &ring_, 0) != 0) return;
+    ready_ = true;
+
+    // open/statx through io_uring need Linux 5.6, older kernels use the pread pool
+    io_uring_probe* probe = io_uring_get_probe_ring(&ring_);
+    bool supported = probe && io_uring_opcode_supported(probe, IORING_OP_OPENAT) &&
+                     io_uring_opcode_supported(probe, IORING_OP_STATX) &&
+                     io_uring_opcode_supported(probe, IORING_OP_READ);
+    if (probe) io_uring_free_probe(probe);
+    if (!supported) {
+      io_uring_queue_exit(&ring_);
+      ready_ = false;
+    }
+  }
+
+  ~UringBackend() override {
+    if (!ready_) return;
+    // wait out the requests still in flight, they point into our buffers
+    while (inFlight_ > 0) {
+      int status = io_uring_submit_and_wait(&ring_, 1);
+      if (status < 0 && status != -EINTR) break;
+      drain();
+    }
+    io_uring_queue_exit(&ring_);
+  }
+
+  bool ready() const { return ready_; }
+
+  bool next(ImageFile& file) override {
+    if (head_ >= static_cast<int>(paths_.size())) return false;
+    FileSlot& slot = slots_[head_ % slots_.size()];
+    for (;;) {
+      startFiles();
+      if (slot.done) break;
+      int status = io_uring_submit_and_wait(&ring_, 1);
+      if (status < 0 && status != -EINTR) {
+        slot.error = -status;  // ring is broken, fail the file instead of spinning
+        break;
+      }
+      drain();
+    }
+    take(file);
+    return true;
+  }
+
+  const char* name() const override { return "io_uring"; }
+
+private:
+  enum Op { OpOpen, OpStat, OpRead };
+
+  struct FileState {
+    int fd = -1;
+    int pending = 0;       // requests in flight
+    size_t offset = 0;     // bytes read so far
+    bool sized = false;    // statx finished
+    struct statx info;
+  };
+
+  static uint64_t userData(size_t slot, Op op) { return (static_cast<uint64_t>(slot) << 2) | op; }
+
+  io_uring_sqe* getSqe() {
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+    if (!sqe) {
+      io_uring_submit(&ring_);
+      sqe = io_uring_get_sqe(&ring_);
+    }
+    return sqe;
+  }
+
+  // Queue open and statx for as many files as depth and buffers allow
+  void startFiles() {
+    while (inFlight_ < queueDepth_ && canStart(nextStart_)) {
+      if (io_uring_sq_space_left(&ring_) < 2) io_uring_submit(&ring_);
+      size_t id = nextStart_ % slots_.size();
+      const char* path = paths_[nextStart_].c_str();
+      nextStart_++;
+      slots_[id].done = false;
+      slots_[id].error = 0;
+      slots_[id].size = 0;
+      files_[id] = FileState();
+      files_[id].pending = 2;
+      inFlight_++;
+
+      io_uring_sqe* sqe = getSqe();
+      io_uring_prep_openat(sqe, AT_FDCWD, path, O_RDONLY | O_CLOEXEC, 0);
+      io_uring_sqe_set_data64(sqe, userData(id, OpOpen));
+      sqe = getSqe();
+      io_uring_prep_statx(sqe, AT_FDCWD, path, 0, STATX_SIZE, &files_[id].info);
+      io_uring_sqe_set_data64(sqe, userData(id, OpStat));
+    }
+  }
+
+  void submitRead(size_t id) {
+    FileSlot& slot = slots_[id];
+    FileState& state = files_[id];
+    io_uring_sqe* sqe = getSqe();
+    io_uring_prep_read(sqe, state.fd, slot.buffer.data() + state.offset,
+                       static_cast<unsigned>(slot.size - state.offset), state.offset);
+    io_uring_sqe_set_data64(sqe, userData(id, OpRead));
+    state.pending++;
+  }
+
+  void drain() {
+    io_uring_cqe* cqe;
+    while (io_uring_peek_cqe(&ring_, &cqe) == 0) {
+      complete(cqe->user_data >> 2, static_cast<Op>(cqe->user_data & 3), cqe->res);
+      io_uring_cqe_seen(&ring_, cqe);
+    }
+  }
+
+  void complete(size_t id, Op op, int result) {
+    FileSlot& slot = slots_[id];
+    FileState& state = files_[id];
+    state.pending--;
+    if (result < 0 && !(op == OpRead && (result == -EINTR || result == -EAGAIN))) {
+      if (!slot.error) slot.error = -result;
+    } else if (op == OpOpen) {
+      state.fd = result;
+    } else if (op == OpStat) {
+      state.sized = true;
+      slot.size = static_cast<size_t>(state.info.stx_size);
+      if (slot.buffer.size() < slot.size) slot.buffer.resize(slot.size);
+    } else if (op == OpRead && result == 0) {
+      slot.size = state.offset;  // file shrank while it was read
+    } else if (op == OpRead) {
+      state.offset += static_cast<size_t>(result);
+    }
+    if (state.pending > 0) return;  // open and statx both have to finish
+
+    if (!slot.error && state.offset < slot.size) {
+      submitRead(id);  // first read, the rest of a short read, or a retry
+      return;
+    }
+    if (state.fd >= 0) ::close(state.fd);
+    state.fd = -1;
+    slot.done = true;
+    inFlight_--;
+  }
+
+  io_uring ring_;
+  bool ready_ = false;
+  std::vector<FileState> files_;  // per slot
+  int inFlight_ = 0;
+};
+#endif
+
+
+/*
+  Image pack: the bytes are already mapped, the backend only asks the OS
+  to page in the next queueDepth entries ahead of the decoder
+*/
+class PackBackend : public ReadBackend {
+public:
+  PackBackend(const std::vector<std::string>& paths, std::shared_ptr<const ImagePack> pack,
+              const std::vector<int>& order, const ImageReaderOptions& options)
+      : ReadBackend(paths, options), pack_(std::move(pack)), order_(order) {}
+
+  bool next(ImageFile& file) override {
+    if (head_ >= static_cast<int>(order_.size())) return false;
+    for (; prefetched_ < static_cast<int>(order_.size()) && prefetched_ <= head_ + queueDepth_; prefetched_++) {
+      pack_->prefetch(order_[prefetched_]);
+    }
+    int entry = order_[head_];
+    file.index = head_;
+    file.path = paths_[head_];
+    file.error = 0;
+    file.data = pack_->data(entry);
+    file.size = static_cast<size_t>(pack_->entry(entry).size);
+    head_++;
+    return true;
+  }
+
+  const char* name() const override { return "pack"; }
+
+private:
+  std::shared_ptr<const ImagePack> pack_;
+  std::vector<int> order_;  // entry for each path
+  int prefetched_ = 0;      // entries order_[0, prefetched_) have been prefetched
+};
+
+
+ImageReader::ImageReader(std::vector<std::string> paths, const ImageReaderOptions& options)
+    : paths_(std::move(paths)) {
+  for (const auto& path : paths_) longestPath_ = std::max(longestPath_, path.size());
+#ifdef CBIR_HAS_LIBURING
+  if (options.useIoUring) {
+    auto uring = std::make_unique<UringBackend>(paths_, options);
+    if (uring->ready()) backend_ = std::move(uring);
+  }
+#endif
+  if (!backend_) backend_ = std::make_unique<PreadBackend>(paths_, options);
+}
+
+ImageReader::~ImageReader() = default;
+
+bool ImageReader::next(ImageFile& file) {
+  if (file.path.capacity() < longestPath_) file.path.reserve(longestPath_);
+  if (!backend_->next(file)) return false;
+  if (!file.error) imageBytesReadMetric().add(file.size);
+  return true;
+}
+
+ImageReader::ImageReader(std::shared_ptr<const ImagePack> pack, const ImageReaderOptions& options) {
+  // by name, the same order as the sorted paths of a directory (appended images can be out of order)
+  std::vector<int> order(pack->size());
+  for (int i = 0; i < pack->size(); i++) order[i] = i;
+  std::sort(order.begin(), order.end(), [&](int a, int b) { return pack->entry(a).name < pack->entry(b).name; });
+  for (int entry : order) paths_.push_back(pack->path(entry));
+  for (const auto& path : paths_) longestPath_ = std::max(longestPath_, path.size());
+  backend_ = std::make_unique<PackBackend>(paths_, std::move(pack), order, options);
+}
+
+const char* ImageReader::backendName() const {
+  return backend_->name();
+}
+
+cv::Mat decodeImageFile(const ImageFile& file, int flags) {
+  CBIR_TRACE_SCOPE("decode");
+  cv::Mat image;
+  if (!file.error && file.size > 0) {
+    cv::Mat bytes(1, static_cast<int>(file.size), CV_8UC1, const_cast<unsigned char*>(file.data));
+    image = cv::imdecode(bytes, flags);
+  }
+  (image.empty() ? decodeFailuresMetric() : imagesDecodedMetric()).add();
+  return image;
+}
+
+// Signatures of the formats isImageFile accepts (JPEG, PNG, PPM/PGM/PBM, TIFF, BMP)
+static bool hasImageSignature(const unsigned char* data, size_t size) {
+  if (size < 4) return false;
+  if (data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) return true;
+  if (std::memcmp(data, "\x89PNG", 4) == 0) return true;
+  if (data[0] == 'P' && data[1] >= '1' && data[1] <= '7') return true;
+  if (std::memcmp(data, "II*\0", 4) == 0 || std::memcmp(data, "MM\0*", 4) == 0) return true;
+  return data[0] == 'B' && data[1] == 'M';
+}
+
+bool decodeImageFile(const ImageFile& file, cv::Mat& image, int flags) {
+  CBIR_TRACE_SCOPE("decode");
+  // imdecode leaves dst untouched when it fails (no decoder for the bytes, or a header that does not
+  // parse), so only its return value says whether image holds this file or still the previous one
+  cv::Mat decoded;
+  if (!file.error && hasImageSignature(file.data, file.size)) {
+    cv::Mat bytes(1, static_cast<int>(file.size), CV_8UC1, const_cast<unsigned char*>(file.data));
+    decoded = cv::imdecode(bytes, flags, &image);
+  }
+  if (decoded.empty()) {
+    image.release();
+    decodeFailuresMetric().add();
+    return false;
+  }
+  imagesDecodedMetric().add();
+  return true;
+}
+
+bool parseImageReaderOption(int argc, char* argv[], int& i, ImageReaderOptions& options) {
+  std::string arg = argv[i];
+  if (arg == "--io-depth" && i + 1 < argc) {
+    options.queueDepth = std::max(1, std::atoi(argv[++i]));
+    return true;
+  }
+  if (arg == "--io-buffers" && i + 1 < argc) {
+    options.bufferCount = std::max(2, std::atoi(argv[++i]));
+    return true;
+  }
+  if (arg == "--io-pread") {
+    options.useIoUring = false;
+    return true;
+  }
+  return false;
+}
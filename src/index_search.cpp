@@ -0,0 +1,338 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of top-k searches against a precomputed feature index.
+*/
+
+#include "index_search.h"
+#include "custom_cascade.h"
+#include "distance.h"
+#include "trace.h"
+#include <algorithm>
+#include <numeric>
+#include <queue>
+
+// {distance, row} order, rows are sorted by path so this matches the scan path
+static bool matchLess(const IndexMatch& a, const IndexMatch& b) {
+  if (a.distance != b.distance) return a.distance < b.distance;
+  return a.row < b.row;
+}
+
+// Max-heap of the best k matches seen so far, top() is the current k-th best
+class TopK {
+public:
+  explicit TopK(int k) : k_(k), heap_(matchLess) {}
+
+  bool full() const { return static_cast<int>(heap_.size()) >= k_; }
+  float worst() const { return heap_.top().distance; }
+
+  void push(const IndexMatch& match) {
+    if (!full()) {
+      heap_.push(match);
+    } else if (matchLess(match, heap_.top())) {
+      heap_.pop();
+      heap_.push(match);
+    }
+  }
+
+  // sorted best first
+  void take(std::vector<IndexMatch>& results) {
+    results.clear();
+    while (!heap_.empty()) {
+      results.push_back(heap_.top());
+      heap_.pop();
+    }
+    std::reverse(results.begin(), results.end());
+  }
+
+private:
+  int k_;
+  std::priority_queue<IndexMatch, std::vector<IndexMatch>, bool (*)(const IndexMatch&, const IndexMatch&)> heap_;
+};
+
+
+/*
+  Exhaustive top-k search
+
+  Computes the distance from the query to every row with the same distance
+  function the scan path uses.
+*/
+void searchExhaustive(const FeatureIndex& index, const std::vector<float>& query, int k,
+                      std::vector<IndexMatch>& results, SearchStats* stats) {
+  TopK topK(k);
+  for (int row = 0; row < index.size(); row++) {
+    topK.push({computeDistance(index.type, query, index.features[row]), row});
+  }
+  topK.take(results);
+
+  if (stats) {
+    stats->candidates = index.size();
+    stats->fullyScored = index.size();
+    stats->pruned = 0;
+    stats->binsTouched = static_cast<uint64_t>(index.size()) * index.dim;
+  }
+}
+
+
+/*
+  Exhaustive top-k for several queries in one pass
+
+  Each row is read once and scored against every query while it is still
+  in cache, instead of streaming the whole feature matrix once per query.
+  Every query gets the same results as searchExhaustive.
+*/
+void searchExhaustiveBatch(const FeatureIndex& index, const std::vector<const std::vector<float>*>& queries,
+                           const std::vector<int>& ks, std::vector<std::vector<IndexMatch>>& results) {
+  CBIR_TRACE_SCOPE("search/batch");
+  std::vector<TopK> topKs;
+  topKs.reserve(queries.size());
+  for (int k : ks) topKs.emplace_back(k);
+
+  for (int row = 0; row < index.size(); row++) {
+    const std::vector<float>& features = index.features[row];
+    for (size_t q = 0; q < queries.size(); q++) {
+      topKs[q].push({computeDistance(index.type, *queries[q], features), row});
+    }
+  }
+
+  results.resize(queries.size());
+  for (size_t q = 0; q < queries.size(); q++) topKs[q].take(results[q]);
+}
+
+
+/*
+  Coarse-to-fine histogram bound cascade
+
+  1. Lower bound every row with the 2x2x2 level and visit rows in bound order.
+  2. Once the k-th best exact distance is below the next level-0 bound,
+     no remaining row can enter the top-k, stop.
+  3. Otherwise check the 4x4x4 bound before computing the full distance.
+
+  A row is only skipped when its bound is strictly greater than the current
+  k-th distance, so ties are resolved exactly like the exhaustive scan.
+*/
+void searchPyramid(const FeatureIndex& index, const std::vector<float>& query, int k,
+                   std::vector<IndexMatch>& results, SearchStats* stats) {
+  const HistogramPyramid& pyramid = index.pyramid;
+  std::vector<float> queryLevels[kPyramidLevels];
+  computePyramidLevels(pyramid, query, queryLevels);
+
+  int n = index.size();
+  std::vector<float> coarseBound(n);
+  for (int row = 0; row < n; row++) {
+    coarseBound[row] = pyramidLowerBound(pyramid, 0, queryLevels[0].data(), row);
+  }
+  uint64_t binsTouched = static_cast<uint64_t>(n) * pyramid.levelDim[0];
+
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    if (coarseBound[a] != coarseBound[b]) return coarseBound[a] < coarseBound[b];
+    return a < b;
+  });
+
+  TopK topK(k);
+  int fullyScored = 0;
+  for (int i = 0; i < n; i++) {
+    int row = order[i];
+    if (topK.full() && coarseBound[row] > topK.worst()) break;  // every later row is worse
+
+    if (topK.full()) {
+      float bound = pyramidLowerBound(pyramid, 1, queryLevels[1].data(), row);
+      binsTouched += pyramid.levelDim[1];
+      if (bound > topK.worst()) continue;
+    }
+
+    topK.push({computeDistance(index.type, query, index.features[row]), row});
+    binsTouched += index.dim;
+    fullyScored++;
+  }
+  topK.take(results);
+
+  if (stats) {
+    stats->candidates = n;
+    stats->fullyScored = fullyScored;
+    stats->pruned = n - fullyScored;
+    stats->binsTouched = binsTouched;
+  }
+}
+
+
+/*
+  SimHash Hamming prefilter
+
+  1. Compute the query signature and its Hamming distance to every row
+     (popcount over a few 64 bit words per row, the signatures are contiguous).
+  2. Keep the candidates rows with the smallest Hamming distance.
+  3. Compute the exact distance only for those and return the top-k.
+
+  Approximate: a true neighbor outside the candidate set is missed, the
+  benchmark reports the recall against the exhaustive scan.
+*/
+void searchSimHash(const FeatureIndex& index, const std::vector<float>& query, int k, int candidates,
+                   std::vector<IndexMatch>& results, SearchStats* stats) {
+  const SimHash& simhash = index.simhash;
+  int words = simhash.words();
+  std::vector<uint64_t> signature(words);
+  computeSimHash(simhash, query, signature.data());
+
+  int n = index.size();
+  std::vector<std::pair<int, int>> hamming(n);  // {hamming distance, row}
+  for (int row = 0; row < n; row++) {
+    hamming[row] = {hammingDistance(signature.data(), &simhash.signatures[static_cast<size_t>(row) * words], words), row};
+  }
+
+  int m = std::min(n, std::max(candidates, k));
+  if (m < n) {
+    std::nth_element(hamming.begin(), hamming.begin() + m, hamming.end());
+  }
+
+  TopK topK(k);
+  for (int i = 0; i < m; i++) {
+    int row = hamming[i].second;
+    topK.push({computeDistance(index.type, query, index.features[row]), row});
+  }
+  topK.take(results);
+
+  if (stats) {
+    stats->candidates = n;
+    stats->fullyScored = m;
+    stats->pruned = n - m;
+    stats->binsTouched = static_cast<uint64_t>(m) * index.dim;
+    stats->signaturesCompared = n;
+  }
+}
+
+
+// Copy the VP-tree results and stats into the common types
+static void takeVPTreeResults(const FeatureIndex& index, const std::vector<std::pair<float, int>>& found,
+                              const VPTreeStats& vpStats, std::vector<IndexMatch>& results, SearchStats* stats) {
+  results.clear();
+  for (const auto& match : found) results.push_back({match.first, match.second});
+
+  if (stats) {
+    stats->candidates = index.size();
+    stats->fullyScored = vpStats.distanceEvaluations;
+    stats->pruned = index.size() - vpStats.distanceEvaluations;
+    stats->binsTouched = static_cast<uint64_t>(vpStats.distanceEvaluations) * index.dim;
+    stats->nodesVisited = vpStats.nodesVisited;
+    stats->nodesSkipped = vpStats.nodesSkipped;
+  }
+}
+
+// Exact k-NN on the vantage-point tree
+void searchVPTree(const FeatureIndex& index, const std::vector<float>& query, int k,
+                  std::vector<IndexMatch>& results, SearchStats* stats) {
+  std::vector<std::pair<float, int>> found;
+  VPTreeStats vpStats;
+  vpTreeKnn(index.vptree, index.features, query, k, found, &vpStats);
+  takeVPTreeResults(index, found, vpStats, results, stats);
+}
+
+
+/*
+  Two-stage custom distance
+
+  Stage 1 reads only the 512 DNN values of every row, stage 2 computes the
+  full custom distance for the rows that can still enter the top-k.
+*/
+void searchCustomCascade(const FeatureIndex& index, const std::vector<float>& query, int k,
+                         std::vector<IndexMatch>& results, SearchStats* stats) {
+  int n = index.size();
+  std::vector<float> dnnDistances(n);
+  for (int row = 0; row < n; row++) {
+    dnnDistances[row] = customDnnDistance(query, index.features[row]);
+  }
+
+  std::vector<std::pair<float, int>> found;
+  CustomCascadeStats cascadeStats;
+  customCascadeTopK(dnnDistances, k, [&](int row, float& distance) {
+    distance = customDistance(query, index.features[row]);
+    return true;
+  }, found, &cascadeStats);
+
+  results.clear();
+  for (const auto& match : found) results.push_back({match.first, match.second});
+
+  if (stats) {
+    stats->candidates = n;
+    stats->fullyScored = cascadeStats.fullyScored;
+    stats->pruned = n - cascadeStats.fullyScored;
+    stats->binsTouched = static_cast<uint64_t>(n) * 512 +
+                         static_cast<uint64_t>(cascadeStats.fullyScored) * index.dim;
+  }
+}
+
+
+/*
+  Range query: every row within maxDistance of the query
+
+  Uses the VP-tree when the index has one, otherwise a linear scan.
+  Results are sorted by {distance, row}.
+*/
+int searchIndexRange(const FeatureIndex& index, const std::vector<float>& query, float maxDistance,
+                     std::vector<IndexMatch>& results, SearchStats* stats) {
+  CBIR_TRACE_SCOPE("search/range");
+  if (static_cast<int>(query.size()) != index.dim) return -1;
+
+  if (!index.vptree.empty()) {
+    std::vector<std::pair<float, int>> found;
+    VPTreeStats vpStats;
+    vpTreeRange(index.vptree, index.features, query, maxDistance, found, &vpStats);
+    takeVPTreeResults(index, found, vpStats, results, stats);
+    return 0;
+  }
+
+  results.clear();
+  for (int row = 0; row < index.size(); row++) {
+    float distance = computeDistance(index.type, query, index.features[row]);
+    if (distance <= maxDistance) results.push_back({distance, row});
+  }
+  std::sort(results.begin(), results.end(), matchLess);
+
+  if (stats) {
+    stats->candidates = index.size();
+    stats->fullyScored = index.size();
+    stats->pruned = 0;
+    stats->binsTouched = static_cast<uint64_t>(index.size()) * index.dim;
+  }
+  return 0;
+}
+
+
+// SearchAuto becomes the fastest exact method the index has structures for
+SearchMode resolveSearchMode(const FeatureIndex& index, SearchMode mode) {
+  if (mode != SearchAuto) return mode;
+  if (!index.pyramid.empty()) return SearchPyramid;
+  if (!index.vptree.empty()) return SearchVPTree;
+  if (index.type == CustomDesign) return SearchCascade;
+  return SearchExhaustive;
+}
+
+// Top-k rows of the index using the requested (or fastest exact) method
+int searchIndex(const FeatureIndex& index, const std::vector<float>& query, int k,
+                const SearchOptions& options, std::vector<IndexMatch>& results, SearchStats* stats) {
+  CBIR_TRACE_SCOPE("search");
+  if (k <= 0 || static_cast<int>(query.size()) != index.dim) return -1;
+
+  SearchMode mode = resolveSearchMode(index, options.mode);
+  if (mode == SearchPyramid) {
+    if (index.pyramid.empty()) return -1;
+    searchPyramid(index, query, k, results, stats);
+  } else if (mode == SearchSimHash) {
+    if (index.simhash.empty()) return -1;
+    searchSimHash(index, query, k, options.simhashCandidates, results, stats);
+  } else if (mode == SearchVPTree) {
+    if (index.vptree.empty()) return -1;
+    searchVPTree(index, query, k, results, stats);
+  } else if (mode == SearchCascade) {
+    if (index.type != CustomDesign) return -1;
+    searchCustomCascade(index, query, k, results, stats);
+  } else {
+    searchExhaustive(index, query, k, results, stats);
+  }
+  return 0;
+}
@@ -0,0 +1,129 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of index sharding (split by image ID hash, merge on load).
+*/
+
+#include "index_shard.h"
+#include <print>  // for modern C++ printing (C++23)
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+
+// FNV-1a, stable across platforms and builds (std::hash is not)
+int shardOfImage(const std::string& filename, int shardCount) {
+  if (shardCount <= 1) return 0;
+  uint64_t hash = 1469598103934665603ULL;
+  for (unsigned char c : filename) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return static_cast<int>(hash % static_cast<uint64_t>(shardCount));
+}
+
+std::string shardIndexFilename(const std::string& prefix, int shardId, int shardCount) {
+  return prefix + ".shard" + std::to_string(shardId) + "of" + std::to_string(shardCount) + ".cbix";
+}
+
+// Copy the SimHash model (planes, mean) and the signatures of the given rows
+static void copySimHashRows(const SimHash& from, const std::vector<int>& rows, SimHash& to) {
+  to = SimHash();
+  if (from.empty()) return;
+  to.bits = from.bits;
+  to.dim = from.dim;
+  to.normalizeSegments = from.normalizeSegments;
+  to.mean = from.mean;
+  to.planes = from.planes;
+  int words = from.words();
+  to.signatures.reserve(rows.size() * words);
+  for (int row : rows) {
+    to.signatures.insert(to.signatures.end(), from.signatures.begin() + static_cast<size_t>(row) * words,
+                         from.signatures.begin() + static_cast<size_t>(row + 1) * words);
+  }
+}
+
+int splitFeatureIndex(const FeatureIndex& index, int shardCount, std::vector<FeatureIndex>& shards) {
+  if (shardCount <= 0 || index.shardCount > 0) {
+    std::println(stderr, "Error: Only a whole index can be split into shards");
+    return -1;
+  }
+
+  // rows stay in path order inside every shard
+  std::vector<std::vector<int>> shardRows(shardCount);
+  for (int row = 0; row < index.size(); row++) {
+    std::string filename = std::filesystem::path(index.paths[row]).filename().string();
+    shardRows[shardOfImage(filename, shardCount)].push_back(row);
+  }
+
+  shards.assign(shardCount, FeatureIndex());
+  for (int id = 0; id < shardCount; id++) {
+    FeatureIndex& shard = shards[id];
+    shard.type = index.type;
+    shard.dim = index.dim;
+    shard.version = index.version;
+    shard.shardCount = shardCount;
+    shard.shardIds = {id};
+    for (int row : shardRows[id]) {
+      shard.paths.push_back(index.paths[row]);
+      shard.features.push_back(index.features[row]);
+    }
+    copySimHashRows(index.simhash, shardRows[id], shard.simhash);
+    finalizeFeatureIndex(shard);  // pyramid and VP-tree for the shard's own rows
+  }
+  return 0;
+}
+
+int mergeFeatureIndexShard(FeatureIndex& index, const FeatureIndex& shard) {
+  if (index.type != shard.type || index.dim != shard.dim || index.version != shard.version ||
+      index.shardCount == 0 || index.shardCount != shard.shardCount) {
+    std::println(stderr, "Error: Shard does not belong to the same index build");
+    return -1;
+  }
+  for (int id : shard.shardIds) {
+    if (std::find(index.shardIds.begin(), index.shardIds.end(), id) != index.shardIds.end()) {
+      std::println(stderr, "Error: Shard {} is already loaded", id);
+      return -1;
+    }
+  }
+
+  // merge the two path-sorted row lists
+  int a = 0, b = 0;
+  FeatureIndex merged;
+  std::vector<std::pair<int, int>> order;  // {source, row}, source 0 = index, 1 = shard
+  while (a < index.size() || b < shard.size()) {
+    bool takeIndex = b >= shard.size() || (a < index.size() && index.paths[a] < shard.paths[b]);
+    order.push_back(takeIndex ? std::make_pair(0, a++) : std::make_pair(1, b++));
+  }
+
+  merged.type = index.type;
+  merged.dim = index.dim;
+  merged.version = index.version;
+  merged.shardCount = index.shardCount;
+  merged.shardIds = index.shardIds;
+  merged.shardIds.insert(merged.shardIds.end(), shard.shardIds.begin(), shard.shardIds.end());
+  std::sort(merged.shardIds.begin(), merged.shardIds.end());
+
+  bool keepSimHash = !index.simhash.empty() && index.simhash.bits == shard.simhash.bits &&
+                     index.simhash.planes == shard.simhash.planes;
+  if (keepSimHash) {
+    merged.simhash = index.simhash;
+    merged.simhash.signatures.clear();
+  }
+  for (const auto& [source, row] : order) {
+    const FeatureIndex& from = source == 0 ? index : shard;
+    merged.paths.push_back(from.paths[row]);
+    merged.features.push_back(from.features[row]);
+    if (keepSimHash) {
+      int words = from.simhash.words();
+      auto begin = from.simhash.signatures.begin() + static_cast<size_t>(row) * words;
+      merged.simhash.signatures.insert(merged.simhash.signatures.end(), begin, begin + words);
+    }
+  }
+
+  finalizeFeatureIndex(merged);
+  index = std::move(merged);
+  return 0;
+}
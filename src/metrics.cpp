@@ -0,0 +1,234 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the metrics registry and its Prometheus exporters.
+*/
+
+#include "metrics.h"
+#include "http_util.h"
+#include <print>  // for modern C++ printing (C++23)
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+uint64_t MetricCounter::value() const {
+  uint64_t total = 0;
+  for (const auto& shard : shards_) total += shard.value.load(std::memory_order_relaxed);
+  return total;
+}
+
+void MetricHistogram::snapshot(uint64_t (&buckets)[kHistogramBuckets], uint64_t& count, uint64_t& sumNs) const {
+  count = sumNs = 0;
+  for (int b = 0; b < kHistogramBuckets; b++) buckets[b] = 0;
+  for (const auto& shard : shards_) {
+    for (int b = 0; b < kHistogramBuckets; b++) buckets[b] += shard.buckets[b].load(std::memory_order_relaxed);
+    sumNs += shard.sumNs.load(std::memory_order_relaxed);
+  }
+  for (int b = 0; b < kHistogramBuckets; b++) count += buckets[b];
+}
+
+enum MetricKind { KindCounter, KindGauge, KindHistogram };
+
+struct MetricEntry {
+  std::string labels;
+  std::unique_ptr<MetricCounter> counter;
+  std::unique_ptr<MetricGauge> gauge;
+  std::unique_ptr<MetricHistogram> histogram;
+};
+
+struct MetricFamily {
+  MetricKind kind;
+  std::string help;
+  std::vector<std::unique_ptr<MetricEntry>> entries;  // in registration order
+};
+
+struct MetricsRegistry {
+  std::mutex mutex;
+  std::map<std::string, MetricFamily> families;  // by name, the export is sorted
+};
+
+static MetricsRegistry& registry() {
+  static MetricsRegistry instance;
+  return instance;
+}
+
+// Entry for name + labels, created with its metric on first use
+static MetricEntry& findOrCreate(const std::string& name, const std::string& help, const std::string& labels,
+                                 MetricKind kind) {
+  MetricsRegistry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  auto [it, inserted] = reg.families.try_emplace(name, MetricFamily{kind, help, {}});
+  MetricFamily& family = it->second;
+  for (auto& entry : family.entries) {
+    if (entry->labels == labels) return *entry;
+  }
+  auto entry = std::make_unique<MetricEntry>();
+  entry->labels = labels;
+  switch (family.kind) {
+    case KindCounter:   entry->counter = std::make_unique<MetricCounter>(); break;
+    case KindGauge:     entry->gauge = std::make_unique<MetricGauge>(); break;
+    case KindHistogram: entry->histogram = std::make_unique<MetricHistogram>(); break;
+  }
+  family.entries.push_back(std::move(entry));
+  return *family.entries.back();
+}
+
+// A name is registered with one kind, asking for it as another kind is a programming error
+MetricCounter& metricCounter(const std::string& name, const std::string& help, const std::string& labels) {
+  MetricEntry& entry = findOrCreate(name, help, labels, KindCounter);
+  if (!entry.counter) std::abort();
+  return *entry.counter;
+}
+
+MetricGauge& metricGauge(const std::string& name, const std::string& help, const std::string& labels) {
+  MetricEntry& entry = findOrCreate(name, help, labels, KindGauge);
+  if (!entry.gauge) std::abort();
+  return *entry.gauge;
+}
+
+MetricHistogram& metricHistogram(const std::string& name, const std::string& help, const std::string& labels) {
+  MetricEntry& entry = findOrCreate(name, help, labels, KindHistogram);
+  if (!entry.histogram) std::abort();
+  return *entry.histogram;
+}
+
+// "{labels}" or "{labels,extra}", nothing when both are empty
+static std::string labelSet(const std::string& labels, const std::string& extra = "") {
+  if (labels.empty() && extra.empty()) return "";
+  return "{" + labels + (labels.empty() || extra.empty() ? "" : ",") + extra + "}";
+}
+
+std::string metricsToPrometheus() {
+  MetricsRegistry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  std::string text;
+  for (const auto& [name, family] : reg.families) {
+    static const char* kTypeNames[] = {"counter", "gauge", "histogram"};
+    text += std::format("# HELP {} {}\n# TYPE {} {}\n", name, family.help, name, kTypeNames[family.kind]);
+    for (const auto& entry : family.entries) {
+      if (entry->counter) {
+        text += std::format("{}{} {}\n", name, labelSet(entry->labels), entry->counter->value());
+      } else if (entry->gauge) {
+        text += std::format("{}{} {}\n", name, labelSet(entry->labels), entry->gauge->value());
+      } else {
+        uint64_t buckets[kHistogramBuckets], count, sumNs;
+        entry->histogram->snapshot(buckets, count, sumNs);
+        uint64_t cumulative = 0;
+        for (int b = 0; b < kHistogramBuckets - 1; b++) {
+          cumulative += buckets[b];
+          text += std::format("{}_bucket{} {}\n", name,
+                              labelSet(entry->labels, std::format("le=\"{}\"", std::ldexp(1e-6, b))), cumulative);
+        }
+        text += std::format("{}_bucket{} {}\n", name, labelSet(entry->labels, "le=\"+Inf\""), count);
+        text += std::format("{}_sum{} {:.9f}\n", name, labelSet(entry->labels), sumNs / 1e9);
+        text += std::format("{}_count{} {}\n", name, labelSet(entry->labels), count);
+      }
+    }
+  }
+  return text;
+}
+
+int writeMetricsFile(const std::string& filename) {
+  std::string text = metricsToPrometheus();
+  std::string temp = filename + ".tmp";
+  {
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    if (!out || !out.write(text.data(), text.size())) {
+      std::println(stderr, "Error: Unable to write metrics file {}", filename);
+      return -1;
+    }
+  }
+  // scrapers (node_exporter textfile collector) never see a half-written file
+  std::error_code ec;
+  std::filesystem::rename(temp, filename, ec);
+  if (ec) {
+    std::println(stderr, "Error: Unable to write metrics file {}", filename);
+    return -1;
+  }
+  return 0;
+}
+
+int startMetricsServer(const std::string& host, int port) {
+  if (!netInit()) return -1;
+  SocketHandle listener = httpListen(host, port);
+  if (listener == kInvalidSocket) {
+    std::println(stderr, "Error: Failed to listen for metrics on {}:{}", host, port);
+    return -1;
+  }
+  // one connection at a time is plenty for a scraper every few seconds
+  std::thread([listener]() {
+    for (;;) {
+      SocketHandle conn = httpAcceptRetry(listener);
+      if (conn == kInvalidSocket) break;  // logged, the process goes on without the endpoint
+      httpSetTimeout(conn, 5000);
+      HttpRequest request;
+      HttpResponse response;
+      if (httpReadRequest(conn, request) && request.path == "/metrics") {
+        response = {200, "text/plain; version=0.0.4", metricsToPrometheus()};
+      } else {
+        response = {404, "text/plain", "not found\n"};
+      }
+      httpWriteResponse(conn, response);
+      httpClose(conn);
+    }
+    httpClose(listener);
+  }).detach();
+  std::println("Metrics on http://{}:{}/metrics", host, port);
+  return 0;
+}
+
+void startMetricsFile(const std::string& filename, int intervalMs) {
+  std::thread([filename, intervalMs]() {
+    for (;;) {
+      writeMetricsFile(filename);
+      std::this_thread::sleep_for(std::chrono::milliseconds(std::max(100, intervalMs)));
+    }
+  }).detach();
+}
+
+void startMetricsFromEnvironment() {
+  const char* port = std::getenv("CBIR_METRICS_PORT");
+  if (port && std::atoi(port) > 0) startMetricsServer("127.0.0.1", std::atoi(port));
+  const char* file = std::getenv("CBIR_METRICS_FILE");
+  const char* interval = std::getenv("CBIR_METRICS_INTERVAL_MS");
+  if (file && *file) startMetricsFile(file, interval ? std::atoi(interval) : 10000);
+}
+
+MetricCounter& imagesDecodedMetric() {
+  static MetricCounter& metric = metricCounter("cbir_images_decoded_total", "Images decoded successfully");
+  return metric;
+}
+
+MetricCounter& decodeFailuresMetric() {
+  static MetricCounter& metric = metricCounter("cbir_decode_failures_total",
+                                               "Image files that could not be read or decoded");
+  return metric;
+}
+
+MetricCounter& imageBytesReadMetric() {
+  static MetricCounter& metric = metricCounter("cbir_image_bytes_read_total",
+                                               "Encoded image bytes handed to the decoder");
+  return metric;
+}
+
+MetricCounter& resultCacheHitsMetric() {
+  static MetricCounter& metric = metricCounter("cbir_result_cache_hits_total", "Queries answered from the result cache");
+  return metric;
+}
+
+MetricCounter& resultCacheMissesMetric() {
+  static MetricCounter& metric = metricCounter("cbir_result_cache_misses_total",
+                                               "Result cache lookups that had to search");
+  return metric;
+}
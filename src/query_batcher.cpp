@@ -0,0 +1,105 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the adaptive micro-batcher for exhaustive queries.
+*/
+
+#include "query_batcher.h"
+#include <algorithm>
+
+// weight of the newest inter-arrival gap in the moving average
+static const double kGapSmoothing = 0.2;
+
+QueryBatcher::QueryBatcher(const BatchOptions& options) : options_(options) {
+  options_.maxBatch = std::max(1, options_.maxBatch);
+  options_.maxWaitUs = std::max(0, options_.maxWaitUs);
+}
+
+double QueryBatcher::windowUs(const Lane& lane) const {
+  int missing = options_.maxBatch - static_cast<int>(lane.queue.size());
+  if (missing <= 0 || lane.gapUs < 0.0) return 0.0;
+  // at most one more query would arrive in time, don't make this one wait for it
+  if (lane.gapUs > options_.maxWaitUs / 2.0) return 0.0;
+  return std::min<double>(options_.maxWaitUs, lane.gapUs * missing);
+}
+
+void QueryBatcher::search(const FeatureIndex& index, const std::vector<float>& query, int k,
+                          std::vector<IndexMatch>& results, SearchStats* stats) {
+  Pending self{&index, &query, k, &results};
+  std::unique_lock<std::mutex> lock(mutex_);
+  Lane& lane = lanes_[index.type];
+
+  auto now = Clock::now();
+  if (lane.lastArrival != Clock::time_point()) {
+    double gap = std::chrono::duration<double, std::micro>(now - lane.lastArrival).count();
+    lane.gapUs = lane.gapUs < 0.0 ? gap : (1.0 - kGapSmoothing) * lane.gapUs + kGapSmoothing * gap;
+  }
+  lane.lastArrival = now;
+  lane.queue.push_back(&self);
+  changed_.notify_all();  // a waiting leader may now have a full batch
+
+  while (!self.done) {
+    if (lane.leader || self.taken) {
+      changed_.wait(lock, [&] { return self.done || (!lane.leader && !self.taken); });
+      continue;
+    }
+
+    // 1. lead: collect arrivals until the window closes or the batch is full
+    lane.leader = true;
+    double window = windowUs(lane);
+    changed_.wait_until(lock, Clock::now() + std::chrono::microseconds(static_cast<int64_t>(window)), [&] {
+      return static_cast<int>(lane.queue.size()) >= options_.maxBatch;
+    });
+
+    // 2. take the oldest queries for the same index (a reload may leave older ones for another)
+    std::vector<Pending*> batch;
+    for (auto it = lane.queue.begin(); it != lane.queue.end() && static_cast<int>(batch.size()) < options_.maxBatch;) {
+      if ((*it)->index == self.index) {
+        (*it)->taken = true;
+        batch.push_back(*it);
+        it = lane.queue.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    lane.leader = false;  // the next leader can start collecting while this batch is scored
+    stats_.batches++;
+    stats_.queries += batch.size();
+    stats_.largestBatch = std::max(stats_.largestBatch, static_cast<int>(batch.size()));
+    stats_.windowUs = window;
+    changed_.notify_all();
+    lock.unlock();
+
+    // 3. one pass over the feature matrix for the whole batch
+    std::vector<const std::vector<float>*> queries;
+    std::vector<int> ks;
+    for (Pending* pending : batch) {
+      queries.push_back(pending->query);
+      ks.push_back(pending->k);
+    }
+    std::vector<std::vector<IndexMatch>> batchResults;
+    searchExhaustiveBatch(index, queries, ks, batchResults);
+
+    lock.lock();
+    for (size_t i = 0; i < batch.size(); i++) {
+      *batch[i]->results = std::move(batchResults[i]);
+      batch[i]->done = true;
+    }
+    changed_.notify_all();
+  }
+
+  if (stats) {
+    stats->candidates = index.size();
+    stats->fullyScored = index.size();
+    stats->pruned = 0;
+    stats->binsTouched = static_cast<uint64_t>(index.size()) * index.dim;
+  }
+}
+
+BatchStats QueryBatcher::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
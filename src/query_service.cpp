@@ -0,0 +1,349 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the query service used by cbir_server.
+*/
+
+#include "query_service.h"
+#include "http_util.h"
+#include "index_shard.h"
+#include "image_pack.h"
+#include "trace.h"
+#include <print>  // for modern C++ printing (C++23)
+#include <filesystem>
+#include <format>
+#include <chrono>
+#include <algorithm>
+
+// queries run on a fresh index before it is swapped in
+static const int kWarmUpQueries = 8;
+
+QueryService::QueryService() : snapshot_(std::make_shared<const IndexSnapshot>()) {}
+
+QueryService::~QueryService() = default;
+
+// Load the files of one feature type into a single index (shards are merged)
+static int loadIndexFiles(const std::vector<std::string>& files, FeatureIndex& index) {
+  for (size_t i = 0; i < files.size(); i++) {
+    FeatureIndex part;
+    if (loadFeatureIndex(files[i], part) != 0) return -1;
+    if (i == 0) {
+      index = std::move(part);
+    } else if (mergeFeatureIndexShard(index, part) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// Touch every row and run a few searches so the first real queries don't pay for it
+static void warmUpIndex(const FeatureIndex& index) {
+  if (index.size() == 0) return;
+  volatile float sink = 0.0f;
+  for (const auto& row : index.features) sink = sink + (row.empty() ? 0.0f : row[0]);
+
+  std::vector<IndexMatch> matches;
+  int step = std::max(1, index.size() / kWarmUpQueries);
+  for (int row = 0; row < index.size(); row += step) {
+    searchIndex(index, index.features[row], 4, SearchOptions(), matches);
+  }
+}
+
+int QueryService::loadIndex(const std::string& filename) {
+  std::lock_guard<std::mutex> lock(reloadMutex_);
+  FeatureIndex index;
+  if (loadFeatureIndex(filename, index) != 0) {
+    return -1;
+  }
+  std::println("Loaded {}: {} images, {} features", filename, index.size(), featureTypeName(index.type));
+  FeatureType type = index.type;
+
+  auto current = snapshot_.load();
+  auto next = std::make_shared<IndexSnapshot>(*current);
+  std::error_code ec;
+  next->fileTimes[filename] = std::filesystem::last_write_time(filename, ec);
+
+  // another shard of the same index: this process serves the union of its shards
+  auto existing = current->indexes.find(type);
+  if (existing != current->indexes.end() && existing->second->shardCount > 0 && index.shardCount > 0) {
+    FeatureIndex merged = *existing->second;
+    if (mergeFeatureIndexShard(merged, index) != 0) return -1;
+    std::println("Serving {} of {} shards of {} ({} images)", merged.shardIds.size(), merged.shardCount,
+                 featureTypeName(type), merged.size());
+    next->indexes[type] = std::make_shared<const FeatureIndex>(std::move(merged));
+    next->files[type].push_back(filename);
+  } else {
+    next->indexes[type] = std::make_shared<const FeatureIndex>(std::move(index));
+    next->files[type] = {filename};
+  }
+  publish(next, std::move(current));
+  return 0;
+}
+
+int QueryService::reloadIndexes(bool force) {
+  std::lock_guard<std::mutex> lock(reloadMutex_);
+  auto current = snapshot_.load();
+  auto next = std::make_shared<IndexSnapshot>(*current);
+
+  int reloaded = 0;
+  for (const auto& [type, files] : current->files) {
+    bool changed = force;
+    for (const auto& file : files) {
+      std::error_code ec;
+      auto time = std::filesystem::last_write_time(file, ec);
+      if (!ec && time != current->fileTimes.at(file)) changed = true;
+      next->fileTimes[file] = time;
+    }
+    if (!changed) continue;
+
+    // a file may still be half written, keep serving the old index and try again later
+    FeatureIndex index;
+    if (loadIndexFiles(files, index) != 0) {
+      std::println(stderr, "Error: Reload of the {} index failed, keeping the loaded one", featureTypeName(type));
+      return -1;
+    }
+    std::println("Reloaded {} index: {} images", featureTypeName(type), index.size());
+    next->indexes[type] = std::make_shared<const FeatureIndex>(std::move(index));
+    reloaded++;
+  }
+
+  if (reloaded > 0) publish(next, std::move(current));
+  return reloaded;
+}
+
+void QueryService::publish(std::shared_ptr<IndexSnapshot> next, std::shared_ptr<const IndexSnapshot> current) {
+  next->generation = current->generation + 1;
+
+  // 1. warm up what is new while queries still run on the current snapshot
+  for (const auto& [type, index] : next->indexes) {
+    auto old = current->indexes.find(type);
+    if (old == current->indexes.end() || old->second != index) warmUpIndex(*index);
+  }
+
+  // 2. single pointer exchange, new queries see the new indexes from here on
+  snapshot_.exchange(next);
+  for (const auto& [type, index] : next->indexes) {
+    cache_.setIndexVersion(type, index->version);  // results of the old index are stale
+    indexMemoryMetric(type).set(static_cast<int64_t>(featureIndexMemoryBytes(*index)));
+  }
+
+  // 3. the old snapshot is released here; in-flight queries keep it alive and the last
+  //    of them frees it, so a reload never waits on a query
+}
+
+std::shared_ptr<const FeatureIndex> QueryService::findIndex(FeatureType type) const {
+  auto snapshot = snapshot_.load();
+  auto it = snapshot->indexes.find(type);
+  if (it == snapshot->indexes.end()) return nullptr;
+  return std::shared_ptr<const FeatureIndex>(snapshot, it->second.get());  // shares ownership of the snapshot
+}
+
+std::shared_ptr<const FeatureIndex> QueryService::selectIndex(const QueryRequest& request) const {
+  auto snapshot = snapshot_.load();
+  if (request.hasType) {
+    auto it = snapshot->indexes.find(request.type);
+    if (it == snapshot->indexes.end()) return nullptr;
+    return std::shared_ptr<const FeatureIndex>(snapshot, it->second.get());
+  }
+  if (snapshot->indexes.size() != 1) return nullptr;
+  return std::shared_ptr<const FeatureIndex>(snapshot, snapshot->indexes.begin()->second.get());
+}
+
+void QueryService::enableBatching(const BatchOptions& options) {
+  batcher_.reset(options.maxBatch > 1 ? new QueryBatcher(options) : nullptr);
+}
+
+BatchStats QueryService::batchStats() const {
+  return batcher_ ? batcher_->stats() : BatchStats();
+}
+
+std::vector<FeatureType> QueryService::types() const {
+  std::vector<FeatureType> result;
+  for (const auto& entry : snapshot_.load()->indexes) result.push_back(entry.first);
+  return result;
+}
+
+
+QueryStatus extractQueryFeatures(const FeatureIndex& index, const std::string& queryName, const std::string& path,
+                                 const std::string& imageBytes, std::vector<float>& features, std::string& error) {
+  int row = queryName.empty() ? -1 : findIndexRow(index, queryName);
+
+  // name only: the row already holds the features of that image
+  if (imageBytes.empty() && path.empty()) {
+    if (queryName.empty()) {
+      error = "query needs an image, a path or a name";
+      return QueryBadRequest;
+    }
+    if (row < 0) {
+      error = std::format("{} is not in the index", queryName);
+      return QueryNotInIndex;
+    }
+    features = index.features[row];
+    return QueryOk;
+  }
+
+  std::vector<float> embedding;
+  if (featureTypeNeedsEmbedding(index.type)) {
+    if (row < 0) {
+      error = std::format("no embedding for {} in the index", queryName.empty() ? path : queryName);
+      return QueryNotInIndex;
+    }
+    // the first 512 values of a custom feature vector are the embedding
+    const std::vector<float>& rowFeatures = index.features[row];
+    embedding.assign(rowFeatures.begin(), rowFeatures.begin() + std::min<size_t>(rowFeatures.size(), 512));
+  }
+
+  // DNN features are the embedding itself, no need to decode anything
+  cv::Mat image;
+  if (index.type != DNNEmbedding) {
+    if (!imageBytes.empty()) {
+      cv::Mat raw(1, static_cast<int>(imageBytes.size()), CV_8UC1, const_cast<char*>(imageBytes.data()));
+      image = cv::imdecode(raw, cv::IMREAD_COLOR);
+    } else {
+      image = readImage(path);  // also "<pack.cbpk>/<name>"
+    }
+    if (image.empty()) {
+      error = imageBytes.empty() ? std::format("failed to load image {}", path) : "failed to decode image bytes";
+      return QueryImageFailed;
+    }
+  }
+
+  if (extractFeatures(index.type, image, embedding, features) != 0) {
+    error = "failed to extract features from query image";
+    return QueryImageFailed;
+  }
+  return QueryOk;
+}
+
+
+QueryStatus QueryService::queryFeatures(const QueryRequest& request, std::vector<float>& features,
+                                        std::shared_ptr<const FeatureIndex>& index, std::string& error) const {
+  index = selectIndex(request);
+  if (!index) {
+    error = request.hasType ? std::format("no index loaded for {}", featureTypeName(request.type))
+                            : "several indexes are loaded, the query needs a type";
+    return request.hasType || snapshot_.load()->indexes.empty() ? QueryNoIndex : QueryBadRequest;
+  }
+
+  if (!request.features.empty()) {
+    features = request.features;
+    return QueryOk;
+  }
+
+  // a path without a name still gets its embedding by filename
+  std::string queryName = request.name;
+  if (queryName.empty() && !request.path.empty()) {
+    queryName = std::filesystem::path(request.path).filename().string();
+  }
+  return extractQueryFeatures(*index, queryName, request.path, request.imageBytes, features, error);
+}
+
+
+QueryStatus QueryService::query(const QueryRequest& request, QueryResponse& response) const {
+  CBIR_TRACE_SCOPE("query");
+  auto start = std::chrono::steady_clock::now();
+  response = QueryResponse();
+
+  if (request.k <= 0) {
+    response.status = QueryBadRequest;
+    response.error = "k must be positive";
+    return response.status;
+  }
+
+  std::shared_ptr<const FeatureIndex> index;  // keeps its snapshot alive until the query is done
+  std::vector<float> features;
+  response.status = queryFeatures(request, features, index, response.error);
+  if (index) response.type = index->type;
+  if (response.status != QueryOk) {
+    if (index) queryFailuresMetric(index->type).add();
+    return response.status;
+  }
+
+  // popular images are answered straight from the cache
+  ResultCacheKey key;
+  key.featureHash = hashQueryFeatures(features);
+  key.type = index->type;
+  key.k = request.k;
+  key.mode = request.search.mode;
+  if (request.search.mode == SearchSimHash) {
+    key.mode += request.search.simhashCandidates << 4;  // approximate results depend on the candidate count
+  }
+  key.indexVersion = index->version;
+  CachedResults results;
+  if (cache_.lookup(key, features, results)) {
+    response.cached = true;
+  } else {
+    if (static_cast<int>(features.size()) != index->dim) {
+      response.status = QueryBadRequest;
+      response.error = "query features do not match the index";
+      queryFailuresMetric(index->type).add();
+      return response.status;
+    }
+
+    // queries that would scan every row anyway share one pass with their concurrent neighbours
+    std::vector<IndexMatch> matches;
+    if (batcher_ && resolveSearchMode(*index, request.search.mode) == SearchExhaustive) {
+      batcher_->search(*index, features, request.k, matches, &response.stats);
+    } else if (searchIndex(*index, features, request.k, request.search, matches, &response.stats) != 0) {
+      response.status = QueryBadRequest;
+      response.error = "search mode is not available for this index";
+      queryFailuresMetric(index->type).add();
+      return response.status;
+    }
+    for (const auto& match : matches) {
+      results.push_back(std::make_pair(match.distance, index->paths[match.row]));
+    }
+    cache_.insert(key, features, results);
+  }
+  for (const auto& result : results) {
+    response.hits.push_back({result.second, result.first});
+  }
+
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  queryDurationMetric(index->type).observe(elapsed);
+  response.elapsedMs = std::chrono::duration<double, std::milli>(elapsed).count();
+  return QueryOk;
+}
+
+
+std::string queryResponseToJson(const QueryResponse& response) {
+  if (response.status != QueryOk) {
+    return std::format("{{\"status\":\"error\",\"code\":{},\"error\":\"{}\"}}\n",
+                       static_cast<int>(response.status), jsonEscape(response.error));
+  }
+
+  std::string json = std::format("{{\"status\":\"ok\",\"type\":\"{}\",\"k\":{},\"elapsed_ms\":{:.3f},\"cached\":{},"
+                                 "\"candidates\":{},\"scored\":{},\"pruned\":{},\"results\":[",
+                                 featureTypeName(response.type), response.hits.size(), response.elapsedMs,
+                                 response.cached ? "true" : "false",
+                                 response.stats.candidates, response.stats.fullyScored, response.stats.pruned);
+  for (size_t i = 0; i < response.hits.size(); i++) {
+    const QueryHit& hit = response.hits[i];
+    json += std::format("{}{{\"rank\":{},\"name\":\"{}\",\"path\":\"{}\",\"distance\":{:.6f}}}",
+                        i ? "," : "", i + 1,
+                        jsonEscape(std::filesystem::path(hit.path).filename().string()),
+                        jsonEscape(hit.path), hit.distance);
+  }
+  json += "]";
+  if (!response.missingShards.empty()) {
+    json += ",\"partial\":true,\"missing_shards\":[";
+    for (size_t i = 0; i < response.missingShards.size(); i++) {
+      json += std::format("{}{}", i ? "," : "", response.missingShards[i]);
+    }
+    json += "]";
+  }
+  json += "}\n";
+  return json;
+}
+
+// distances are written in shortest round-trip form so a coordinator can merge shards exactly
+std::string queryResponseToTsv(const QueryResponse& response) {
+  std::string tsv;
+  for (const auto& hit : response.hits) {
+    tsv += std::format("{}\t{}\n", hit.distance, hit.path);
+  }
+  return tsv;
+}
@@ -0,0 +1,132 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the LRU query result cache.
+*/
+
+#include "result_cache.h"
+#include "metrics.h"
+#include <cstring>
+
+uint64_t hashQueryFeatures(const std::vector<float>& features) {
+  uint64_t hash = 1469598103934665603ULL;  // FNV-1a offset basis
+  for (float value : features) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 4; i++) {
+      hash ^= (bits >> (8 * i)) & 0xff;
+      hash *= 1099511628211ULL;  // FNV prime
+    }
+  }
+  return hash;
+}
+
+size_t ResultCache::KeyHash::operator()(const ResultCacheKey& key) const {
+  uint64_t hash = key.featureHash;
+  hash ^= key.indexVersion + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  hash ^= (static_cast<uint64_t>(key.type) << 40) ^ (static_cast<uint64_t>(key.mode) << 32) ^ static_cast<uint32_t>(key.k);
+  return static_cast<size_t>(hash);
+}
+
+// Rough heap footprint of an entry (list node, map node, vectors and strings)
+static size_t entryBytes(const std::vector<float>& features, const CachedResults& results) {
+  size_t bytes = 128 + features.size() * sizeof(float);
+  for (const auto& result : results) {
+    bytes += sizeof(result) + result.second.capacity();
+  }
+  return bytes;
+}
+
+ResultCache::ResultCache(size_t budgetBytes) {
+  stats_.budgetBytes = budgetBytes;
+}
+
+bool ResultCache::lookup(const ResultCacheKey& key, const std::vector<float>& features, CachedResults& results) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stats_.budgetBytes == 0) return false;  // disabled: not a miss, nothing could have been cached
+  auto it = lookup_.find(key);
+  if (it == lookup_.end() || it->second->features != features) {
+    stats_.misses++;
+    resultCacheMissesMetric().add();
+    return false;
+  }
+  entries_.splice(entries_.begin(), entries_, it->second);  // move to the front
+  results = it->second->results;
+  stats_.hits++;
+  resultCacheHitsMetric().add();
+  return true;
+}
+
+void ResultCache::insert(const ResultCacheKey& key, const std::vector<float>& features, const CachedResults& results) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stats_.budgetBytes == 0) return;
+
+  // results of an index that has been replaced since the query started
+  auto version = versions_.find(key.type);
+  if (version != versions_.end() && version->second != key.indexVersion) return;
+
+  auto existing = lookup_.find(key);
+  if (existing != lookup_.end()) erase(existing->second);
+
+  size_t bytes = entryBytes(features, results);
+  if (bytes > stats_.budgetBytes) return;
+
+  entries_.push_front({key, features, results, bytes});
+  lookup_[key] = entries_.begin();
+  stats_.bytes += bytes;
+  stats_.entries++;
+  stats_.insertions++;
+  evictToBudget();
+}
+
+void ResultCache::setIndexVersion(FeatureType type, uint64_t version) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto current = versions_.find(type);
+  if (current != versions_.end() && current->second == version) return;
+  versions_[type] = version;
+
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    auto next = std::next(it);
+    if (it->key.type == type && it->key.indexVersion != version) {
+      erase(it);
+      stats_.invalidations++;
+    }
+    it = next;
+  }
+}
+
+void ResultCache::setBudget(size_t budgetBytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.budgetBytes = budgetBytes;
+  evictToBudget();
+}
+
+void ResultCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  lookup_.clear();
+  stats_.entries = 0;
+  stats_.bytes = 0;
+}
+
+ResultCacheStats ResultCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void ResultCache::evictToBudget() {
+  while (stats_.bytes > stats_.budgetBytes && !entries_.empty()) {
+    erase(std::prev(entries_.end()));  // least recently used
+    stats_.evictions++;
+  }
+}
+
+void ResultCache::erase(std::list<Entry>::iterator it) {
+  stats_.bytes -= it->bytes;
+  stats_.entries--;
+  lookup_.erase(it->key);
+  entries_.erase(it);
+}
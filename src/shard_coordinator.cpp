@@ -0,0 +1,308 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the scatter-gather shard coordinator.
+*/
+
+#include "shard_coordinator.h"
+#include "index_shard.h"
+#include "query_service.h"
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <sstream>
+
+// weight of the newest call in the latency moving average
+static const double kLatencySmoothing = 0.2;
+
+ShardCoordinator::ShardCoordinator(const CoordinatorOptions& options)
+    : options_(options), calls_(std::make_unique<ThreadPool>(std::max(1, options.maxInFlight))) {}
+
+ShardCoordinator::~ShardCoordinator() {
+  stopping_ = true;
+  calls_.reset();
+}
+
+int ShardCoordinator::addShard(int shardId, const std::string& address) {
+  std::string host;
+  int port = 0;
+  if (shardId < 0 || !parseHostPort(address, host, port)) return -1;
+
+  // one server process can own several shards
+  int server = -1;
+  for (size_t i = 0; i < servers_.size(); i++) {
+    if (servers_[i].host == host && servers_[i].port == port) server = static_cast<int>(i);
+  }
+  if (server < 0) {
+    servers_.push_back(Server());
+    servers_.back().host = host;
+    servers_.back().port = port;
+    server = static_cast<int>(servers_.size()) - 1;
+  }
+  servers_[server].shardIds.push_back(shardId);
+
+  if (shardId >= static_cast<int>(shardServer_.size())) shardServer_.resize(shardId + 1, -1);
+  shardServer_[shardId] = server;
+  return 0;
+}
+
+int ShardCoordinator::validate() const {
+  if (shardServer_.empty()) return -1;
+  for (int server : shardServer_) {
+    if (server < 0) return -1;
+  }
+  return 0;
+}
+
+bool ShardCoordinator::isDown(int server, Clock::time_point now) const {
+  return servers_[server].consecutiveFailures >= options_.failuresBeforeDown && now < servers_[server].downUntil;
+}
+
+void ShardCoordinator::record(int server, bool ok, double ms) {
+  Server& s = servers_[server];
+  s.calls++;
+  if (ok) {
+    s.consecutiveFailures = 0;
+    s.latencyMs = s.calls == 1 ? ms : (1.0 - kLatencySmoothing) * s.latencyMs + kLatencySmoothing * ms;
+  } else {
+    markFailed(server);
+  }
+}
+
+void ShardCoordinator::markFailed(int server) {
+  Server& s = servers_[server];
+  s.failures++;
+  s.consecutiveFailures++;
+  if (s.consecutiveFailures >= options_.failuresBeforeDown) {
+    s.downUntil = Clock::now() + std::chrono::milliseconds(options_.downMs);
+  }
+}
+
+/*
+  Parallel calls with a shared deadline
+
+  The calls run on the coordinator's pool, so at most maxInFlight shard
+  calls are open at once however many queries come in. Each call owns a
+  reference to the shared state: a server that never answers only holds
+  its pool thread (bounded by the socket timeout), not the query. A call
+  still queued when the deadline has passed, or when the coordinator is
+  shutting down, is not made at all.
+*/
+void ShardCoordinator::fanOut(const std::vector<int>& servers, const std::string& method, const std::string& target,
+                              const std::string& body, std::vector<CallResult>& results) {
+  struct Shared {
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::vector<CallResult> results;
+    std::vector<bool> done;
+    std::vector<double> ms;
+    int remaining = 0;
+  };
+  auto shared = std::make_shared<Shared>();
+  shared->results.resize(servers.size());
+  shared->done.assign(servers.size(), false);
+  shared->ms.assign(servers.size(), 0.0);
+  shared->remaining = static_cast<int>(servers.size());
+
+  auto start = Clock::now();
+  auto deadline = start + std::chrono::milliseconds(options_.timeoutMs);
+  for (size_t i = 0; i < servers.size(); i++) {
+    std::string host = servers_[servers[i]].host;
+    int port = servers_[servers[i]].port;
+    calls_->submit([this, shared, i, host, port, method, target, body, start, deadline] {
+      CallResult result;
+      int timeoutMs = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count());
+      if (timeoutMs > 0 && !stopping_) {
+        result.ok = httpFetch(host, port, method, target, body, result.response, timeoutMs) == 0;
+      }
+      std::lock_guard<std::mutex> lock(shared->mutex);
+      shared->results[i] = std::move(result);
+      shared->done[i] = true;
+      shared->ms[i] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+      shared->remaining--;
+      shared->finished.notify_all();
+    });
+  }
+
+  std::unique_lock<std::mutex> lock(shared->mutex);
+  shared->finished.wait_until(lock, deadline, [&] { return shared->remaining == 0; });
+
+  results.assign(servers.size(), CallResult());
+  std::lock_guard<std::mutex> stateLock(mutex_);
+  for (size_t i = 0; i < servers.size(); i++) {
+    bool ok = shared->done[i] && shared->results[i].ok;
+    if (ok) results[i] = shared->results[i];  // late calls are abandoned as failures
+    record(servers[i], ok, shared->ms[i]);
+  }
+}
+
+int ShardCoordinator::fetchFeatures(const HttpRequest& request, std::string& features, HttpResponse& failure) {
+  auto get = [&](const char* key) -> std::string {
+    auto it = request.query.find(key);
+    return it == request.query.end() ? "" : it->second;
+  };
+
+  // the owner of the query image has its row (and its DNN embedding)
+  std::string name = get("name");
+  if (name.empty() && !get("path").empty()) name = std::filesystem::path(get("path")).filename().string();
+  int owner = name.empty() ? 0 : shardServer_[shardOfImage(name, static_cast<int>(shardServer_.size()))];
+
+  std::vector<int> order = {owner};
+  for (int i = 0; i < static_cast<int>(servers_.size()); i++) {
+    if (i != owner) order.push_back(i);
+  }
+
+  std::string target = "/features?" + encodeQueryString(request.query);
+  bool ownerFailed = false;
+  for (int server : order) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (isDown(server, Clock::now())) {
+        servers_[server].skipped++;
+        if (server == owner) ownerFailed = true;
+        continue;
+      }
+    }
+    std::vector<CallResult> results;
+    fanOut({server}, "POST", target, request.body, results);
+    if (!results[0].ok) {
+      if (server == owner) ownerFailed = true;
+      continue;
+    }
+    const HttpResponse& response = results[0].response;
+    if (response.status == 200) {
+      features = response.body;
+      return 0;
+    }
+    // another shard does not have the row of the query image
+    if (response.status == 404 && ownerFailed) break;
+    failure = response;
+    return -1;
+  }
+
+  failure.status = 503;
+  failure.body = std::format("{{\"status\":\"error\",\"error\":\"shard server for {} is unavailable\"}}\n",
+                             jsonEscape(name.empty() ? "the query" : name));
+  return -1;
+}
+
+HttpResponse ShardCoordinator::handleQuery(const HttpRequest& request) {
+  auto start = Clock::now();
+
+  // 1. features once, from the owning shard
+  std::string features;
+  HttpResponse failure;
+  if (fetchFeatures(request, features, failure) != 0) return failure;
+
+  // 2. same query with the features to every live shard server
+  std::unordered_map<std::string, std::string> params;
+  for (const char* key : {"type", "k", "mode"}) {
+    auto it = request.query.find(key);
+    if (it != request.query.end()) params[key] = it->second;
+  }
+  params["features"] = "1";
+  params["format"] = "tsv";
+  std::string target = "/query?" + encodeQueryString(params);
+
+  QueryResponse merged;
+  std::vector<int> live;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+    for (int i = 0; i < static_cast<int>(servers_.size()); i++) {
+      if (isDown(i, now)) {
+        servers_[i].skipped++;
+        merged.missingShards.insert(merged.missingShards.end(), servers_[i].shardIds.begin(), servers_[i].shardIds.end());
+      } else {
+        live.push_back(i);
+      }
+    }
+  }
+  std::vector<CallResult> results;
+  fanOut(live, "POST", target, features, results);
+
+  // 3. exact merge: every shard list is sorted by {distance, path} already
+  std::vector<std::pair<float, std::string>> hits;
+  for (size_t i = 0; i < live.size(); i++) {
+    const Server& server = servers_[live[i]];
+    if (!results[i].ok) {
+      merged.missingShards.insert(merged.missingShards.end(), server.shardIds.begin(), server.shardIds.end());
+      continue;
+    }
+    if (results[i].response.status != 200) return results[i].response;  // bad request, same answer everywhere
+
+    // a shard whose list does not parse is left out as a whole, half a list would skew the merge
+    std::vector<std::pair<float, std::string>> shardHits;
+    std::istringstream lines(results[i].response.body);
+    std::string line;
+    bool malformed = false;
+    while (std::getline(lines, line)) {
+      size_t tab = line.find('\t');
+      float distance = 0.0f;
+      auto [end, ec] = tab == std::string::npos ? std::from_chars_result{line.data(), std::errc::invalid_argument}
+                                                 : std::from_chars(line.data(), line.data() + tab, distance);
+      if (ec != std::errc() || end != line.data() + tab) {
+        malformed = true;
+        break;
+      }
+      shardHits.push_back(std::make_pair(distance, line.substr(tab + 1)));
+    }
+    if (malformed) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      servers_[live[i]].malformed++;
+      markFailed(live[i]);  // the call itself was recorded by fanOut
+      merged.missingShards.insert(merged.missingShards.end(), server.shardIds.begin(), server.shardIds.end());
+      continue;
+    }
+    hits.insert(hits.end(), shardHits.begin(), shardHits.end());
+  }
+  std::sort(hits.begin(), hits.end());
+  std::sort(merged.missingShards.begin(), merged.missingShards.end());
+
+  auto kParam = request.query.find("k");
+  size_t k = kParam != request.query.end() ? static_cast<size_t>(std::max(0, std::atoi(kParam->second.c_str()))) : 4;
+  for (size_t i = 0; i < hits.size() && i < k; i++) {
+    merged.hits.push_back({hits[i].second, hits[i].first});
+  }
+  auto typeParam = request.query.find("type");
+  if (typeParam != request.query.end()) parseFeatureType(typeParam->second, merged.type);
+  merged.elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  HttpResponse response;
+  if (live.empty() || merged.missingShards.size() == shardServer_.size()) {
+    response.status = 503;
+    response.body = "{\"status\":\"error\",\"error\":\"no shard server answered\"}\n";
+    return response;
+  }
+  auto format = request.query.find("format");
+  if (format != request.query.end() && format->second == "tsv") {
+    response.contentType = "text/tab-separated-values";
+    response.body = queryResponseToTsv(merged);
+  } else {
+    response.body = queryResponseToJson(merged);
+  }
+  return response;
+}
+
+std::string ShardCoordinator::statsJson() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto now = Clock::now();
+  std::string json = std::format("{{\"shards\":{},\"servers\":[", shardServer_.size());
+  for (size_t i = 0; i < servers_.size(); i++) {
+    const Server& s = servers_[i];
+    std::string ids;
+    for (size_t j = 0; j < s.shardIds.size(); j++) ids += std::format("{}{}", j ? "," : "", s.shardIds[j]);
+    json += std::format("{}{{\"address\":\"{}:{}\",\"shards\":[{}],\"calls\":{},\"failures\":{},\"skipped\":{},"
+                        "\"malformed\":{},\"latency_ms\":{:.3f},\"down\":{}}}",
+                        i ? "," : "", jsonEscape(s.host), s.port, ids, s.calls, s.failures, s.skipped,
+                        s.malformed, s.latencyMs, isDown(static_cast<int>(i), now) ? "true" : "false");
+  }
+  json += "]}";
+  return json;
+}
@@ -0,0 +1,107 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of SimHash binary signatures.
+*/
+
+#include "simhash.h"
+#include <bit>  // std::popcount (C++20)
+#include <random>
+
+/*
+  Prepare a feature vector for projection
+
+  Histogram segments are normalized to sum 1 (same as the intersection
+  distances) and the collection mean is subtracted, otherwise every
+  all-positive histogram lands on the same side of most hyperplanes.
+*/
+static void prepareVector(const SimHash& simhash, const float* features, std::vector<float>& out) {
+  out.assign(features, features + simhash.dim);
+
+  for (const auto& seg : simhash.normalizeSegments) {
+    double sum = 0.0;
+    for (int i = 0; i < seg.size; i++) sum += out[seg.offset + i];
+    float scale = sum >= 1.0 ? static_cast<float>(1.0 / sum) : 0.0f;
+    for (int i = 0; i < seg.size; i++) out[seg.offset + i] *= scale;
+  }
+
+  if (!simhash.mean.empty()) {
+    for (int i = 0; i < simhash.dim; i++) out[i] -= simhash.mean[i];
+  }
+}
+
+// One bit per hyperplane: set if the vector is on the positive side
+static void project(const SimHash& simhash, const std::vector<float>& prepared, uint64_t* signature) {
+  for (int w = 0; w < simhash.words(); w++) signature[w] = 0;
+
+  for (int b = 0; b < simhash.bits; b++) {
+    const float* plane = &simhash.planes[static_cast<size_t>(b) * simhash.dim];
+    float dot = 0.0f;
+    for (int i = 0; i < simhash.dim; i++) dot += plane[i] * prepared[i];
+    if (dot > 0.0f) signature[b / 64] |= uint64_t(1) << (b % 64);
+  }
+}
+
+
+/*
+  Build random hyperplanes and the signature of every row
+
+  Input:
+    rows - feature vectors of the index
+    dim - feature vector length
+    bits - signature length (rounded up to a multiple of 64)
+    normalizeSegments - histogram segments, empty for embeddings (cosine is scale invariant)
+    simhash - output
+*/
+void buildSimHash(const std::vector<std::vector<float>>& rows, int dim, int bits,
+                  const std::vector<HistogramSegment>& normalizeSegments, SimHash& simhash) {
+  simhash = SimHash();
+  simhash.bits = (bits + 63) / 64 * 64;
+  simhash.dim = dim;
+  simhash.normalizeSegments = normalizeSegments;
+
+  // fixed seed, the planes are stored in the index so any generator works
+  std::mt19937 rng(5330);
+  std::normal_distribution<float> gaussian(0.0f, 1.0f);
+  simhash.planes.resize(static_cast<size_t>(simhash.bits) * dim);
+  for (auto& value : simhash.planes) value = gaussian(rng);
+
+  // center histograms on the collection mean
+  std::vector<float> prepared;
+  if (!normalizeSegments.empty() && !rows.empty()) {
+    std::vector<double> sum(dim, 0.0);
+    for (const auto& row : rows) {
+      prepareVector(simhash, row.data(), prepared);
+      for (int i = 0; i < dim; i++) sum[i] += prepared[i];
+    }
+    simhash.mean.resize(dim);
+    for (int i = 0; i < dim; i++) simhash.mean[i] = static_cast<float>(sum[i] / rows.size());
+  }
+
+  simhash.signatures.assign(rows.size() * simhash.words(), 0);
+  for (size_t r = 0; r < rows.size(); r++) {
+    prepareVector(simhash, rows[r].data(), prepared);
+    project(simhash, prepared, &simhash.signatures[r * simhash.words()]);
+  }
+}
+
+
+// Signature of a single (query) feature vector
+void computeSimHash(const SimHash& simhash, const std::vector<float>& features, uint64_t* signature) {
+  std::vector<float> prepared;
+  prepareVector(simhash, features.data(), prepared);
+  project(simhash, prepared, signature);
+}
+
+
+// Number of differing bits between two signatures
+int hammingDistance(const uint64_t* a, const uint64_t* b, int words) {
+  int distance = 0;
+  for (int w = 0; w < words; w++) {
+    distance += std::popcount(a[w] ^ b[w]);
+  }
+  return distance;
+}
@@ -0,0 +1,54 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the concurrently readable top-k.
+*/
+
+#include "streaming_topk.h"
+#include "trace.h"
+#include <algorithm>
+
+StreamingTopK::StreamingTopK(int capacity)
+    : capacity_(std::max(0, capacity)), lastPublish_(std::chrono::steady_clock::now()),
+      snapshot_(std::make_shared<const TopKSnapshot>()) {
+  heap_.reserve(capacity_ + 1);
+}
+
+bool StreamingTopK::offer(float distance, const std::string& path) {
+  if (capacity_ == 0) return false;
+  // same order as sorting every {distance, path} pair, the path is only copied if it is kept
+  if (static_cast<int>(heap_.size()) == capacity_) {
+    const auto& worst = heap_.front();
+    if (distance > worst.first || (distance == worst.first && path >= worst.second)) return false;
+    std::pop_heap(heap_.begin(), heap_.end());
+    heap_.pop_back();
+  }
+  heap_.emplace_back(distance, path);
+  std::push_heap(heap_.begin(), heap_.end());
+  changed_ = true;
+  return true;
+}
+
+void StreamingTopK::publish(int scanned, int total, bool complete) {
+  if (!changed_ && !complete) return;
+  CBIR_TRACE_SCOPE("sort");
+  auto next = std::make_shared<TopKSnapshot>();
+  next->entries = heap_;
+  std::sort(next->entries.begin(), next->entries.end());
+  next->scanned = scanned;
+  next->total = total;
+  next->complete = complete;
+  next->version = version_.load(std::memory_order_relaxed) + 1;
+
+  snapshot_.store(std::move(next));
+  version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_release);  // after the store
+  changed_ = false;
+  lastPublish_ = std::chrono::steady_clock::now();
+}
+
+void StreamingTopK::publishEvery(std::chrono::milliseconds interval, int scanned, int total) {
+  if (changed_ && std::chrono::steady_clock::now() - lastPublish_ >= interval) publish(scanned, total);
+}
@@ -0,0 +1,181 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the per-thread trace ring buffers and the Chrome
+  Trace Event JSON writer.
+*/
+
+#include "trace.h"
+#include <print>  // for modern C++ printing (C++23)
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+static const size_t kTraceCapacity = 1 << 14;  // events kept per thread (power of two)
+
+// One thread's events, written only by that thread. A slot's fields are stored with
+// release and read with acquire, so a reader that sees a rewritten slot also sees the
+// head count of the write that rewrote it and can drop the slot as overwritten.
+class TraceBuffer {
+public:
+  explicit TraceBuffer(int tid) : tid_(tid), events_(kTraceCapacity) {}
+
+  void record(const char* name, uint64_t start, uint64_t duration) {
+    uint64_t n = head_.load(std::memory_order_relaxed);
+    Event& event = events_[n & (kTraceCapacity - 1)];
+    event.name.store(name, std::memory_order_release);
+    event.start.store(start, std::memory_order_release);
+    event.duration.store(duration, std::memory_order_release);
+    head_.store(n + 1, std::memory_order_release);
+  }
+
+  // Append the events still in the ring as JSON objects, oldest first
+  void appendJson(std::string& json, bool& first) const {
+    uint64_t end = head_.load(std::memory_order_acquire);
+    uint64_t begin = end > kTraceCapacity ? end - kTraceCapacity : 0;
+    struct Copy { const char* name; uint64_t start, duration; };
+    std::vector<Copy> copies;
+    copies.reserve(end - begin);
+    for (uint64_t i = begin; i < end; i++) {
+      const Event& event = events_[i & (kTraceCapacity - 1)];
+      copies.push_back({event.name.load(std::memory_order_acquire), event.start.load(std::memory_order_acquire),
+                        event.duration.load(std::memory_order_acquire)});
+    }
+    // the owner kept recording while we copied: slots it has started rewriting are not what we wanted
+    uint64_t after = head_.load(std::memory_order_acquire);
+    uint64_t valid = after >= kTraceCapacity ? after - kTraceCapacity + 1 : 0;
+    for (uint64_t i = std::max(begin, valid); i < end; i++) {
+      const Copy& copy = copies[i - begin];
+      json += std::format("{}{{\"name\":\"{}\",\"cat\":\"cbir\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},"
+                          "\"pid\":1,\"tid\":{}}}",
+                          first ? "" : ",\n", copy.name, copy.start / 1000.0, copy.duration / 1000.0, tid_);
+      first = false;
+    }
+  }
+
+private:
+  struct Event {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> duration{0};
+  };
+
+  int tid_;
+  std::vector<Event> events_;
+  std::atomic<uint64_t> head_{0};  // events ever recorded
+};
+
+// Every buffer ever handed out; a thread that exits returns its buffer (events included)
+// for the next new thread, so short-lived pool threads do not add a ring each
+struct TraceRegistry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<TraceBuffer>> buffers;
+  std::vector<TraceBuffer*> free;
+  std::string exitFilename;
+  std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+static TraceRegistry& registry() {
+  static TraceRegistry instance;
+  return instance;
+}
+
+// Owns the calling thread's buffer until the thread exits
+struct ThreadTraceBuffer {
+  TraceBuffer* buffer = nullptr;
+
+  TraceBuffer* get() {
+    if (buffer) return buffer;
+    TraceRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if (!reg.free.empty()) {
+      buffer = reg.free.back();
+      reg.free.pop_back();
+    } else {
+      reg.buffers.push_back(std::make_unique<TraceBuffer>(static_cast<int>(reg.buffers.size()) + 1));
+      buffer = reg.buffers.back().get();
+    }
+    return buffer;
+  }
+
+  ~ThreadTraceBuffer() {
+    if (!buffer) return;
+    TraceRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.free.push_back(buffer);
+  }
+};
+
+uint64_t traceNow() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - registry().epoch).count());
+}
+
+void recordTraceEvent(const char* name, uint64_t startNs, uint64_t durationNs) {
+  thread_local ThreadTraceBuffer threadBuffer;
+  threadBuffer.get()->record(name, startNs, durationNs);
+}
+
+static void writeTraceAtExit() {
+  std::string filename;
+  {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    filename = registry().exitFilename;
+  }
+  if (!filename.empty() && writeTrace(filename) == 0) {
+    std::println(stderr, "Trace written to {}", filename);
+  }
+}
+
+void startTrace(const std::string& exitFilename) {
+  TraceRegistry& reg = registry();  // constructed before the exit handler is registered, so it outlives it
+  if (!exitFilename.empty()) {
+    bool first;
+    {
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      first = reg.exitFilename.empty();
+      reg.exitFilename = exitFilename;
+    }
+    if (first) std::atexit(writeTraceAtExit);
+  }
+  g_traceEnabled.store(true, std::memory_order_relaxed);
+}
+
+void stopTrace() {
+  g_traceEnabled.store(false, std::memory_order_relaxed);
+}
+
+std::string traceToJson() {
+  TraceRegistry& reg = registry();
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  for (const auto& buffer : reg.buffers) buffer->appendJson(json, first);
+  json += "\n]}\n";
+  return json;
+}
+
+int writeTrace(const std::string& filename) {
+  std::string json = traceToJson();
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  if (!out || !out.write(json.data(), json.size())) {
+    std::println(stderr, "Error: Unable to write trace {}", filename);
+    return -1;
+  }
+  return 0;
+}
+
+// CBIR_TRACE=<file> turns recording on in any tool and writes the trace at exit
+static const bool g_traceFromEnvironment = []() {
+  const char* filename = std::getenv("CBIR_TRACE");
+  if (filename && *filename) startTrace(filename);
+  return true;
+}();
@@ -0,0 +1,174 @@
+/*
+  Parker Cai
+  Jenny Nguyen
+  October 18, 2026
+  CS5330 - Project 2: Content-based Image Retrieval
+
+  Implementation of the vantage-point tree for baseline (SSD) features.
+*/
+
+#include "vp_tree.h"
+#include "distance.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <random>
+
+// sqrt of a float SSD carries a little rounding error, widen the pruning tests so they stay exact
+static float pruneSlack(float a, float b) {
+  return 1e-4f * (a + b) + 1e-3f;
+}
+
+static float euclidean(const std::vector<float>& a, const std::vector<float>& b, float& ssd) {
+  ssd = sumOfSquaredDifference(a, b);
+  return std::sqrt(ssd);
+}
+
+/*
+  Build one subtree from items [begin, end)
+
+  The vantage point is picked at random, the remaining items are split at
+  the median distance to it: inside (<= median) and outside (>= median).
+*/
+static int buildNode(const std::vector<std::vector<float>>& rows, std::vector<std::pair<float, int>>& items,
+                     int begin, int end, std::mt19937& rng, VPTree& tree) {
+  if (begin >= end) return -1;
+
+  std::uniform_int_distribution<int> pick(begin, end - 1);
+  std::swap(items[begin], items[pick(rng)]);
+  int vantage = items[begin].second;
+
+  for (int i = begin + 1; i < end; i++) {
+    float ssd;
+    items[i].first = euclidean(rows[vantage], rows[items[i].second], ssd);
+  }
+
+  int mid = (begin + 1 + end) / 2;
+  float threshold = 0.0f;
+  if (begin + 1 < end) {
+    std::nth_element(items.begin() + begin + 1, items.begin() + mid, items.begin() + end);
+    threshold = mid < end ? items[mid].first : 0.0f;
+  }
+
+  int node = static_cast<int>(tree.nodes.size());
+  tree.nodes.push_back({vantage, threshold, -1, -1, end - begin});
+
+  int inside = buildNode(rows, items, begin + 1, mid, rng, tree);
+  int outside = buildNode(rows, items, mid, end, rng, tree);
+  tree.nodes[node].inside = inside;
+  tree.nodes[node].outside = outside;
+  return node;
+}
+
+// Build the tree over all rows
+void buildVPTree(const std::vector<std::vector<float>>& rows, VPTree& tree) {
+  tree = VPTree();
+  std::vector<std::pair<float, int>> items(rows.size());
+  for (size_t i = 0; i < rows.size(); i++) items[i] = {0.0f, static_cast<int>(i)};
+
+  std::mt19937 rng(5330);  // fixed seed, same tree for the same rows
+  tree.nodes.reserve(rows.size());
+  tree.root = buildNode(rows, items, 0, static_cast<int>(rows.size()), rng, tree);
+}
+
+
+// Shared traversal state for k-NN and range queries
+struct VPSearch {
+  const VPTree& tree;
+  const std::vector<std::vector<float>>& rows;
+  const std::vector<float>& query;
+  VPTreeStats stats;
+
+  int k;          // k-NN: best k, range: 0
+  float maxSSD;   // range: fixed radius
+  std::priority_queue<std::pair<float, int>> best;  // max-heap on {SSD, row}
+  std::vector<std::pair<float, int>> inRange;
+
+  // current search radius in Euclidean units
+  float tau() const {
+    if (k == 0) return std::sqrt(maxSSD);
+    if (static_cast<int>(best.size()) < k) return std::numeric_limits<float>::infinity();
+    return std::sqrt(best.top().first);
+  }
+
+  void offer(float ssd, int row) {
+    if (k == 0) {
+      if (ssd <= maxSSD) inRange.push_back({ssd, row});
+    } else if (static_cast<int>(best.size()) < k) {
+      best.push({ssd, row});
+    } else if (std::make_pair(ssd, row) < best.top()) {
+      best.pop();
+      best.push({ssd, row});
+    }
+  }
+
+  void skip(int node) {
+    if (node >= 0) stats.nodesSkipped += tree.nodes[node].size;
+  }
+
+  void visit(int node) {
+    if (node < 0) return;
+    const VPNode& n = tree.nodes[node];
+
+    float ssd;
+    float d = euclidean(query, rows[n.row], ssd);
+    stats.nodesVisited++;
+    stats.distanceEvaluations++;
+    offer(ssd, n.row);
+
+    // inside points are within threshold of the vantage point: d(q, x) >= d - threshold
+    // outside points are at least threshold away:              d(q, x) >= threshold - d
+    bool insideFirst = d < n.threshold;
+    int first = insideFirst ? n.inside : n.outside;
+    int second = insideFirst ? n.outside : n.inside;
+
+    for (int child : {first, second}) {
+      if (child < 0) continue;
+      float t = tau();
+      float slack = pruneSlack(d, n.threshold);
+      bool reachable = (child == n.inside) ? (d - t <= n.threshold + slack)
+                                           : (d + t >= n.threshold - slack);
+      if (reachable) {
+        visit(child);
+      } else {
+        skip(child);
+      }
+    }
+  }
+};
+
+
+/*
+  Exact k nearest rows
+
+  Same SSD values as sumOfSquaredDifference in the exhaustive scan, ties
+  on SSD are broken by row so the order is identical.
+*/
+void vpTreeKnn(const VPTree& tree, const std::vector<std::vector<float>>& rows,
+               const std::vector<float>& query, int k,
+               std::vector<std::pair<float, int>>& results, VPTreeStats* stats) {
+  VPSearch search{tree, rows, query, VPTreeStats(), std::max(k, 1), 0.0f, {}, {}};
+  search.visit(tree.root);
+
+  results.clear();
+  while (!search.best.empty()) {
+    results.push_back(search.best.top());
+    search.best.pop();
+  }
+  std::reverse(results.begin(), results.end());
+  if (stats) *stats = search.stats;
+}
+
+
+// Every row with SSD <= maxSSD, sorted by {SSD, row}
+void vpTreeRange(const VPTree& tree, const std::vector<std::vector<float>>& rows,
+                 const std::vector<float>& query, float maxSSD,
+                 std::vector<std::pair<float, int>>& results, VPTreeStats* stats) {
+  VPSearch search{tree, rows, query, VPTreeStats(), 0, std::max(maxSSD, 0.0f), {}, {}};
+  search.visit(tree.root);
+
+  results = std::move(search.inRange);
+  std::sort(results.begin(), results.end());
+  if (stats) *stats = search.stats;
+}